@@ -7,11 +7,17 @@
 	http://opensource.org/licenses/BSD-3-Clause
 */
 #include <sstream>
+#include <vector>
+#include <string.h>
+#include <algorithm>
+#include <new>
 #include <cybozu/exception.hpp>
 #include <cybozu/bitvector.hpp>
+#include <cybozu/mutex.hpp>
 #include <mie/operator.hpp>
 #include <mie/power.hpp>
 #include <mie/gmp_util.hpp>
+#include <mie/thread.hpp>
 
 namespace mie {
 
@@ -24,6 +30,192 @@ namespace mie {
 #ifndef MIE_EC_COORD
 	#define MIE_EC_COORD MIE_EC_USE_PROJ
 #endif
+namespace ec_local {
+
+// bit length of y[n] >= 0
+template<class BlockType>
+size_t getBitLen(const BlockType *y, size_t n)
+{
+	while (n > 0 && y[n - 1] == 0) n--;
+	if (n == 0) return 0;
+	size_t bitLen = (n - 1) * sizeof(BlockType) * 8;
+	for (uint64_t v = uint64_t(y[n - 1]); v; v >>= 1) bitLen++;
+	return bitLen;
+}
+
+// num(< 32) bits of y[n] from the pos-th bit(0 for out of range)
+template<class BlockType>
+int getBits(const BlockType *y, size_t n, size_t pos, size_t num)
+{
+	const size_t blockBit = sizeof(BlockType) * 8;
+	const size_t q = pos / blockBit;
+	const size_t r = pos % blockBit;
+	if (q >= n) return 0;
+	uint64_t v = uint64_t(y[q]) >> r;
+	if (r + num > blockBit && q + 1 < n) v |= uint64_t(y[q + 1]) << (blockBit - r);
+	return int(v & ((uint64_t(1) << num) - 1));
+}
+
+/*
+	w-NAF of y[n] >= 0
+	y = sum_i naf[i] 2^i where naf[i] is 0 or odd in (-2^(w-1), 2^(w-1))
+	and at most one of w consecutive digits is not zero
+	naf is empty if y = 0 and the top digit is positive otherwise
+*/
+template<class BlockType>
+void getNaf(std::vector<signed char>& naf, const BlockType *y, size_t n, int w)
+{
+	const size_t bitLen = getBitLen(y, n);
+	naf.assign(bitLen + w, 0);
+	int carry = 0;
+	size_t pos = 0;
+	while (pos < bitLen) {
+		if (getBits(y, n, pos, 1) == carry) {
+			pos++;
+			continue;
+		}
+		// v is odd
+		int v = getBits(y, n, pos, w) + carry;
+		carry = (v >> (w - 1)) & 1;
+		v -= carry << w;
+		naf[pos] = (signed char)v;
+		pos += w;
+	}
+	if (carry) naf[pos] = 1;
+	while (!naf.empty() && naf.back() == 0) naf.pop_back();
+}
+
+// y = x as an integer
+template<class N>
+void toMpz(mpz_class& y, const N& x)
+{
+	typedef power_impl::TagInt<N> TagI;
+	const bool isNegative = x < 0;
+	const N& t = isNegative ? -x : x;
+	Gmp::setRaw(y, TagI::getBlock(t), TagI::getBlockSize(t));
+	if (isNegative) y = -y;
+}
+
+// for FpT of fp2.hpp
+template<class tag, size_t maxBitN, template<class _tag, size_t _maxBitN>class F>
+void toMpz(mpz_class& y, const F<tag, maxBitN>& x)
+{
+	x.toGmp(y);
+}
+
+/*
+	y = x mod n for Zn whose modulus is n
+	use Zn::deserialize for all types of Zn
+*/
+template<class Zn>
+void fromMpz(Zn& y, const mpz_class& x, const mpz_class& n)
+{
+	mpz_class t;
+	mpz_mod(t.get_mpz_t(), x.get_mpz_t(), n.get_mpz_t());
+	const size_t byteSize = Zn::getByteSize();
+	std::vector<uint8_t> buf(byteSize);
+	if (t != 0) {
+		size_t count = (mpz_sizeinbase(t.get_mpz_t(), 2) + 7) / 8;
+		mpz_export(&buf[byteSize - count], &count, 1, 1, 1, 0, t.get_mpz_t());
+	}
+	y.deserialize(&buf[0], byteSize);
+}
+
+/*
+	field context of the current thread for another thread
+	FpT of fp2.hpp may have a context per thread(see FieldCtxT)
+	and the others have nothing to do
+*/
+template<class Fp>
+struct ThreadCtx {
+	void bind() const {}
+};
+
+template<class tag, size_t maxBitN, template<class _tag, size_t _maxBitN>class F>
+struct ThreadCtx<F<tag, maxBitN> > {
+	typename F<tag, maxBitN>::ThreadCtx ctx;
+	ThreadCtx() : ctx(F<tag, maxBitN>::getThreadCtx()) {}
+	void bind() const { F<tag, maxBitN>::setThreadCtx(ctx); }
+};
+
+/*
+	y = 1 / x in constant time if Fp has one
+	FpT of fp2.hpp has invCT(safegcd) and the others use inv
+*/
+template<class Fp>
+struct InvCT {
+	static void inv(Fp& y, const Fp& x) { Fp::inv(y, x); }
+};
+
+template<class tag, size_t maxBitN, template<class _tag, size_t _maxBitN>class F>
+struct InvCT<F<tag, maxBitN> > {
+	static void inv(F<tag, maxBitN>& y, const F<tag, maxBitN>& x) { F<tag, maxBitN>::invCT(y, x); }
+};
+
+/*
+	y[i] = 1 / x[i] for i < n (x[i] != 0) with one InvCT
+	y may be x
+*/
+template<class Fp>
+void invVecCT(Fp *y, const Fp *x, size_t n)
+{
+	if (n == 0) return;
+	std::vector<Fp> t(n);
+	t[0] = x[0];
+	for (size_t i = 1; i < n; i++) {
+		t[i] = t[i - 1] * x[i];
+	}
+	Fp r;
+	InvCT<Fp>::inv(r, t[n - 1]);
+	for (size_t i = n - 1; i > 0; i--) {
+		const Fp xi = x[i];
+		y[i] = r * t[i - 1];
+		r *= xi;
+	}
+	y[0] = r;
+}
+
+/*
+	a coordinate in the table of FixedBaseT::serialize
+	Fp::serialize by default
+	the internal form(getUnit) for FpT of fp2.hpp so that the view of FixedBaseT reads it by a plain copy
+*/
+template<class Fp>
+struct FpEntry {
+	static size_t getByteSize() { return Fp::getByteSize(); }
+	static void write(uint8_t *buf, const Fp& x) { x.serialize(buf, Fp::getByteSize()); }
+	// throw if buf is not less than p
+	static void read(Fp& x, const uint8_t *buf) { x.deserialize(buf, Fp::getByteSize()); }
+	static bool isValid(const Fp&) { return true; }
+};
+
+template<class tag, size_t maxBitN, template<class _tag, size_t _maxBitN>class F>
+struct FpEntry<F<tag, maxBitN> > {
+	typedef F<tag, maxBitN> Fp;
+	typedef typename Fp::BlockType Unit;
+	static size_t getByteSize() { return Fp::getOp().N * sizeof(Unit); }
+	static void write(uint8_t *buf, const Fp& x) { memcpy(buf, x.getUnit(), getByteSize()); }
+	// buf must be aligned to Unit and is not checked(see isValid)
+	static void read(Fp& x, const uint8_t *buf)
+	{
+		x.setUnit(reinterpret_cast<const Unit*>(buf), Fp::getOp().N);
+	}
+	static bool isValid(const Fp& x) { return x.isValid(); }
+};
+
+// y = round(x / n) for n > 0
+inline void divRound(mpz_class& y, const mpz_class& x, const mpz_class& n)
+{
+	const mpz_class t = x * 2 + n;
+	const mpz_class n2 = n * 2;
+	mpz_fdiv_q(y.get_mpz_t(), t.get_mpz_t(), n2.get_mpz_t());
+}
+
+} // ec_local
+
+template<class _Fp>
+class FixedBaseT;
+
 /*
 	elliptic curve
 	y^2 = x^3 + ax + b (affine)
@@ -31,8 +223,7 @@ namespace mie {
 */
 template<class _Fp>
 class EcT : public ope::addsub<EcT<_Fp>,
-	ope::comparable<EcT<_Fp>,
-	ope::hasNegative<EcT<_Fp> > > > {
+	ope::hasNegative<EcT<_Fp> > > {
 	enum {
 		zero,
 		minus3,
@@ -47,54 +238,255 @@ public:
 #else
 	mutable Fp x, y, z;
 #endif
-	static Fp a_;
-	static Fp b_;
-	static int specialA_;
+	/*
+		y^2 = x^3 + ax + b
+		specialA : type of a for dbl
+		isGlv : use the endomorphism phi(x, y) = (beta x, y) = lambda (x, y) for a = 0
+		(a1, b1), (a2, b2) : short basis of {(u, v) | u + v lambda = 0 mod n}(see initGlv)
+	*/
+	struct Param {
+		Fp a;
+		Fp b;
+		int specialA;
+		bool isGlv;
+		Fp beta;
+		mpz_class n, lambda, a1, b1, a2, b2;
+		Param() : specialA(generic), isGlv(false) {}
+	};
+	/*
+		param_ : default parameter set by setParam
+		curParam_ : parameter of the current thread(see CurveCtxT)
+	*/
+	static Param param_;
+	static MIE_THREAD_LOCAL const Param *curParam_;
 	static bool compressedExpression_;
+	/*
+		width of w-NAF for power
+		0 : select by the bit length of a scalar
+	*/
+	static const int maxWnafWidth = 6;
+	static int wNafWidth_;
+	/*
+		use powerCT for power if true(see setConstTime)
+	*/
+	static bool constTime_;
+	static inline const Param& getParam() { return *curParam_; }
 #if MIE_EC_COORD == MIE_EC_USE_AFFINE
 	EcT() : inf_(true) {}
 #else
 	EcT() { z.clear(); }
 #endif
-	EcT(const Fp& _x, const Fp& _y)
+	EcT(const Fp& _x, const Fp& _y, bool verify = true)
 	{
-		set(_x, _y);
+		set(_x, _y, verify);
 	}
+	/*
+		normalize by the constant time inversion(Fp::invCT if any) if isConstTime()
+	*/
 	void normalize() const
 	{
+		normalizeSub(constTime_);
+	}
+	/*
+		normalize by the constant time inversion regardless of isConstTime()
+		for a point made from a secret
+	*/
+	void normalizeCT() const
+	{
+		normalizeSub(true);
+	}
+	/*
+		true if z is 1
+		add uses the mixed addition for such a point
+	*/
+	bool isAffine() const
+	{
+#if MIE_EC_COORD == MIE_EC_USE_AFFINE
+		return true;
+#else
+		return z.isOne();
+#endif
+	}
+	/*
+		normalize P[0], ..., P[n - 1] with one inversion
+	*/
+	static inline void normalizeVec(const EcT *P, size_t n)
+	{
+		std::vector<size_t> idx(n);
+		for (size_t i = 0; i < n; i++) {
+			idx[i] = i;
+		}
+		if (n > 0) normalizeIdx(P, &idx[0], n);
+	}
+	/*
+		normalize P[idx[0]], ..., P[idx[n - 1]] with one inversion
+	*/
+	static inline void normalizeIdx(const EcT *P, const size_t *pIdx, size_t n)
+	{
+#if MIE_EC_COORD == MIE_EC_USE_AFFINE
+		(void)P;
+		(void)pIdx;
+		(void)n;
+#else
+		std::vector<size_t> idx;
+		idx.reserve(n);
+		for (size_t j = 0; j < n; j++) {
+			const size_t i = pIdx[j];
+			if (P[i].isZero() || P[i].z.isOne()) continue;
+			idx.push_back(i);
+		}
+		const size_t m = idx.size();
+		if (m == 0) return;
+		std::vector<Fp> rz(m);
+		for (size_t i = 0; i < m; i++) {
+			rz[i] = P[idx[i]].z;
+		}
+		if (constTime_) {
+			ec_local::invVecCT(&rz[0], &rz[0], m);
+		} else {
+			Fp::invVec(&rz[0], &rz[0], m);
+		}
+		for (size_t i = 0; i < m; i++) {
+			const EcT& Q = P[idx[i]];
 #if MIE_EC_COORD == MIE_EC_USE_JACOBI
-		if (isZero() || z == 1) return;
-		Fp rz, rz2;
-		Fp::inv(rz, z);
-		rz2 = rz * rz;
-		x *= rz2;
-		y *= rz2 * rz;
-		z = 1;
-#elif MIE_EC_COORD == MIE_EC_USE_PROJ
-		if (isZero() || z == 1) return;
-		Fp rz;
-		Fp::inv(rz, z);
-		x *= rz;
-		y *= rz;
-		z = 1;
+			Fp rz2;
+			Fp::square(rz2, rz[i]);
+			Q.x *= rz2;
+			rz2 *= rz[i];
+			Q.y *= rz2;
+#else
+			Q.x *= rz[i];
+			Q.y *= rz[i];
+#endif
+			Q.z = 1;
+		}
 #endif
 	}
 
 	static inline void setParam(const std::string& astr, const std::string& bstr)
 	{
-		a_.fromStr(astr);
-		b_.fromStr(bstr);
-		if (a_.isZero()) {
-			specialA_ = zero;
-		} else if (a_ == -3) {
-			specialA_ = minus3;
+		initParam(param_, astr, bstr);
+	}
+	/*
+		a and b are made in the current context of Fp
+	*/
+	static inline void initParam(Param& param, const std::string& astr, const std::string& bstr)
+	{
+		param.a.fromStr(astr);
+		param.b.fromStr(bstr);
+		param.isGlv = false;
+		if (param.a.isZero()) {
+			param.specialA = zero;
+		} else if (param.a == -3) {
+			param.specialA = minus3;
 		} else {
-			specialA_ = generic;
+			param.specialA = generic;
 		}
 	}
+	/*
+		enable GLV for power with phi(x, y) = (beta x, y) = lambda (x, y)
+		every point must have the order n(cofactor 1 as secp*k1)
+		beta, lambda : see ecparam::getEcGlvParam
+		G : a point of the order n to check that beta and lambda are a pair
+	*/
+	static inline void setGlv(const std::string& betaStr, const std::string& lambdaStr, const std::string& nStr, const EcT& G)
+	{
+		initGlv(param_, betaStr, lambdaStr, nStr, G);
+	}
+	// use param on the current thread in the lifetime of ParamScope
+	class ParamScope {
+		const Param *prev_;
+		ParamScope(const ParamScope&);
+		void operator=(const ParamScope&);
+	public:
+		explicit ParamScope(const Param& param)
+			: prev_(curParam_)
+		{
+			curParam_ = &param;
+		}
+		~ParamScope() { curParam_ = prev_; }
+	};
+	/*
+		find the short basis by the extended Euclidean algorithm for n and lambda
+		(Guide to Elliptic Curve Cryptography, Algorithm 3.74)
+		r_i = s_i n + t_i lambda and (r_i, -t_i) is in the lattice
+		l is the largest index such that r_l >= sqrt(n)
+		(a1, b1) = (r_{l+1}, -t_{l+1})
+		(a2, b2) = shorter of (r_l, -t_l) and (r_{l+2}, -t_{l+2})
+		each of beta and lambda has two choices and
+		phi(G) == lambda G is checked on the curve of param
+		because the other beta passes the other checks
+	*/
+	static inline void initGlv(Param& param, const std::string& betaStr, const std::string& lambdaStr, const std::string& nStr, const EcT& G)
+	{
+		if (param.specialA != zero) throw cybozu::Exception("EcT:initGlv:a must be 0");
+		Fp beta;
+		beta.fromStr(betaStr);
+		if (beta == 1 || beta * beta * beta != 1) throw cybozu::Exception("EcT:initGlv:bad beta") << betaStr;
+		mpz_class n, lambda;
+		Gmp::fromStr(n, nStr);
+		Gmp::fromStr(lambda, lambdaStr);
+		if (n <= 3 || lambda <= 1 || lambda >= n || (lambda * lambda + lambda + 1) % n != 0) {
+			throw cybozu::Exception("EcT:initGlv:bad lambda") << lambdaStr << nStr;
+		}
+		{
+			// power does not use GLV because param.isGlv is false here
+			param.isGlv = false;
+			ParamScope scope(param);
+			EcT P = G, T;
+			P.normalize();
+			if (P.isZero() || !isValid(P.x, P.y)) throw cybozu::Exception("EcT:initGlv:bad G");
+			power(T, P, n);
+			if (!T.isZero()) throw cybozu::Exception("EcT:initGlv:the order of G is not n");
+			power(T, P, lambda);
+			if (T != EcT(P.x * beta, P.y, false)) {
+				throw cybozu::Exception("EcT:initGlv:beta and lambda are not a pair") << betaStr << lambdaStr;
+			}
+		}
+		mpz_class sqrtN, r0 = n, r1 = lambda, t0 = 0, t1 = 1, q, r2, t2;
+		mpz_sqrt(sqrtN.get_mpz_t(), n.get_mpz_t());
+		while (r1 >= sqrtN) {
+			q = r0 / r1;
+			r2 = r0 - q * r1;
+			t2 = t0 - q * t1;
+			r0 = r1; r1 = r2;
+			t0 = t1; t1 = t2;
+		}
+		q = r0 / r1;
+		r2 = r0 - q * r1;
+		t2 = t0 - q * t1;
+		param.a1 = r1;
+		param.b1 = -t1;
+		if (r0 * r0 + t0 * t0 <= r2 * r2 + t2 * t2) {
+			param.a2 = r0;
+			param.b2 = -t0;
+		} else {
+			param.a2 = r2;
+			param.b2 = -t2;
+		}
+		param.beta = beta;
+		param.n = n;
+		param.lambda = lambda;
+		param.isGlv = true;
+	}
+	/*
+		k = k1 + k2 lambda mod n where |k1|, |k2| are about sqrt(n)
+		c1 = round(b2 k / n), c2 = round(-b1 k / n)
+		k1 = k - c1 a1 - c2 a2, k2 = -c1 b1 - c2 b2
+	*/
+	static inline void splitGlv(mpz_class& k1, mpz_class& k2, const mpz_class& k)
+	{
+		const Param& param = getParam();
+		mpz_class c1, c2;
+		ec_local::divRound(c1, param.b2 * k, param.n);
+		ec_local::divRound(c2, -param.b1 * k, param.n);
+		k1 = k - c1 * param.a1 - c2 * param.a2;
+		k2 = -c1 * param.b1 - c2 * param.b2;
+	}
 	static inline bool isValid(const Fp& _x, const Fp& _y)
 	{
-		return _y * _y == (_x * _x + a_) * _x + b_;
+		const Param& param = getParam();
+		return _y * _y == (_x * _x + param.a) * _x + param.b;
 	}
 	void set(const Fp& _x, const Fp& _y, bool verify = true)
 	{
@@ -124,6 +516,7 @@ public:
 				R.clear(); return;
 			}
 		}
+		const Param& param = getParam();
 #if MIE_EC_COORD == MIE_EC_USE_JACOBI
 		Fp S, M, t, y2;
 		Fp::square(y2, P.y);
@@ -131,7 +524,7 @@ public:
 		S += S;
 		S += S;
 		Fp::square(M, P.x);
-		switch (specialA_) {
+		switch (param.specialA) {
 		case zero:
 			Fp::add(t, M, M);
 			M += t;
@@ -147,7 +540,7 @@ public:
 		default:
 			Fp::square(t, P.z);
 			Fp::square(t, t);
-			t *= a_;
+			t *= param.a;
 			t += M;
 			M += M;
 			M += t;
@@ -167,7 +560,7 @@ public:
 		R.y -= y2;
 #elif MIE_EC_COORD == MIE_EC_USE_PROJ
 		Fp w, t, h;
-		switch (specialA_) {
+		switch (param.specialA) {
 		case zero:
 			Fp::square(w, P.x);
 			Fp::add(t, w, w);
@@ -183,7 +576,7 @@ public:
 		case generic:
 		default:
 			Fp::square(w, P.z);
-			w *= a_;
+			w *= param.a;
 			Fp::square(t, P.x);
 			w += t;
 			w += t;
@@ -214,7 +607,7 @@ public:
 		Fp::square(t, P.x);
 		Fp::add(s, t, t);
 		t += s;
-		t += a_;
+		t += param.a;
 		Fp::add(s, P.y, P.y);
 		t /= s;
 		Fp::square(s, t);
@@ -232,6 +625,16 @@ public:
 	{
 		if (P.isZero()) { R = Q; return; }
 		if (Q.isZero()) { R = P; return; }
+#if MIE_EC_COORD != MIE_EC_USE_AFFINE
+		if (Q.z.isOne()) {
+			addAffine(R, P, Q.x, Q.y);
+			return;
+		}
+		if (P.z.isOne()) {
+			addAffine(R, Q, P.x, P.y);
+			return;
+		}
+#endif
 #if MIE_EC_COORD == MIE_EC_USE_JACOBI
 		Fp r, U1, S1, H, H3;
 		Fp::square(r, P.z);
@@ -318,6 +721,77 @@ public:
 		s *= t;
 		Fp::sub(R.y, s, P.y);
 		R.x = x3;
+#endif
+	}
+	/*
+		R = P + (qx, qy) for an affine point(mixed addition)
+		Jacobi : 8M + 3S, Proj : 9M + 2S
+	*/
+	static inline void addAffine(EcT& R, const EcT& P, const Fp& qx, const Fp& qy)
+	{
+		if (P.isZero()) {
+			R.set(qx, qy, false);
+			return;
+		}
+#if MIE_EC_COORD == MIE_EC_USE_JACOBI
+		Fp r, H, H2, H3, U1H2;
+		Fp::square(H2, P.z);
+		Fp::mul(H, qx, H2);
+		H -= P.x; // U2 - U1
+		H2 *= P.z;
+		Fp::mul(r, qy, H2);
+		r -= P.y; // S2 - S1
+		if (H.isZero()) {
+			if (r.isZero()) {
+				dbl(R, P, false);
+			} else {
+				R.clear();
+			}
+			return;
+		}
+		Fp::square(H2, H);
+		Fp::mul(U1H2, P.x, H2);
+		Fp::mul(H3, H2, H);
+		Fp::mul(H2, H3, P.y); // S1 H^3
+		Fp::mul(R.z, P.z, H);
+		Fp::square(R.x, r);
+		R.x -= H3;
+		R.x -= U1H2;
+		R.x -= U1H2;
+		Fp::sub(R.y, U1H2, R.x);
+		R.y *= r;
+		R.y -= H2;
+#elif MIE_EC_COORD == MIE_EC_USE_PROJ
+		Fp r, u, v, A, vv;
+		Fp::mul(A, qy, P.z);
+		Fp::mul(v, qx, P.z);
+		v -= P.x;
+		if (v.isZero()) {
+			Fp::add(vv, A, P.y);
+			if (vv.isZero()) {
+				R.clear();
+			} else {
+				dbl(R, P, false);
+			}
+			return;
+		}
+		Fp::sub(u, A, P.y);
+		Fp::square(A, u);
+		Fp::square(vv, v);
+		Fp::mul(r, P.x, vv);
+		vv *= v;
+		A *= P.z;
+		A -= vv;
+		A -= r;
+		A -= r;
+		Fp::mul(R.z, P.z, vv);
+		vv *= P.y;
+		Fp::mul(R.x, v, A);
+		r -= A;
+		Fp::mul(R.y, u, r);
+		R.y -= vv;
+#else
+		add(R, P, EcT(qx, qy, false));
 #endif
 	}
 	static inline void sub(EcT& R, const EcT& P, const EcT& Q)
@@ -367,11 +841,712 @@ public:
 		R.z = P.z;
 #endif
 	}
+	/*
+		z = x^y by w-NAF(see powerWnaf)
+	*/
 	template<class N>
 	static inline void power(EcT& z, const EcT& x, const N& y)
 	{
 		power_impl::power(z, x, y);
 	}
+	static inline void setWnafWidth(int w)
+	{
+		if (w != 0 && (w < 4 || w > maxWnafWidth)) throw cybozu::Exception("EcT:setWnafWidth:bad w") << w;
+		wNafWidth_ = w;
+	}
+	/*
+		power runs powerCT instead of w-NAF or GLV if constTime is true
+		FixedBaseT::mul also uses powerCT
+	*/
+	static inline void setConstTime(bool constTime)
+	{
+		constTime_ = constTime;
+	}
+	static inline bool isConstTime() { return constTime_; }
+	static inline int getWnafWidth(size_t bitLen)
+	{
+		if (wNafWidth_) return wNafWidth_;
+		return bitLen < 128 ? 4 : bitLen <= 384 ? 5 : 6;
+	}
+	/*
+		z = x^y for y = y[n - 1] ... y[0] >= 0
+		precompute tbl[i] = (2i + 1)x for i < 2^(w-2)
+		and add or sub tbl[|d| / 2] for each non-zero digit d of w-NAF of y
+		about bitLen / (w + 1) additions instead of bitLen / 2
+	*/
+	template<class BlockType>
+	static inline void powerWnaf(EcT& z, const EcT& x, const BlockType *y, size_t n)
+	{
+		if (constTime_) {
+			powerCT(z, x, y, n);
+			return;
+		}
+		const size_t bitLen = ec_local::getBitLen(y, n);
+		if (bitLen < 16) {
+			// the table costs more
+			power_impl::powerArray(z, x, y, n);
+			return;
+		}
+		const Param& param = getParam();
+		if (param.isGlv && !x.isZero()) {
+			mpz_class k;
+			Gmp::setRaw(k, y, n);
+			k %= param.n;
+			powerGlv(z, x, k);
+			return;
+		}
+		const int w = getWnafWidth(bitLen);
+		std::vector<signed char> naf;
+		ec_local::getNaf(naf, y, n, w);
+		const size_t tblN = size_t(1) << (w - 2);
+		EcT tbl[size_t(1) << (maxWnafWidth - 2)];
+		tbl[0] = x;
+		EcT t;
+		dbl(t, x);
+		for (size_t i = 1; i < tblN; i++) {
+			add(tbl[i], tbl[i - 1], t);
+		}
+		// one inversion makes every addition below a mixed one
+		normalizeVec(tbl, tblN);
+		size_t i = naf.size() - 1;
+		z = tbl[naf[i] >> 1];
+		while (i > 0) {
+			i--;
+			dbl(z, z);
+			const int d = naf[i];
+			if (d > 0) {
+				add(z, z, tbl[d >> 1]);
+			} else if (d < 0) {
+				neg(t, tbl[-d >> 1]);
+				add(z, z, t);
+			}
+		}
+	}
+	/*
+		z = x^y for y = y[n - 1] ... y[0] >= 0 with the same sequence of operations
+		and memory accesses for all y of at most getModBitLen() + 1 bits
+		k = y + c is odd where c = 1 - (y & 1)
+		k = sum_{i < m} d_i 2^(wi) where every d_i is odd in (-2^w, 2^w)(regular recoding)
+		tbl[j] = (2j + 1)x in affine coordinates
+		z = tbl[d_{m-1} / 2] ; z = 2^w z + sign(d_i) tbl[|d_i| / 2] for each i
+		where tbl is read by masked loads of all entries(ctLookup)
+		z = z - cx is selected by a mask at last
+		the additions never meet P == Q or P == -Q if x has a prime order larger than 2^(w+1)
+		the time of Fp operations themselves depends on Fp
+		(FpT<Gmp> is not constant time)
+	*/
+	template<class BlockType>
+	static inline void powerCT(EcT& z, const EcT& x, const BlockType *y, size_t n)
+	{
+		if (x.isZero()) {
+			z.clear();
+			return;
+		}
+		size_t bitLen = Fp::getModBitLen() + 1;
+		// only for a scalar larger than the order of x
+		if (ec_local::getBitLen(y, n) > bitLen) bitLen = ec_local::getBitLen(y, n);
+		const int w = bitLen < 128 ? 4 : 5;
+		const size_t tblN = size_t(1) << (w - 1);
+		EcT tbl[16];
+		tbl[0] = x;
+		EcT t;
+		dbl(t, x);
+		for (size_t i = 1; i < tblN; i++) {
+			add(tbl[i], tbl[i - 1], t);
+		}
+		for (size_t i = 0; i < tblN; i++) {
+			if (tbl[i].isZero()) {
+				// x has a small order
+				power_impl::powerArray(z, x, y, n);
+				return;
+			}
+		}
+		normalizeVec(tbl, tblN);
+		cybozu::BitVector bx, by;
+		tbl[0].x.appendToBitVec(bx);
+		const size_t blockN = bx.getBlockSize();
+		// (x, y, -y) of tbl[i]
+		std::vector<uint64_t> words(tblN * blockN * 3);
+		for (size_t i = 0; i < tblN; i++) {
+			uint64_t *p = &words[i * blockN * 3];
+			Fp ny;
+			Fp::neg(ny, tbl[i].y);
+			const Fp *src[] = { &tbl[i].x, &tbl[i].y, &ny };
+			for (size_t j = 0; j < 3; j++) {
+				bx.clear();
+				src[j]->appendToBitVec(bx);
+				for (size_t k = 0; k < blockN; k++) p[j * blockN + k] = bx.getBlock()[k];
+			}
+		}
+		by = bx;
+		const size_t m = bitLen / w + 1;
+		std::vector<int> dig(m);
+		const int c0 = 1 - ec_local::getBits(y, n, 0, 1);
+		int c = c0;
+		for (size_t i = 0; i + 1 < m; i++) {
+			const int low = ec_local::getBits(y, n, i * w, w);
+			const int v = (ec_local::getBits(y, n, i * w, w + 1) + c) & ((1 << (w + 1)) - 1);
+			const int d = v - (1 << w);
+			c = (low + c - d) >> w;
+			dig[i] = d;
+		}
+		dig[m - 1] = ec_local::getBits(y, n, (m - 1) * w, w) + c;
+		ctLookup(z, &words[0], tblN, blockN, dig[m - 1], bx, by);
+		for (size_t i = m - 1; i > 0;) {
+			i--;
+			for (int j = 0; j < w; j++) {
+				dbl(z, z);
+			}
+			ctLookup(t, &words[0], tblN, blockN, dig[i], bx, by);
+			add(z, z, t);
+		}
+		// t = z - x
+		ctLookup(t, &words[0], tblN, blockN, -1, bx, by);
+		add(t, z, t);
+		ctSelect(z, t, c0);
+	}
+	/*
+		Q = sign(d) tbl[|d| / 2] for odd d by reading all entries
+		w[] : (x, y, -y) of tbl[i] for i < tblN
+	*/
+	static inline void ctLookup(EcT& Q, const uint64_t *w, size_t tblN, size_t blockN, int d, cybozu::BitVector& bx, cybozu::BitVector& by)
+	{
+		const int s = d >> (sizeof(int) * 8 - 1); // -1 if d < 0
+		const size_t idx = size_t((d ^ s) - s) >> 1;
+		const uint64_t negMask = uint64_t(int64_t(s));
+		uint64_t *px = bx.getBlock();
+		uint64_t *py = by.getBlock();
+		for (size_t k = 0; k < blockN; k++) {
+			px[k] = 0;
+			py[k] = 0;
+		}
+		for (size_t i = 0; i < tblN; i++) {
+			// all 1 if i == idx
+			const uint64_t mask = 0 - (uint64_t((i ^ idx) - 1) >> 63);
+			const uint64_t *e = w + i * blockN * 3;
+			for (size_t k = 0; k < blockN; k++) {
+				px[k] |= e[k] & mask;
+				py[k] |= ((e[blockN + k] & ~negMask) | (e[blockN * 2 + k] & negMask)) & mask;
+			}
+		}
+		Q.x.fromBitVec(bx);
+		Q.y.fromBitVec(by);
+		Q.z = 1;
+	}
+	/*
+		z = b ? t : z by a mask
+	*/
+	static inline void ctSelect(EcT& z, const EcT& t, int b)
+	{
+		const uint64_t mask = 0 - uint64_t(b & 1);
+		Fp *dst[] = { &z.x, &z.y, &z.z };
+		const Fp *src[] = { &t.x, &t.y, &t.z };
+		cybozu::BitVector bz, bt;
+		for (size_t j = 0; j < 3; j++) {
+			bz.clear();
+			bt.clear();
+			dst[j]->appendToBitVec(bz);
+			src[j]->appendToBitVec(bt);
+			uint64_t *pz = bz.getBlock();
+			const uint64_t *pt = bt.getBlock();
+			for (size_t k = 0; k < bz.getBlockSize(); k++) {
+				pz[k] = (pz[k] & ~mask) | (pt[k] & mask);
+			}
+			dst[j]->fromBitVec(bz);
+		}
+	}
+	/*
+		z = x^k for 0 <= k < n by GLV(see setGlv)
+		k = k1 + k2 lambda and x^k = x^k1 + phi(x)^k2
+		interleaved w-NAF of k1 and k2 with the half number of doublings
+		phi(X, Y, Z) = (beta X, Y, Z) so the table of phi(x) costs tblN multiplications
+	*/
+	static inline void powerGlv(EcT& z, const EcT& x, const mpz_class& k)
+	{
+		const Param& param = getParam();
+		mpz_class kk[2];
+		splitGlv(kk[0], kk[1], k);
+		bool isNeg[2];
+		for (int j = 0; j < 2; j++) {
+			isNeg[j] = kk[j] < 0;
+			if (isNeg[j]) kk[j] = -kk[j];
+		}
+		const int w = getWnafWidth(std::max(Gmp::getBitLen(kk[0]), Gmp::getBitLen(kk[1])));
+		std::vector<signed char> naf[2];
+		for (int j = 0; j < 2; j++) {
+			ec_local::getNaf(naf[j], Gmp::getBlock(kk[j]), Gmp::getBlockSize(kk[j]), w);
+		}
+		const size_t tblN = size_t(1) << (w - 2);
+		EcT tbl[2][size_t(1) << (maxWnafWidth - 2)];
+		tbl[0][0] = x;
+		EcT t;
+		dbl(t, x);
+		for (size_t i = 1; i < tblN; i++) {
+			add(tbl[0][i], tbl[0][i - 1], t);
+		}
+		normalizeVec(tbl[0], tblN);
+		for (size_t i = 0; i < tblN; i++) {
+			tbl[1][i] = tbl[0][i];
+			tbl[1][i].x *= param.beta;
+		}
+		for (int j = 0; j < 2; j++) {
+			if (!isNeg[j]) continue;
+			for (size_t i = 0; i < tblN; i++) {
+				neg(tbl[j][i], tbl[j][i]);
+			}
+		}
+		z.clear();
+		for (size_t i = std::max(naf[0].size(), naf[1].size()); i > 0;) {
+			i--;
+			dbl(z, z);
+			for (int j = 0; j < 2; j++) {
+				if (i >= naf[j].size()) continue;
+				const int d = naf[j][i];
+				if (d > 0) {
+					add(z, z, tbl[j][d >> 1]);
+				} else if (d < 0) {
+					neg(t, tbl[j][-d >> 1]);
+					add(z, z, t);
+				}
+			}
+		}
+	}
+	/*
+		(x[i], y[i]) = affine coordinates of P[i] for i < n with one inversion
+		P[i] must not be zero
+	*/
+	static inline void getAffineVec(Fp *x, Fp *y, const EcT *P, size_t n)
+	{
+#if MIE_EC_COORD == MIE_EC_USE_AFFINE
+		for (size_t i = 0; i < n; i++) {
+			x[i] = P[i].x;
+			y[i] = P[i].y;
+		}
+#else
+		if (n == 0) return;
+		std::vector<Fp> rz(n);
+		for (size_t i = 0; i < n; i++) {
+			rz[i] = P[i].z;
+		}
+		Fp::invVec(&rz[0], &rz[0], n);
+		for (size_t i = 0; i < n; i++) {
+#if MIE_EC_COORD == MIE_EC_USE_JACOBI
+			Fp rz2;
+			Fp::square(rz2, rz[i]);
+			Fp::mul(x[i], P[i].x, rz2);
+			rz2 *= rz[i];
+			Fp::mul(y[i], P[i].y, rz2);
+#else
+			Fp::mul(x[i], P[i].x, rz[i]);
+			Fp::mul(y[i], P[i].y, rz[i]);
+#endif
+		}
+#endif
+	}
+	/*
+		Straus is used for n <= mulVecStrausMaxN and Pippenger otherwise
+	*/
+	static const size_t mulVecStrausMaxN = 64;
+	/*
+		out = sum_{i < n} k[i] P[i]
+		Straus : interleaved w-NAF with one chain of doublings for all terms
+		Pippenger : bucket method whose buckets are summed up by batch affine additions
+		(one inversion per round for all buckets)
+	*/
+	template<class N>
+	static inline void mulVec(EcT& out, const EcT *P, const N *k, size_t n)
+	{
+		std::vector<EcT> Q;
+		std::vector<mpz_class> y; // |k[i]|
+		std::vector<char> isNeg;
+		Q.reserve(n);
+		y.reserve(n);
+		isNeg.reserve(n);
+		for (size_t i = 0; i < n; i++) {
+			if (P[i].isZero()) continue;
+			mpz_class t;
+			ec_local::toMpz(t, k[i]);
+			if (t == 0) continue;
+			Q.push_back(P[i]);
+			isNeg.push_back(t < 0);
+			if (t < 0) t = -t;
+			y.push_back(t);
+		}
+		const size_t m = Q.size();
+		if (m == 0) {
+			out.clear();
+			return;
+		}
+		std::vector<Fp> xs(m), ys(m);
+		getAffineVec(&xs[0], &ys[0], &Q[0], m);
+		for (size_t i = 0; i < m; i++) {
+			if (isNeg[i]) Fp::neg(ys[i], ys[i]);
+		}
+		if (m <= mulVecStrausMaxN) {
+			mulVecStraus(out, &xs[0], &ys[0], &y[0], m);
+		} else {
+			mulVecPippenger(out, &xs[0], &ys[0], &y[0], m);
+		}
+	}
+	/*
+		out = sum_i y[i] (xs[i], ys[i]) for y[i] > 0
+		tbl[i][j] = (2j + 1)(xs[i], ys[i]) in affine
+	*/
+	static inline void mulVecStraus(EcT& out, const Fp *xs, const Fp *ys, const mpz_class *y, size_t n)
+	{
+		size_t bitLen = 0;
+		for (size_t i = 0; i < n; i++) {
+			bitLen = std::max(bitLen, Gmp::getBitLen(y[i]));
+		}
+		const int w = getWnafWidth(bitLen);
+		const size_t tblN = size_t(1) << (w - 2);
+		std::vector<EcT> tbl(n * tblN);
+		for (size_t i = 0; i < n; i++) {
+			EcT *t = &tbl[i * tblN];
+			t[0].set(xs[i], ys[i], false);
+			EcT P2;
+			dbl(P2, t[0]);
+			for (size_t j = 1; j < tblN; j++) {
+				add(t[j], t[j - 1], P2);
+				if (t[j].isZero()) {
+					// P has a small order
+					out.clear();
+					for (size_t k = 0; k < n; k++) {
+						power(P2, EcT(xs[k], ys[k], false), y[k]);
+						out += P2;
+					}
+					return;
+				}
+			}
+		}
+		std::vector<Fp> tx(n * tblN), ty(n * tblN);
+		getAffineVec(&tx[0], &ty[0], &tbl[0], n * tblN);
+		std::vector<std::vector<signed char> > naf(n);
+		size_t nafN = 0;
+		for (size_t i = 0; i < n; i++) {
+			ec_local::getNaf(naf[i], Gmp::getBlock(y[i]), Gmp::getBlockSize(y[i]), w);
+			nafN = std::max(nafN, naf[i].size());
+		}
+		Fp t;
+		out.clear();
+		for (size_t pos = nafN; pos > 0;) {
+			pos--;
+			dbl(out, out);
+			for (size_t i = 0; i < n; i++) {
+				if (pos >= naf[i].size()) continue;
+				const int d = naf[i][pos];
+				if (d > 0) {
+					const size_t j = i * tblN + (d >> 1);
+					addAffine(out, out, tx[j], ty[j]);
+				} else if (d < 0) {
+					const size_t j = i * tblN + (-d >> 1);
+					Fp::neg(t, ty[j]);
+					addAffine(out, out, tx[j], t);
+				}
+			}
+		}
+	}
+	/*
+		out = sum_i y[i] (xs[i], ys[i]) for y[i] > 0
+		y[i] = sum_j d[i][j] 2^(cj) for d[i][j] in (-2^(c-1), 2^(c-1)]
+		for each window j from the top
+		out = 2^c out + sum_b b B_b where B_b = sum_{|d[i][j]| = b} sign(d[i][j]) P[i]
+	*/
+	static inline void mulVecPippenger(EcT& out, const Fp *xs, const Fp *ys, const mpz_class *y, size_t n)
+	{
+		size_t bitLen = 0;
+		for (size_t i = 0; i < n; i++) {
+			bitLen = std::max(bitLen, Gmp::getBitLen(y[i]));
+		}
+		size_t c = ec_local::getBitLen(&n, 1);
+		c = c < 6 ? 4 : c > 22 ? 20 : c - 2;
+		const size_t h = size_t(1) << (c - 1);
+		const size_t winN = (bitLen + c) / c;
+		std::vector<int> dig(n * winN);
+		for (size_t i = 0; i < n; i++) {
+			const Gmp::BlockType *py = Gmp::getBlock(y[i]);
+			const size_t yn = Gmp::getBlockSize(y[i]);
+			int carry = 0;
+			for (size_t j = 0; j < winN; j++) {
+				int d = ec_local::getBits(py, yn, j * c, c) + carry;
+				carry = d > int(h);
+				if (carry) d -= int(h * 2);
+				dig[i * winN + j] = d;
+			}
+		}
+		std::vector<Fp> bx(n), by(n);
+		std::vector<size_t> start(h + 1), cnt(h + 1), pos(h + 1);
+		out.clear();
+		for (size_t j = winN; j > 0;) {
+			j--;
+			for (size_t i = 0; i < c; i++) {
+				dbl(out, out);
+			}
+			// sort points by bucket
+			std::fill(cnt.begin(), cnt.end(), 0);
+			for (size_t i = 0; i < n; i++) {
+				const int d = dig[i * winN + j];
+				if (d) cnt[d > 0 ? d : -d]++;
+			}
+			size_t s = 0;
+			for (size_t b = 1; b <= h; b++) {
+				start[b] = pos[b] = s;
+				s += cnt[b];
+			}
+			for (size_t i = 0; i < n; i++) {
+				const int d = dig[i * winN + j];
+				if (d == 0) continue;
+				const size_t k = pos[d > 0 ? d : -d]++;
+				bx[k] = xs[i];
+				if (d > 0) {
+					by[k] = ys[i];
+				} else {
+					Fp::neg(by[k], ys[i]);
+				}
+			}
+			reduceBuckets(&bx[0], &by[0], &start[0], &cnt[0], h);
+			// sum_b b B_b = sum_b (B_h + ... + B_b)
+			EcT S, T;
+			for (size_t b = h; b > 0; b--) {
+				if (cnt[b]) addAffine(S, S, bx[start[b]], by[start[b]]);
+				add(T, T, S);
+			}
+			add(out, out, T);
+		}
+	}
+	/*
+		reduce cnt[b] affine points from (bx, by)[start[b]] to at most one for b = 1, ..., h
+		each round adds pairs in all buckets with one inversion
+	*/
+	static inline void reduceBuckets(Fp *bx, Fp *by, const size_t *start, size_t *cnt, size_t h)
+	{
+		enum { kAdd, kDbl, kZero };
+		const Param& param = getParam();
+		std::vector<Fp> den;
+		std::vector<char> kind;
+		for (;;) {
+			size_t pairN = 0;
+			for (size_t b = 1; b <= h; b++) {
+				pairN += cnt[b] / 2;
+			}
+			if (pairN == 0) return;
+			den.resize(pairN);
+			kind.resize(pairN);
+			size_t idx = 0;
+			for (size_t b = 1; b <= h; b++) {
+				const size_t s = start[b];
+				for (size_t p = 0; p < cnt[b] / 2; p++) {
+					const size_t i1 = s + p * 2, i2 = i1 + 1;
+					if (bx[i1] != bx[i2]) {
+						kind[idx] = kAdd;
+						Fp::sub(den[idx], bx[i2], bx[i1]);
+					} else if (by[i1] == by[i2] && !by[i1].isZero()) {
+						kind[idx] = kDbl;
+						Fp::add(den[idx], by[i1], by[i1]);
+					} else {
+						kind[idx] = kZero;
+						den[idx] = 1;
+					}
+					idx++;
+				}
+			}
+			Fp::invVec(&den[0], &den[0], pairN);
+			idx = 0;
+			Fp L, x3, y3;
+			for (size_t b = 1; b <= h; b++) {
+				const size_t s = start[b];
+				const size_t m = cnt[b];
+				size_t k = s;
+				for (size_t p = 0; p < m / 2; p++, idx++) {
+					const size_t i1 = s + p * 2, i2 = i1 + 1;
+					if (kind[idx] == kZero) continue;
+					if (kind[idx] == kAdd) {
+						Fp::sub(L, by[i2], by[i1]);
+					} else {
+						Fp::square(x3, bx[i1]);
+						Fp::add(L, x3, x3);
+						L += x3;
+						L += param.a;
+					}
+					L *= den[idx];
+					Fp::square(x3, L);
+					x3 -= bx[i1];
+					x3 -= bx[i2];
+					Fp::sub(y3, bx[i1], x3);
+					y3 *= L;
+					y3 -= by[i1];
+					bx[k] = x3;
+					by[k] = y3;
+					k++;
+				}
+				if (m & 1) {
+					bx[k] = bx[s + m - 1];
+					by[k] = by[s + m - 1];
+					k++;
+				}
+				cnt[b] = k - s;
+			}
+		}
+	}
+	/*
+		a base point which appears at least powerVecFixedBaseMinN times in powerVec
+		uses FixedBaseT
+	*/
+	static const size_t powerVecFixedBaseMinN = 4;
+	/*
+		out[i] = k[i] P[i] for i < n on threadN threads(0 means the number of processors)
+		all P[i] are normalized at first and equal P[i] are grouped, then
+		a group of at least powerVecFixedBaseMinN points shares a table of FixedBaseT
+		and the others use power
+		each thread takes chunks of indices from a shared counter until none is left
+		and normalizes its results with one inversion
+		threads use the curve parameter and the field context of the caller
+		k[i] are converted to mpz_class by the caller
+		so N may be FpT bound by FieldCtxT::Scope on the caller thread
+		out must not overlap P
+	*/
+	template<class N>
+	static inline void powerVec(EcT *out, const EcT *P, const N *k, size_t n, size_t threadN = 0)
+	{
+		if (n == 0) return;
+		if (threadN == 0) threadN = thread::getProcessorNum();
+		normalizeVec(P, n);
+		std::vector<size_t> idx(n);
+		for (size_t i = 0; i < n; i++) {
+			idx[i] = i;
+		}
+		std::sort(idx.begin(), idx.end(), IdxLess(P));
+		FixedBaseHolder holder;
+		std::vector<const FixedBaseT<Fp>*> fb(n);
+		for (size_t i = 0; i < n;) {
+			size_t j = i + 1;
+			while (j < n && compare(P[idx[i]], P[idx[j]]) == 0) j++;
+			const EcT& B = P[idx[i]];
+			const size_t m = j - i;
+			if (m >= powerVecFixedBaseMinN && !B.isZero()) {
+				FixedBaseT<Fp> *p = new FixedBaseT<Fp>();
+				holder.v.push_back(p);
+				try {
+					p->init(B, 0, m < 64 ? 4 : 6);
+					for (size_t t = i; t < j; t++) {
+						fb[idx[t]] = p;
+					}
+				} catch (cybozu::Exception&) {
+					// B has a small order
+				}
+			}
+			i = j;
+		}
+		std::vector<mpz_class> kz(n);
+		for (size_t i = 0; i < n; i++) {
+			ec_local::toMpz(kz[i], k[i]);
+		}
+		const size_t chunk = std::max<size_t>(1, n / (threadN * 8));
+		PowerVecTask task(out, P, &kz[0], n, &fb[0], chunk);
+		thread::run(task, std::min(threadN, (n + chunk - 1) / chunk));
+		if (task.hasErr) throw cybozu::Exception("EcT:powerVec") << task.err;
+	}
+private:
+	void normalizeSub(bool constTime) const
+	{
+#if MIE_EC_COORD == MIE_EC_USE_JACOBI
+		if (isZero() || z.isOne()) return;
+		Fp rz, rz2;
+		invSub(rz, z, constTime);
+		rz2 = rz * rz;
+		x *= rz2;
+		y *= rz2 * rz;
+		z = 1;
+#elif MIE_EC_COORD == MIE_EC_USE_PROJ
+		if (isZero() || z.isOne()) return;
+		Fp rz;
+		invSub(rz, z, constTime);
+		x *= rz;
+		y *= rz;
+		z = 1;
+#else
+		(void)constTime;
+#endif
+	}
+	static inline void invSub(Fp& y, const Fp& x, bool constTime)
+	{
+		if (constTime) {
+			ec_local::InvCT<Fp>::inv(y, x);
+		} else {
+			Fp::inv(y, x);
+		}
+	}
+	struct IdxLess {
+		const EcT *P;
+		explicit IdxLess(const EcT *P) : P(P) {}
+		bool operator()(size_t a, size_t b) const { return compare(P[a], P[b]) < 0; }
+	};
+	struct FixedBaseHolder {
+		std::vector<FixedBaseT<Fp>*> v;
+		~FixedBaseHolder()
+		{
+			for (size_t i = 0; i < v.size(); i++) {
+				delete v[i];
+			}
+		}
+	};
+	struct PowerVecTask {
+		EcT *out;
+		const EcT *P;
+		const mpz_class *k;
+		size_t n;
+		const FixedBaseT<Fp> *const *fb;
+		size_t chunk;
+		const Param *param;
+		ec_local::ThreadCtx<Fp> fieldCtx;
+		cybozu::Mutex m;
+		size_t next;
+		bool hasErr;
+		std::string err;
+		PowerVecTask(EcT *out, const EcT *P, const mpz_class *k, size_t n, const FixedBaseT<Fp> *const *fb, size_t chunk)
+			: out(out), P(P), k(k), n(n), fb(fb), chunk(chunk), param(curParam_), next(0), hasErr(false)
+		{
+		}
+		void operator()(size_t)
+		{
+			const Param *prev = curParam_;
+			curParam_ = param;
+			fieldCtx.bind();
+			std::vector<size_t> done;
+			try {
+				for (;;) {
+					size_t begin;
+					{
+						cybozu::AutoLock al(m);
+						begin = next;
+						next += chunk;
+					}
+					if (begin >= n) break;
+					const size_t end = std::min(begin + chunk, n);
+					for (size_t i = begin; i < end; i++) {
+						if (fb[i]) {
+							fb[i]->mul(out[i], k[i]);
+						} else {
+							power(out[i], P[i], k[i]);
+						}
+						done.push_back(i);
+					}
+				}
+				if (!done.empty()) normalizeIdx(out, &done[0], done.size());
+			} catch (std::exception& e) {
+				cybozu::AutoLock al(m);
+				if (!hasErr) {
+					hasErr = true;
+					err = e.what();
+				}
+			}
+			curParam_ = prev;
+		}
+	private:
+		PowerVecTask(const PowerVecTask&);
+		void operator=(const PowerVecTask&);
+	};
+public:
 	/*
 		0 <= P for any P
 		(Px, Py) <= (P'x, P'y) iff Px < P'x or Px == P'x and Py <= P'y
@@ -390,6 +1565,74 @@ public:
 		if (c < 0) return -1;
 		return _Fp::compare(P.y, Q.y);
 	}
+	/*
+		P == Q without inversion
+		Jacobi : X1 Z2^2 == X2 Z1^2 and Y1 Z2^3 == Y2 Z1^3
+		Proj : X1 Z2 == X2 Z1 and Y1 Z2 == Y2 Z1
+	*/
+	static inline bool isEqual(const EcT& P, const EcT& Q)
+	{
+#if MIE_EC_COORD == MIE_EC_USE_AFFINE
+		if (P.isZero() || Q.isZero()) return P.isZero() && Q.isZero();
+		return P.x == Q.x && P.y == Q.y;
+#else
+		const bool zeroP = P.isZero();
+		const bool zeroQ = Q.isZero();
+		if (zeroP || zeroQ) return zeroP && zeroQ;
+		const bool oneP = P.z.isOne();
+		const bool oneQ = Q.z.isOne();
+		if (oneP && oneQ) return P.x == Q.x && P.y == Q.y;
+		if (oneP) return isEqualAffine(Q, P.x, P.y);
+		if (oneQ) return isEqualAffine(P, Q.x, Q.y);
+		Fp s1, s2, t1, t2;
+#if MIE_EC_COORD == MIE_EC_USE_JACOBI
+		Fp::square(s1, P.z);
+		Fp::square(s2, Q.z);
+		Fp::mul(t1, P.x, s2);
+		Fp::mul(t2, Q.x, s1);
+		if (t1 != t2) return false;
+		s1 *= P.z;
+		s2 *= Q.z;
+		Fp::mul(t1, P.y, s2);
+		Fp::mul(t2, Q.y, s1);
+		return t1 == t2;
+#else
+		Fp::mul(t1, P.x, Q.z);
+		Fp::mul(t2, Q.x, P.z);
+		if (t1 != t2) return false;
+		Fp::mul(t1, P.y, Q.z);
+		Fp::mul(t2, Q.y, P.z);
+		return t1 == t2;
+#endif
+#endif
+	}
+#if MIE_EC_COORD != MIE_EC_USE_AFFINE
+	/*
+		P == (qx, qy) for P != 0
+	*/
+	static inline bool isEqualAffine(const EcT& P, const Fp& qx, const Fp& qy)
+	{
+		Fp s, t;
+#if MIE_EC_COORD == MIE_EC_USE_JACOBI
+		Fp::square(s, P.z);
+		Fp::mul(t, qx, s);
+		if (t != P.x) return false;
+		s *= P.z;
+#else
+		Fp::mul(t, qx, P.z);
+		if (t != P.x) return false;
+		s = P.z;
+#endif
+		Fp::mul(t, qy, s);
+		return t == P.y;
+	}
+#endif
+	bool operator==(const EcT& rhs) const { return isEqual(*this, rhs); }
+	bool operator!=(const EcT& rhs) const { return !operator==(rhs); }
+	bool operator<(const EcT& rhs) const { return compare(*this, rhs) < 0; }
+	bool operator>=(const EcT& rhs) const { return !operator<(rhs); }
+	bool operator>(const EcT& rhs) const { return compare(*this, rhs) > 0; }
+	bool operator<=(const EcT& rhs) const { return !operator>(rhs); }
 	bool isZero() const
 	{
 #if MIE_EC_COORD == MIE_EC_USE_AFFINE
@@ -431,16 +1674,18 @@ public:
 			if (compressedExpression_) {
 				const char c = str[pos + 1];
 				if ((c == '0' || c == '1') && str.size() == pos + 2) {
-					getYfromX(self.y, self.x, c == '1');
+					if (!getYfromX(self.y, self.x, c == '1')) {
+						throw cybozu::Exception("EcT:operator>>:bad x") << self.x;
+					}
 				} else {
 					str[pos] = '_';
 					throw cybozu::Exception("EcT:operator>>:bad y") << str;
 				}
 			} else {
 				self.y.fromStr(&str[pos + 1], 16);
-			}
-			if (!EcT::isValid(self.x, self.y)) {
-				throw cybozu::Exception("EcT:operator>>:bad x, y") << self.x << self.y;
+				if (!EcT::isValid(self.x, self.y)) {
+					throw cybozu::Exception("EcT:operator>>:bad x, y") << self.x << self.y;
+				}
 			}
 		}
 		return is;
@@ -497,16 +1742,148 @@ public:
 		x.fromBitVec(t);
 		if (compressedExpression_) {
 			bool odd = bv.get(bitLen); // y
-			getYfromX(y, x, odd);
+			if (!getYfromX(y, x, odd)) {
+				throw cybozu::Exception("fromBitVec:bad x") << x;
+			}
 		} else {
 			bv.extract(t, bitLen, bitLen);
 			y.fromBitVec(t);
+			if (!isValid(x, y)) {
+				throw cybozu::Exception("fromBitVec:bad x, y") << x << y;
+			}
+		}
+		z = 1;
+#endif
+	}
+	/*
+		append P[0], ..., P[n - 1] to bv with one inversion
+		each point occupies getBitVecSize() bits
+	*/
+	static inline void appendVecToBitVec(cybozu::BitVector& bv, const EcT *P, size_t n)
+	{
+		normalizeVec(P, n);
+		for (size_t i = 0; i < n; i++) {
+			P[i].appendToBitVec(bv);
+		}
+	}
+	/*
+		read n points appended by appendVecToBitVec
+	*/
+	static inline void fromBitVecVec(EcT *P, size_t n, const cybozu::BitVector& bv)
+	{
+		const size_t size = getBitVecSize();
+		if (bv.size() != size * n) {
+			throw cybozu::Exception("EcT:fromBitVecVec:bad size") << bv.size() << size << n;
+		}
+		cybozu::BitVector t;
+		for (size_t i = 0; i < n; i++) {
+			bv.extract(t, size * i, size);
+			P[i].fromBitVec(t);
+		}
+	}
+	/*
+		SEC1 encoding of the fixed size getSerializedSize()
+		n = Fp::getByteSize()
+		02|x or 03|x(y is odd) : 1 + n bytes if compressedExpression_
+		04|x|y                 : 1 + 2n bytes otherwise
+		0 is 00 followed by zeros to keep the size fixed
+		return getSerializedSize()
+	*/
+	size_t serialize(void *buf, size_t bufSize) const
+	{
+		const size_t size = getSerializedSize();
+		if (bufSize < size) throw cybozu::Exception("EcT:serialize:small buf") << bufSize << size;
+		uint8_t *p = (uint8_t*)buf;
+		if (isZero()) {
+			memset(p, 0, size);
+			return size;
+		}
+		normalize();
+		const size_t n = Fp::getByteSize();
+		x.serialize(p + 1, n);
+		if (compressedExpression_) {
+			p[0] = Fp::isYodd(y) ? 3 : 2;
+		} else {
+			p[0] = 4;
+			y.serialize(p + 1 + n, n);
+		}
+		return size;
+	}
+	/*
+		read a point written by serialize
+		skip isValid for 04|x|y if verify is false(only for trusted data)
+		02|x and 03|x are always checked by getYfromX
+		return getSerializedSize()
+	*/
+	size_t deserialize(const void *buf, size_t bufSize, bool verify = true)
+	{
+		const size_t size = getSerializedSize();
+		if (bufSize < size) throw cybozu::Exception("EcT:deserialize:small buf") << bufSize << size;
+		const uint8_t *p = (const uint8_t*)buf;
+		if (p[0] == 0) {
+			for (size_t i = 1; i < size; i++) {
+				if (p[i]) throw cybozu::Exception("EcT:deserialize:bad zero") << i;
+			}
+			clear();
+			return size;
 		}
-		if (!isValid(x, y)) {
-			throw cybozu::Exception("fromBitVec:bad x, y") << x << y;
+		const size_t n = Fp::getByteSize();
+		const bool isGoodHeader = compressedExpression_ ? (p[0] == 2 || p[0] == 3) : p[0] == 4;
+		if (!isGoodHeader) {
+			throw cybozu::Exception("EcT:deserialize:bad header") << int(p[0]);
 		}
+		x.deserialize(p + 1, n);
+		if (compressedExpression_) {
+			if (!getYfromX(y, x, p[0] == 3)) {
+				throw cybozu::Exception("EcT:deserialize:bad x") << x;
+			}
+		} else {
+			y.deserialize(p + 1 + n, n);
+			if (verify && !isValid(x, y)) {
+				throw cybozu::Exception("EcT:deserialize:bad x, y") << x << y;
+			}
+		}
+#if MIE_EC_COORD == MIE_EC_USE_AFFINE
+		inf_ = false;
+#else
 		z = 1;
 #endif
+		return size;
+	}
+	/*
+		serialize P[0], ..., P[n - 1] to buf with one inversion
+		return getSerializedSize() * n
+	*/
+	static inline size_t serializeVec(void *buf, size_t bufSize, const EcT *P, size_t n)
+	{
+		const size_t size = getSerializedSize();
+		if (bufSize / size < n) throw cybozu::Exception("EcT:serializeVec:small buf") << bufSize << size << n;
+		normalizeVec(P, n);
+		uint8_t *p = (uint8_t*)buf;
+		for (size_t i = 0; i < n; i++) {
+			P[i].serialize(p + size * i, size);
+		}
+		return size * n;
+	}
+	/*
+		read n points written by serializeVec
+		verify is the same as deserialize
+		return getSerializedSize() * n
+	*/
+	static inline size_t deserializeVec(EcT *P, size_t n, const void *buf, size_t bufSize, bool verify = true)
+	{
+		const size_t size = getSerializedSize();
+		if (bufSize / size < n) throw cybozu::Exception("EcT:deserializeVec:small buf") << bufSize << size << n;
+		const uint8_t *p = (const uint8_t*)buf;
+		for (size_t i = 0; i < n; i++) {
+			P[i].deserialize(p + size * i, size, verify);
+		}
+		return size * n;
+	}
+	static inline size_t getSerializedSize()
+	{
+		const size_t n = Fp::getByteSize();
+		return compressedExpression_ ? 1 + n : 1 + n * 2;
 	}
 	static inline size_t getBitVecSize()
 	{
@@ -517,17 +1894,39 @@ public:
 			return bitLen * 2 + 1;;
 		}
 	}
-	static inline void getYfromX(Fp& y, const Fp& x, bool isYodd)
+	/*
+		get y such that (x, y) is on the curve and isYodd(y) == isYodd
+		return false if there is no such y
+		(x, y) need not be checked by isValid if true
+	*/
+	static inline bool getYfromX(Fp& y, const Fp& x, bool isYodd)
 	{
+		const Param& param = getParam();
 		Fp t;
 		Fp::square(t, x);
-		t += a_;
+		t += param.a;
 		t *= x;
-		t += b_;
-		Fp::squareRoot(y, t);
+		t += param.b;
+		if (!Fp::squareRoot(y, t)) return false;
 		if (Fp::isYodd(y) ^ isYodd) {
 			Fp::neg(y, y);
 		}
+		return true;
+	}
+	/*
+		P[i] = (x[i], y) where isYodd(y) == isYodd[i] for i < n
+		square roots stay in Fp and replace isValid for each point
+		throw if some x[i] is not on the curve
+	*/
+	static inline void decompressVec(EcT *P, const Fp *x, const bool *isYodd, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) {
+			if (!getYfromX(P[i].y, x[i], isYodd[i])) {
+				throw cybozu::Exception("EcT:decompressVec:bad x") << i << x[i];
+			}
+			P[i].x = x[i];
+			P[i].z = 1;
+		}
 	}
 };
 
@@ -555,10 +1954,321 @@ struct TagMultiGr<EcT<T> > {
 	}
 };
 
-template<class _Fp> _Fp EcT<_Fp>::a_;
-template<class _Fp> _Fp EcT<_Fp>::b_;
-template<class _Fp> int EcT<_Fp>::specialA_;
+template<class _Fp> typename EcT<_Fp>::Param EcT<_Fp>::param_;
+template<class _Fp> MIE_THREAD_LOCAL const typename EcT<_Fp>::Param *EcT<_Fp>::curParam_ = &EcT<_Fp>::param_;
 template<class _Fp> bool EcT<_Fp>::compressedExpression_;
+template<class _Fp> int EcT<_Fp>::wNafWidth_;
+template<class _Fp> bool EcT<_Fp>::constTime_;
+
+namespace power_impl {
+
+template<class T>
+struct TagPower<EcT<T> > {
+	template<class BlockType>
+	static void powerArray(EcT<T>& z, const EcT<T>& x, const BlockType *y, size_t n)
+	{
+		EcT<T>::powerWnaf(z, x, y, n);
+	}
+};
+
+} // mie::power_impl
+
+/*
+	curve context for EcT<_Fp>
+	EcT uses the parameter set by EcT::setParam on every thread by default
+	and uses ctx on the current thread in the lifetime of CurveCtxT::Scope(ctx)
+	use it with the field context of the curve if Fp has it
+	ex.
+	FieldCtx fctx(p);
+	CurveCtx cctx;
+	{
+		FieldCtx::Scope fs(fctx);
+		cctx.setParam(a, b);
+		CurveCtx::Scope cs(cctx);
+		Ec P(x, y); Ec::power(P, P, n);
+	}
+*/
+template<class _Fp>
+class CurveCtxT {
+	typedef EcT<_Fp> Ec;
+	typename Ec::Param param_;
+	CurveCtxT(const CurveCtxT&);
+	void operator=(const CurveCtxT&);
+public:
+	CurveCtxT() {}
+	/*
+		must be called in the context of Fp for the curve
+	*/
+	void setParam(const std::string& astr, const std::string& bstr)
+	{
+		Ec::initParam(param_, astr, bstr);
+	}
+	/*
+		G may be made out of Scope with EcT(x, y, false)
+	*/
+	void setGlv(const std::string& betaStr, const std::string& lambdaStr, const std::string& nStr, const Ec& G)
+	{
+		Ec::initGlv(param_, betaStr, lambdaStr, nStr, G);
+	}
+	const typename Ec::Param& getParam() const { return param_; }
+	/*
+		bind ctx to the current thread and restore the previous one at exit
+	*/
+	class Scope {
+		const typename Ec::Param *prev_;
+		Scope(const Scope&);
+		void operator=(const Scope&);
+	public:
+		explicit Scope(const CurveCtxT& ctx)
+			: prev_(Ec::curParam_)
+		{
+			Ec::curParam_ = &ctx.param_;
+		}
+		~Scope()
+		{
+			Ec::curParam_ = prev_;
+		}
+	};
+};
+
+/*
+	fixed-base scalar multiplication for EcT<_Fp>
+	init(P, bitLen, w) makes a table of affine points
+	tbl[j][d - 1] = d 2^(wj) P for d = 1, ..., 2^(w-1) and j < (bitLen + w) / w
+	mul(Q, y) sets Q = yP by (bitLen + w) / w mixed additions without doubling
+	where y = sum_j d_j 2^(wj) for d_j in (-2^(w-1), 2^(w-1)]
+	each entry is aligned to a cache line
+	serialize writes the table as bytes and initView uses them in place
+	(see fixed_base_file.hpp and ec_local::FpEntry for the form of a coordinate)
+*/
+template<class _Fp>
+class FixedBaseT {
+	typedef EcT<_Fp> Ec;
+	typedef _Fp Fp;
+	struct Affine {
+		Fp x, y;
+	};
+	static const size_t cacheLineSize = 64;
+	Ec P_;
+	size_t bitLen_;
+	int w_;
+	size_t winN_;
+	size_t tblN_; // number of entries per window
+	size_t stride_;
+	char *buf_;
+	char *tbl_; // aligned buf_
+	const uint8_t *view_; // table of serialize used by initView
+	FixedBaseT(const FixedBaseT&);
+	void operator=(const FixedBaseT&);
+	// d 2^(wj) P
+	Affine& get(size_t j, size_t d)
+	{
+		return *reinterpret_cast<Affine*>(tbl_ + ((j * tblN_) + d - 1) * stride_);
+	}
+	const Affine& get(size_t j, size_t d) const
+	{
+		return *reinterpret_cast<const Affine*>(tbl_ + ((j * tblN_) + d - 1) * stride_);
+	}
+	void release()
+	{
+		if (buf_ == 0) return;
+		for (size_t i = 0, n = winN_ * tblN_; i < n; i++) {
+			reinterpret_cast<Affine*>(tbl_ + i * stride_)->~Affine();
+		}
+		delete[] buf_;
+		buf_ = 0;
+		tbl_ = 0;
+	}
+	void setSize(const Ec& P, size_t bitLen, int w)
+	{
+		if (w < 1 || w > maxW) throw cybozu::Exception("FixedBaseT:setSize:bad w") << w;
+		if (bitLen == 0) bitLen = Fp::getModBitLen() + 1;
+		release();
+		view_ = 0;
+		P_ = P;
+		bitLen_ = bitLen;
+		w_ = w;
+		winN_ = (bitLen + w) / w;
+		tblN_ = size_t(1) << (w - 1);
+	}
+public:
+	static const int maxW = 8;
+	FixedBaseT() : P_(), bitLen_(0), w_(0), winN_(0), tblN_(0), stride_(0), buf_(0), tbl_(0), view_(0) {}
+	FixedBaseT(const Ec& P, size_t bitLen = 0, int w = 6)
+		: P_(), bitLen_(0), w_(0), winN_(0), tblN_(0), stride_(0), buf_(0), tbl_(0), view_(0)
+	{
+		init(P, bitLen, w);
+	}
+	~FixedBaseT() { release(); }
+	/*
+		bitLen : max bit length of a scalar(0 means the bit length of p + 1)
+		w : window size(1 <= w <= maxW)
+		table size is (bitLen + w) / w * 2^(w-1) points
+	*/
+	void init(const Ec& P, size_t bitLen = 0, int w = 6)
+	{
+		setSize(P, bitLen, w);
+		stride_ = (sizeof(Affine) + cacheLineSize - 1) & ~(cacheLineSize - 1);
+		const size_t n = winN_ * tblN_;
+		buf_ = new char[n * stride_ + cacheLineSize - 1];
+		tbl_ = buf_ + ((cacheLineSize - size_t(buf_) % cacheLineSize) % cacheLineSize);
+		for (size_t i = 0; i < n; i++) {
+			new(tbl_ + i * stride_) Affine();
+		}
+		std::vector<Ec> T(n);
+		Ec B = P;
+		for (size_t j = 0; j < winN_; j++) {
+			Ec *t = &T[j * tblN_];
+			t[0] = B;
+			for (size_t d = 1; d <= tblN_; d++) {
+				if (d > 1) Ec::add(t[d - 1], t[d - 2], B);
+				if (t[d - 1].isZero()) throw cybozu::Exception("FixedBaseT:init:small order") << d << j;
+			}
+			// B = 2^w B = 2 (2^(w-1) B)
+			Ec::dbl(B, t[tblN_ - 1]);
+		}
+		Ec::normalizeVec(&T[0], n);
+		for (size_t j = 0; j < winN_; j++) {
+			for (size_t d = 1; d <= tblN_; d++) {
+				const Ec& S = T[j * tblN_ + d - 1];
+				Affine& e = get(j, d);
+				e.x = S.x;
+				e.y = S.y;
+			}
+		}
+	}
+	/*
+		Q = yP for y = y[n - 1] ... y[0] >= 0
+	*/
+	template<class BlockType>
+	void mulArray(Ec& Q, const BlockType *y, size_t n) const
+	{
+		if (Ec::isConstTime()) {
+			Ec::powerCT(Q, P_, y, n);
+			return;
+		}
+		if (ec_local::getBitLen(y, n) > bitLen_) {
+			power_impl::TagPower<Ec>::powerArray(Q, P_, y, n);
+			return;
+		}
+		const int half = 1 << (w_ - 1);
+		const size_t byteSize = ec_local::FpEntry<Fp>::getByteSize();
+		const size_t viewStride = getSerializedStride();
+		Fp t, vx, vy;
+		Q.clear();
+		int carry = 0;
+		for (size_t j = 0; j < winN_; j++) {
+			int d = ec_local::getBits(y, n, j * w_, w_) + carry;
+			carry = d > half;
+			if (carry) d -= 1 << w_;
+			if (d == 0) continue;
+			const size_t a = size_t(d > 0 ? d : -d);
+			const Fp *px, *py;
+			if (view_) {
+				const uint8_t *p = view_ + ((j * tblN_) + a - 1) * viewStride;
+				ec_local::FpEntry<Fp>::read(vx, p);
+				ec_local::FpEntry<Fp>::read(vy, p + byteSize);
+				px = &vx;
+				py = &vy;
+			} else {
+				const Affine& e = get(j, a);
+				px = &e.x;
+				py = &e.y;
+			}
+			if (d < 0) {
+				Fp::neg(t, *py);
+				py = &t;
+			}
+			Ec::addAffine(Q, Q, *px, *py);
+		}
+		assert(carry == 0);
+	}
+	template<class N>
+	void mul(Ec& Q, const N& y) const
+	{
+		typedef power_impl::TagInt<N> TagI;
+		const bool isNegative = y < 0;
+		const N& t = isNegative ? -y : y;
+		mulArray(Q, TagI::getBlock(t), TagI::getBlockSize(t));
+		if (isNegative) Ec::neg(Q, Q);
+	}
+	// for FpT of fp2.hpp
+	template<class tag, size_t maxBitN, template<class _tag, size_t _maxBitN>class F>
+	void mul(Ec& Q, const F<tag, maxBitN>& y) const
+	{
+		mpz_class t;
+		y.toGmp(t);
+		mul(Q, t);
+	}
+	/*
+		byte size of an entry of serialize
+		x || y of ec_local::FpEntry padded with zeros to a multiple of a cache line
+	*/
+	static inline size_t getSerializedStride()
+	{
+		return (ec_local::FpEntry<Fp>::getByteSize() * 2 + cacheLineSize - 1) & ~(cacheLineSize - 1);
+	}
+	size_t getSerializedSize() const { return winN_ * tblN_ * getSerializedStride(); }
+	/*
+		write the entry of d 2^(wj) P to buf + ((j tblN + d - 1) getSerializedStride())
+		return getSerializedSize()
+	*/
+	size_t serialize(void *buf, size_t bufSize) const
+	{
+		const size_t size = getSerializedSize();
+		if (bufSize < size) throw cybozu::Exception("FixedBaseT:serialize:small buf") << bufSize << size;
+		if (view_) {
+			memcpy(buf, view_, size);
+			return size;
+		}
+		const size_t byteSize = ec_local::FpEntry<Fp>::getByteSize();
+		const size_t stride = getSerializedStride();
+		uint8_t *p = (uint8_t*)buf;
+		memset(p, 0, size);
+		for (size_t j = 0; j < winN_; j++) {
+			for (size_t d = 1; d <= tblN_; d++) {
+				const Affine& e = get(j, d);
+				uint8_t *q = p + ((j * tblN_) + d - 1) * stride;
+				ec_local::FpEntry<Fp>::write(q, e.x);
+				ec_local::FpEntry<Fp>::write(q + byteSize, e.y);
+			}
+		}
+		return size;
+	}
+	/*
+		use tbl[0, getSerializedSize()) written by serialize for the same P, bitLen and w
+		in place without copying it
+		tbl must be aligned to 8 bytes and must not be modified or freed while this object uses it
+		an entry is copied for each addition and is not checked(see verifyView)
+	*/
+	void initView(const Ec& P, size_t bitLen, int w, const void *tbl)
+	{
+		setSize(P, bitLen, w);
+		view_ = (const uint8_t*)tbl;
+	}
+	/*
+		return true if every entry of the view is a point on the curve
+		or this object does not use a view
+	*/
+	bool verifyView() const
+	{
+		if (view_ == 0) return true;
+		typedef ec_local::FpEntry<Fp> Entry;
+		const size_t byteSize = Entry::getByteSize();
+		const size_t stride = getSerializedStride();
+		Fp x, y;
+		for (size_t i = 0, n = winN_ * tblN_; i < n; i++) {
+			const uint8_t *p = view_ + i * stride;
+			Entry::read(x, p);
+			Entry::read(y, p + byteSize);
+			if (!Entry::isValid(x) || !Entry::isValid(y) || !Ec::isValid(x, y)) return false;
+		}
+		return true;
+	}
+	const Ec& getBase() const { return P_; }
+	size_t getBitLen() const { return bitLen_; }
+	int getWindowSize() const { return w_; }
+};
 
 struct EcParam {
 	const char *name;
@@ -571,6 +2281,16 @@ struct EcParam {
 	size_t bitLen; // bit length of p
 };
 
+/*
+	endomorphism phi(x, y) = (beta x, y) = lambda (x, y) of a curve with a = 0
+	see EcT::setGlv
+*/
+struct EcGlvParam {
+	const char *name;
+	const char *beta;
+	const char *lambda;
+};
+
 } // mie
 
 #ifndef MIE_DONT_DEFINE_HASH
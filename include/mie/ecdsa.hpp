@@ -0,0 +1,288 @@
+#pragma once
+/**
+	@file
+	@brief ECDSA
+	@author MITSUNARI Shigeo(@herumi)
+	@license modified new BSD license
+	http://opensource.org/licenses/BSD-3-Clause
+*/
+#include <vector>
+#include <mie/power_cache.hpp>
+
+namespace mie {
+
+/*
+	ECDSA over EcT<_Fp> with the base point G of the order n
+	Zn must be set to modulo n
+
+	sign : R = kG by EcT::powerCT, r = R.x mod n, s = (h + r sec) / k
+	the secret scalars k and sec are multiplied by EcT::powerCT regardless of EcT::isConstTime
+	and the inversions of R.z and kb run in constant time if Fp and Zn have invCT(FpT of fp2.hpp)
+	sign also computes 1/k = b/(kb) with a random b to hide k from Zn::inv of the other types
+	verify : R = u1 G + u2 Q for u1 = h / s, u2 = r / s and check R.x mod n == r
+
+	u1 G + u2 Q is computed by one chain of doublings(Straus/Shamir)
+	tblG[i] = (2i + 1)G for i < 2^(wG-2) is precomputed in affine coordinates,
+	so u1 costs bitLen / (wG + 1) mixed additions and no doubling
+	Q uses w-NAF of EcT::getWnafWidth with a table made by one inversion
+	or w-NAF of PowerCacheT::getWindowSize with the cached table if setCache is called
+	if GLV is enabled then u1 and u2 are split to four scalars of the half length
+*/
+template<class _Fp, class _Zn>
+class EcdsaT {
+public:
+	typedef _Fp Fp;
+	typedef _Zn Zn;
+	typedef EcT<Fp> Ec;
+	struct Signature {
+		Zn r, s;
+	};
+	// a digit of w-NAF must fit in signed char
+	static const int maxW = 8;
+private:
+	Ec G_;
+	mpz_class n_;
+	size_t nBitLen_;
+	int wG_;
+	/*
+		tbl_[i] = (2i + 1)G for i < 2^(wG-2)
+		followed by phi(tbl_[i]) if GLV is enabled at init
+	*/
+	std::vector<Fp> tx_, ty_;
+	bool hasPhi_;
+	PowerCacheT<Fp> *cache_;
+	EcdsaT(const EcdsaT&);
+	void operator=(const EcdsaT&);
+	struct Stream {
+		std::vector<signed char> naf;
+		const Fp *x;
+		const Fp *y;
+		bool isNeg;
+	};
+	static inline void setStream(Stream& st, mpz_class& k, int w, const Fp *x, const Fp *y)
+	{
+		st.isNeg = k < 0;
+		if (st.isNeg) k = -k;
+		ec_local::getNaf(st.naf, Gmp::getBlock(k), Gmp::getBlockSize(k), w);
+		st.x = x;
+		st.y = y;
+	}
+	// R = aG + bQ by a chain of doublings for 0 <= a, b < n
+	void mulAddMpz(Ec& R, const mpz_class& a, const Ec& Q, const mpz_class& b) const
+	{
+		const typename Ec::Param& param = Ec::getParam();
+		const bool useGlv = hasPhi_ && param.isGlv;
+		size_t bitLen = nBitLen_;
+		if (useGlv) bitLen = bitLen / 2 + 1;
+		const int wQ = cache_ ? cache_->getWindowSize() : Ec::getWnafWidth(bitLen);
+		const size_t tblGN = size_t(1) << (wG_ - 2);
+		const size_t tblQN = size_t(1) << (wQ - 2);
+		std::vector<Fp> qx(tblQN * 2), qy(tblQN * 2);
+		const bool hasTbl = cache_ ? cache_->getTable(&qx[0], &qy[0], Q) : PowerCacheT<Fp>::makeTable(&qx[0], &qy[0], Q, tblQN);
+		if (!hasTbl) {
+			// Q is zero or has a small order
+			Ec S;
+			Ec::power(R, G_, a);
+			Ec::power(S, Q, b);
+			R += S;
+			return;
+		}
+		Stream st[4];
+		size_t stN = 0;
+		if (useGlv) {
+			for (size_t i = 0; i < tblQN; i++) {
+				Fp::mul(qx[tblQN + i], qx[i], param.beta);
+				qy[tblQN + i] = qy[i];
+			}
+			mpz_class k1, k2;
+			Ec::splitGlv(k1, k2, a);
+			setStream(st[stN++], k1, wG_, &tx_[0], &ty_[0]);
+			setStream(st[stN++], k2, wG_, &tx_[tblGN], &ty_[tblGN]);
+			Ec::splitGlv(k1, k2, b);
+			setStream(st[stN++], k1, wQ, &qx[0], &qy[0]);
+			setStream(st[stN++], k2, wQ, &qx[tblQN], &qy[tblQN]);
+		} else {
+			mpz_class k = a;
+			setStream(st[stN++], k, wG_, &tx_[0], &ty_[0]);
+			k = b;
+			setStream(st[stN++], k, wQ, &qx[0], &qy[0]);
+		}
+		size_t nafN = 0;
+		for (size_t j = 0; j < stN; j++) {
+			nafN = std::max(nafN, st[j].naf.size());
+		}
+		Fp t;
+		R.clear();
+		for (size_t pos = nafN; pos > 0;) {
+			pos--;
+			Ec::dbl(R, R);
+			for (size_t j = 0; j < stN; j++) {
+				const Stream& s = st[j];
+				if (pos >= s.naf.size()) continue;
+				const int d = s.naf[pos];
+				if (d == 0) continue;
+				const size_t idx = (d > 0 ? d : -d) >> 1;
+				if ((d < 0) ^ s.isNeg) {
+					Fp::neg(t, s.y[idx]);
+					Ec::addAffine(R, R, s.x[idx], t);
+				} else {
+					Ec::addAffine(R, R, s.x[idx], s.y[idx]);
+				}
+			}
+		}
+	}
+	// r = R.x mod n for R != 0
+	void getXmodN(Zn& r, const Ec& R) const
+	{
+		R.normalize();
+		std::vector<uint8_t> buf(Fp::getByteSize());
+		R.x.serialize(&buf[0], buf.size());
+		mpz_class x;
+		mpz_import(x.get_mpz_t(), buf.size(), 1, 1, 1, 0, &buf[0]);
+		ec_local::fromMpz(r, x, n_);
+	}
+	// R = kG for a secret k by EcT::powerCT and R is normalized by EcT::normalizeCT
+	void mulSecret(Ec& R, const Zn& k) const
+	{
+		mpz_class t;
+		ec_local::toMpz(t, k);
+		Ec::powerCT(R, G_, Gmp::getBlock(t), Gmp::getBlockSize(t));
+		R.normalizeCT();
+	}
+	// sign with 1/k = b/(kb) for b != 0
+	bool signSub(Signature& sig, const Zn& sec, const Zn& h, const Zn& k, const Zn& b) const
+	{
+		if (k.isZero()) return false;
+		Ec R;
+		mulSecret(R, k);
+		getXmodN(sig.r, R);
+		if (sig.r.isZero()) return false;
+		Zn kb, t;
+		Zn::mul(kb, k, b);
+		ec_local::InvCT<Zn>::inv(t, kb);
+		t *= b;
+		sig.s = sig.r * sec;
+		sig.s += h;
+		sig.s *= t;
+		return !sig.s.isZero();
+	}
+public:
+	EcdsaT() : nBitLen_(0), wG_(0), hasPhi_(false), cache_(0) {}
+	/*
+		G : base point
+		nStr : order of G
+		wG : width of w-NAF of the table of G for verify(2 <= wG <= maxW)
+		init must be called after setting Ec::setGlv to use GLV for verify
+	*/
+	EcdsaT(const Ec& G, const std::string& nStr, int wG = 8)
+		: nBitLen_(0), wG_(0), hasPhi_(false), cache_(0)
+	{
+		init(G, nStr, wG);
+	}
+	void init(const Ec& G, const std::string& nStr, int wG = 8)
+	{
+		if (wG < 2 || wG > maxW) throw cybozu::Exception("EcdsaT:init:bad wG") << wG;
+		if (G.isZero()) throw cybozu::Exception("EcdsaT:init:G is zero");
+		Gmp::fromStr(n_, nStr);
+		nBitLen_ = Gmp::getBitLen(n_);
+		G_ = G;
+		wG_ = wG;
+		const typename Ec::Param& param = Ec::getParam();
+		hasPhi_ = param.isGlv;
+		const size_t tblN = size_t(1) << (wG - 2);
+		std::vector<Ec> T(tblN);
+		T[0] = G;
+		Ec G2;
+		Ec::dbl(G2, G);
+		for (size_t i = 1; i < tblN; i++) {
+			Ec::add(T[i], T[i - 1], G2);
+			if (T[i].isZero()) throw cybozu::Exception("EcdsaT:init:small order") << i;
+		}
+		const size_t n = hasPhi_ ? tblN * 2 : tblN;
+		tx_.resize(n);
+		ty_.resize(n);
+		Ec::getAffineVec(&tx_[0], &ty_[0], &T[0], tblN);
+		if (hasPhi_) {
+			for (size_t i = 0; i < tblN; i++) {
+				Fp::mul(tx_[tblN + i], tx_[i], param.beta);
+				ty_[tblN + i] = ty_[i];
+			}
+		}
+	}
+	/*
+		h = leftmost bitLen(n) bits of md[0..mdSize) as an integer mod n
+	*/
+	void hashToZn(Zn& h, const void *md, size_t mdSize) const
+	{
+		mpz_class x;
+		mpz_import(x.get_mpz_t(), mdSize, 1, 1, 1, 0, md);
+		if (mdSize * 8 > nBitLen_) x >>= mdSize * 8 - nBitLen_;
+		ec_local::fromMpz(h, x, n_);
+	}
+	void getPublicKey(Ec& Q, const Zn& sec) const
+	{
+		mulSecret(Q, sec);
+	}
+	/*
+		sign h by sec with the nonce k(0 < k < n)
+		return false if r or s is zero(try another k)
+		k must be secret and used only once
+		1/k is not blinded and runs in variable time unless Zn has invCT
+		(use sign to blind it)
+	*/
+	bool signWithNonce(Signature& sig, const Zn& sec, const Zn& h, const Zn& k) const
+	{
+		return signSub(sig, sec, h, k, 1);
+	}
+	/*
+		sign h by sec with a nonce k and a blinding factor b made by rg
+	*/
+	template<class RG>
+	void sign(Signature& sig, const Zn& sec, const Zn& h, RG& rg) const
+	{
+		Zn k, b;
+		do {
+			k.setRand(rg);
+			do {
+				b.setRand(rg);
+			} while (b.isZero());
+		} while (!signSub(sig, sec, h, k, b));
+	}
+	/*
+		verify sig of h by the public key Q
+	*/
+	bool verify(const Signature& sig, const Ec& Q, const Zn& h) const
+	{
+		if (sig.r.isZero() || sig.s.isZero() || Q.isZero()) return false;
+		Zn w, u1, u2;
+		Zn::inv(w, sig.s);
+		Zn::mul(u1, h, w);
+		Zn::mul(u2, sig.r, w);
+		Ec R;
+		mulAdd(R, u1, Q, u2);
+		if (R.isZero()) return false;
+		Zn r;
+		getXmodN(r, R);
+		return r == sig.r;
+	}
+	/*
+		R = aG + bQ
+	*/
+	void mulAdd(Ec& R, const Zn& a, const Ec& Q, const Zn& b) const
+	{
+		mpz_class ma, mb;
+		ec_local::toMpz(ma, a);
+		ec_local::toMpz(mb, b);
+		mulAddMpz(R, ma, Q, mb);
+	}
+	/*
+		use the tables of public keys in cache for verify and mulAdd(0 stops it)
+		cache must live while this object uses it
+	*/
+	void setCache(PowerCacheT<Fp> *cache) { cache_ = cache; }
+	PowerCacheT<Fp> *getCache() const { return cache_; }
+	const Ec& getBase() const { return G_; }
+	int getWindowSize() const { return wG_; }
+};
+
+} // mie
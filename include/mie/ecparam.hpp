@@ -61,6 +61,36 @@ const struct mie::EcParam secp256k1 = {
 	"0xfffffffffffffffffffffffffffffffebaaedce6af48a03bbfd25e8cd0364141",
 	256
 };
+const struct mie::EcParam secp192r1 = {
+	"secp192r1",
+	"0xfffffffffffffffffffffffffffffffeffffffffffffffff",
+	"-3",
+	"0x64210519e59c80e70fa7e9ab72243049feb8deecc146b9b1",
+	"0x188da80eb03090f67cbf20eb43a18800f4ff0afd82ff1012",
+	"0x07192b95ffc8da78631011ed6b24cdd573f977a11e794811",
+	"0xffffffffffffffffffffffff99def836146bc9b1b4d22831",
+	192
+};
+const struct mie::EcParam secp224r1 = {
+	"secp224r1",
+	"0xffffffffffffffffffffffffffffffff000000000000000000000001",
+	"-3",
+	"0xb4050a850c04b3abf54132565044b0b7d7bfd8ba270b39432355ffb4",
+	"0xb70e0cbd6bb4bf7f321390b94a03c1d356c21122343280d6115c1d21",
+	"0xbd376388b5f723fb4c22dfe6cd4375a05a07476444d5819985007e34",
+	"0xffffffffffffffffffffffffffff16a2e0b8f03e13dd29455c5c2a3d",
+	224
+};
+const struct mie::EcParam secp256r1 = {
+	"secp256r1",
+	"0xffffffff00000001000000000000000000000000ffffffffffffffffffffffff",
+	"-3",
+	"0x5ac635d8aa3a93e7b3ebbd55769886bc651d06b0cc53b0f63bce3c3e27d2604b",
+	"0x6b17d1f2e12c4247f8bce6e563a440f277037d812deb33a0f4a13945d898c296",
+	"0x4fe342e2fe1a7f9b8ee7eb4a7c0f9e162bce33576b315ececbb6406837bf51f5",
+	"0xffffffff00000000ffffffffffffffffbce6faada7179e84f3b9cac2fc632551",
+	256
+};
 const struct mie::EcParam secp384r1 = {
 	"secp384r1",
 	"0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffeffffffff0000000000000000ffffffff",
@@ -81,6 +111,7 @@ const struct mie::EcParam secp521r1 = {
 	"0x1fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffa51868783bf2f966b7fcc0148f709a5d03bb5c9b8899c47aebb6fb71e91386409",
 	521
 };
+// same secp192r1
 const struct mie::EcParam NIST_P192 = {
 	"NIST_P192",
 	"0xfffffffffffffffffffffffffffffffeffffffffffffffff",
@@ -91,6 +122,7 @@ const struct mie::EcParam NIST_P192 = {
 	"0xffffffffffffffffffffffff99def836146bc9b1b4d22831",
 	192
 };
+// same secp224r1
 const struct mie::EcParam NIST_P224 = {
 	"NIST_P224",
 	"0xffffffffffffffffffffffffffffffff000000000000000000000001",
@@ -101,6 +133,7 @@ const struct mie::EcParam NIST_P224 = {
 	"0xffffffffffffffffffffffffffff16a2e0b8f03e13dd29455c5c2a3d",
 	224
 };
+// same secp256r1
 const struct mie::EcParam NIST_P256 = {
 	"NIST_P256",
 	"0xffffffff00000001000000000000000000000000ffffffffffffffffffffffff",
@@ -134,6 +167,28 @@ const struct mie::EcParam NIST_P521 = {
 	521
 };
 
+// beta and lambda for GLV(see EcT::setGlv)
+const struct mie::EcGlvParam secp160k1_glv = {
+	"secp160k1",
+	"0x645b7345a143464942cc46d7cf4d5d1e1e6cbb68",
+	"0xf3c6393c4c5c9288fe47f1dff787a6ec6d16b2be",
+};
+const struct mie::EcGlvParam secp192k1_glv = {
+	"secp192k1",
+	"0x447a96e6c647963e2f7809feaab46947f34b0aa3ca0bba74",
+	"0xc27b0d93eddc7284b0c2ae9813318686dbb7a0ea73692cdb",
+};
+const struct mie::EcGlvParam secp224k1_glv = {
+	"secp224k1",
+	"0xfe0e87005b4e83761908c5131d552a850b3f58b749c37cf5b84d6768",
+	"0x60dcd2104c4cbc0be6eeefc2bdd610739ec34e317f9b33046c9e4788",
+};
+const struct mie::EcGlvParam secp256k1_glv = {
+	"secp256k1",
+	"0x7ae96a2b657c07106e64479eac3434e99cf0497512f58995c1396c28719501ee",
+	"0x5363ad4cc05c30e0a5261c028812645a122e22ea20816678df02967c1b23bd72",
+};
+
 } // mie::ecparam
 
 static inline const mie::EcParam* getEcParam(const std::string& name)
@@ -143,6 +198,9 @@ static inline const mie::EcParam* getEcParam(const std::string& name)
 		&ecparam::secp192k1,
 		&ecparam::secp224k1,
 		&ecparam::secp256k1,
+		&ecparam::secp192r1,
+		&ecparam::secp224r1,
+		&ecparam::secp256r1,
 		&ecparam::secp384r1,
 		&ecparam::secp521r1,
 
@@ -158,4 +216,21 @@ static inline const mie::EcParam* getEcParam(const std::string& name)
 	throw cybozu::Exception("mie::getEcParam:not support name") << name;
 }
 
+/*
+	return 0 if the curve has no GLV parameter
+*/
+static inline const mie::EcGlvParam* getEcGlvParam(const std::string& name)
+{
+	static const mie::EcGlvParam *tbl[] = {
+		&ecparam::secp160k1_glv,
+		&ecparam::secp192k1_glv,
+		&ecparam::secp224k1_glv,
+		&ecparam::secp256k1_glv,
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		if (name == tbl[i]->name) return tbl[i];
+	}
+	return 0;
+}
+
 } // mie
@@ -0,0 +1,235 @@
+#pragma once
+/**
+	@file
+	@brief file of precomputed tables of FixedBaseT
+	@author MITSUNARI Shigeo(@herumi)
+	@license modified new BSD license
+	http://opensource.org/licenses/BSD-3-Clause
+*/
+#include <fstream>
+#include <string>
+#include <vector>
+#include <mie/ec.hpp>
+#include <mie/mapped_file.hpp>
+
+namespace mie {
+
+namespace fixed_base_file_local {
+
+// FNV-1a 64
+inline uint64_t fnv1a(const uint8_t *p, size_t n, uint64_t v = 14695981039346656037ULL)
+{
+	for (size_t i = 0; i < n; i++) {
+		v ^= p[i];
+		v *= 1099511628211ULL;
+	}
+	return v;
+}
+
+// little endian
+inline void set64(uint8_t *p, uint64_t x)
+{
+	for (size_t i = 0; i < 8; i++) {
+		p[i] = uint8_t(x >> (i * 8));
+	}
+}
+
+inline uint64_t get64(const uint8_t *p)
+{
+	uint64_t x = 0;
+	for (size_t i = 0; i < 8; i++) {
+		x |= uint64_t(p[i]) << (i * 8);
+	}
+	return x;
+}
+
+} // fixed_base_file_local
+
+/*
+	tables of FixedBaseT<_Fp> in a file which is mapped and used in place
+	so that processes share the precomputation for long-lived points without building it
+
+	layout of version 2(integers in little endian)
+	header(headerSize bytes)
+		 0 : magic "mieFBTBL"
+		 8 : version
+		16 : Fp::getByteSize()
+		24 : w
+		32 : bitLen
+		40 : number of tables
+		48 : FixedBaseT::getSerializedSize() of a table
+		56 : FNV-1a 64 of all bytes after the header
+	curve parameter : p, a and b of Fp::getByteSize() bytes in big endian
+		and 1 in the form of a table entry padded to 64 bytes
+	tables : FixedBaseT::serialize of each table whose first entry is the base point
+	every table entry is aligned to 64 bytes in the file and in memory
+	an entry of FpT of fp2.hpp is in the internal(Montgomery) form for the Fp of the process,
+	so a file is valid only for the same Fp::setModulo(see ec_local::FpEntry)
+*/
+template<class _Fp>
+class FixedBaseFileT {
+	typedef _Fp Fp;
+	typedef EcT<Fp> Ec;
+	typedef FixedBaseT<Fp> FixedBase;
+	MappedFile f_;
+	std::vector<FixedBase*> tbl_;
+	FixedBaseFileT(const FixedBaseFileT&);
+	void operator=(const FixedBaseFileT&);
+	static inline size_t getCurveSize()
+	{
+		return (Fp::getByteSize() * 3 + ec_local::FpEntry<Fp>::getByteSize() + 63) & ~size_t(63);
+	}
+	// p, a, b of the current curve and 1 in the form of an entry
+	static inline void getCurve(std::vector<uint8_t>& buf)
+	{
+		const size_t n = Fp::getByteSize();
+		buf.assign(getCurveSize(), 0);
+		std::string pStr;
+		Fp::getModulo(pStr);
+		mpz_class p;
+		Gmp::fromStr(p, pStr);
+		size_t count = (mpz_sizeinbase(p.get_mpz_t(), 2) + 7) / 8;
+		mpz_export(&buf[n - count], &count, 1, 1, 1, 0, p.get_mpz_t());
+		const typename Ec::Param& param = Ec::getParam();
+		param.a.serialize(&buf[n], n);
+		param.b.serialize(&buf[n * 2], n);
+		ec_local::FpEntry<Fp>::write(&buf[n * 3], Fp(1));
+	}
+	void clear()
+	{
+		for (size_t i = 0; i < tbl_.size(); i++) {
+			delete tbl_[i];
+		}
+		tbl_.clear();
+		f_.close();
+	}
+public:
+	static const uint64_t version = 2;
+	static const size_t headerSize = 64;
+	FixedBaseFileT() {}
+	explicit FixedBaseFileT(const std::string& path, bool verifyChecksum = true)
+	{
+		load(path, verifyChecksum);
+	}
+	~FixedBaseFileT() { clear(); }
+	/*
+		write *tbl[0], ..., *tbl[n - 1] for the current curve to path
+		all tables must have the same bitLen and w
+	*/
+	static inline void save(const std::string& path, const FixedBase *const *tbl, size_t n)
+	{
+		using namespace fixed_base_file_local;
+		if (n == 0) throw cybozu::Exception("FixedBaseFileT:save:no table") << path;
+		const size_t bitLen = tbl[0]->getBitLen();
+		const int w = tbl[0]->getWindowSize();
+		const size_t tblSize = tbl[0]->getSerializedSize();
+		for (size_t i = 0; i < n; i++) {
+			if (tbl[i]->getBitLen() != bitLen || tbl[i]->getWindowSize() != w || tbl[i]->getBase().isZero()) {
+				throw cybozu::Exception("FixedBaseFileT:save:bad table") << path << i;
+			}
+		}
+		std::ofstream ofs(path.c_str(), std::ios::binary);
+		if (!ofs) throw cybozu::Exception("FixedBaseFileT:save:can't open") << path;
+		uint8_t header[headerSize] = {};
+		ofs.write((const char*)header, headerSize);
+		std::vector<uint8_t> buf;
+		getCurve(buf);
+		uint64_t sum = fnv1a(&buf[0], buf.size());
+		ofs.write((const char*)&buf[0], buf.size());
+		buf.resize(tblSize);
+		for (size_t i = 0; i < n; i++) {
+			tbl[i]->serialize(&buf[0], tblSize);
+			sum = fnv1a(&buf[0], tblSize, sum);
+			ofs.write((const char*)&buf[0], tblSize);
+		}
+		memcpy(header, "mieFBTBL", 8);
+		set64(header + 8, version);
+		set64(header + 16, Fp::getByteSize());
+		set64(header + 24, w);
+		set64(header + 32, bitLen);
+		set64(header + 40, n);
+		set64(header + 48, tblSize);
+		set64(header + 56, sum);
+		ofs.seekp(0);
+		ofs.write((const char*)header, headerSize);
+		if (!ofs) throw cybozu::Exception("FixedBaseFileT:save:can't write") << path;
+	}
+	/*
+		map path and use its tables in place
+		throw if the header or the curve does not match the current one
+		verifyChecksum = true reads all pages at once to check the checksum
+		and that every entry is a point on the curve(FixedBaseT::verifyView)
+		verifyChecksum = false trusts the file; only the header, the curve and the base points are checked,
+		and a broken entry makes a wrong result of FixedBaseT::mul without an error
+	*/
+	void load(const std::string& path, bool verifyChecksum = true)
+	{
+		using namespace fixed_base_file_local;
+		clear();
+		f_.open(path);
+		const uint8_t *p = f_.get();
+		const size_t size = f_.size();
+		const size_t curveSize = getCurveSize();
+		if (size < headerSize + curveSize || memcmp(p, "mieFBTBL", 8) != 0) {
+			clear();
+			throw cybozu::Exception("FixedBaseFileT:load:not a table file") << path;
+		}
+		const uint64_t ver = get64(p + 8);
+		const uint64_t byteSize = get64(p + 16);
+		const uint64_t w = get64(p + 24);
+		const uint64_t bitLen = get64(p + 32);
+		const uint64_t n = get64(p + 40);
+		const uint64_t tblSize = get64(p + 48);
+		if (ver != version || byteSize != Fp::getByteSize()) {
+			clear();
+			throw cybozu::Exception("FixedBaseFileT:load:bad version or Fp") << path << ver << byteSize;
+		}
+		if (w < 1 || w > uint64_t(FixedBase::maxW) || bitLen == 0 || bitLen > 0x10000) {
+			clear();
+			throw cybozu::Exception("FixedBaseFileT:load:bad w or bitLen") << path << w << bitLen;
+		}
+		const uint64_t expectSize = (bitLen + w) / w * (uint64_t(1) << (w - 1)) * FixedBase::getSerializedStride();
+		if (tblSize != expectSize || n == 0 || n > (size - headerSize - curveSize) / tblSize
+			|| size != headerSize + curveSize + n * tblSize) {
+			clear();
+			throw cybozu::Exception("FixedBaseFileT:load:bad size") << path << size << n << tblSize;
+		}
+		std::vector<uint8_t> curve;
+		getCurve(curve);
+		if (memcmp(p + headerSize, &curve[0], curveSize) != 0) {
+			clear();
+			throw cybozu::Exception("FixedBaseFileT:load:another curve") << path;
+		}
+		if (verifyChecksum && fnv1a(p + headerSize, size - headerSize) != get64(p + 56)) {
+			clear();
+			throw cybozu::Exception("FixedBaseFileT:load:bad checksum") << path;
+		}
+		try {
+			tbl_.reserve(size_t(n));
+			const uint8_t *q = p + headerSize + curveSize;
+			for (size_t i = 0; i < n; i++) {
+				// the first entry is 1 2^0 P
+				typedef ec_local::FpEntry<Fp> Entry;
+				Fp x, y;
+				Entry::read(x, q);
+				Entry::read(y, q + Entry::getByteSize());
+				if (!Entry::isValid(x) || !Entry::isValid(y) || !Ec::isValid(x, y)) {
+					throw cybozu::Exception("FixedBaseFileT:load:bad point") << path << i;
+				}
+				tbl_.push_back(new FixedBase());
+				tbl_.back()->initView(Ec(x, y, false), size_t(bitLen), int(w), q);
+				if (verifyChecksum && !tbl_.back()->verifyView()) {
+					throw cybozu::Exception("FixedBaseFileT:load:bad entry") << path << i;
+				}
+				q += tblSize;
+			}
+		} catch (...) {
+			clear();
+			throw;
+		}
+	}
+	size_t size() const { return tbl_.size(); }
+	const FixedBase& get(size_t i) const { return *tbl_[i]; }
+};
+
+} // mie
@@ -165,6 +165,11 @@ public:
 	static inline void mul(FpT& z, const FpT& x, unsigned int y) { T::mulMod(z.v, x.v, y, m_); }
 
 	static inline void inv(FpT& z, const FpT& x) { T::invMod(z.v, x.v, m_); }
+	/*
+		y[i] = 1 / x[i] for i = 0, ..., n - 1 with one inv
+		y[i] = 0 if x[i] = 0 ; y may be equal to x
+	*/
+	static inline void invVec(FpT *y, const FpT *x, size_t n) { fp::invVec(y, x, n); }
 	static inline void div(FpT& z, const FpT& x, const FpT& y)
 	{
 		ImplType rev;
@@ -199,6 +204,10 @@ public:
 	{
 		return T::isZero(x.v);
 	}
+	static inline bool isOne(const FpT& x)
+	{
+		return T::isOne(x.v);
+	}
 	static inline size_t getBitLen(const FpT& x)
 	{
 		return T::getBitLen(x.v);
@@ -208,6 +217,7 @@ public:
 		z.v = x.v >> n;
 	}
 	bool isZero() const { return isZero(*this); }
+	bool isOne() const { return isOne(*this); }
 	size_t getBitLen() const { return getBitLen(*this); }
 
 	template<class T2, class tag2>
@@ -273,6 +283,35 @@ public:
 		if (v >= m_) throw cybozu::Exception("FpT:fromBitVec:large x") << v << m_;
 	}
 	static inline size_t getBitVecSize() { return modBitLen_; }
+	/*
+		size of big endian fixed width representation
+	*/
+	static inline size_t getByteSize() { return (modBitLen_ + 7) / 8; }
+	/*
+		write getByteSize() bytes to buf in big endian
+		return getByteSize()
+	*/
+	size_t serialize(void *buf, size_t bufSize) const
+	{
+		const size_t n = getByteSize();
+		if (bufSize < n) throw cybozu::Exception("FpT:serialize:small buf") << bufSize << n;
+		fp::toBigEndian((uint8_t*)buf, n, getBlock(*this), getBlockSize(*this));
+		return n;
+	}
+	/*
+		read getByteSize() bytes written by serialize
+		return getByteSize()
+	*/
+	size_t deserialize(const void *buf, size_t bufSize)
+	{
+		const size_t n = getByteSize();
+		if (bufSize < n) throw cybozu::Exception("FpT:deserialize:small buf") << bufSize << n;
+		std::vector<BlockType> b(fp::getRoundNum<BlockType>(modBitLen_));
+		fp::fromBigEndian(&b[0], b.size(), (const uint8_t*)buf, n);
+		T::setRaw(v, &b[0], b.size());
+		if (v >= m_) throw cybozu::Exception("FpT:deserialize:large x") << v << m_;
+		return n;
+	}
 	static mie::ope::Optimized<ImplType> opt_;
 private:
 	static ImplType m_;
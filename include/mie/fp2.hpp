@@ -26,45 +26,75 @@
 
 namespace mie {
 
-struct Block {
+/*
+	value of FpT as an integer(see FpT::getBlock)
+	FpT<tag, maxBitN>::Block has maxN Units of maxBitN bits
+*/
+template<size_t maxN>
+struct BlockT {
 	typedef fp::Unit Unit;
 	const Unit *p; // pointer to original FpT.v_
 	size_t n;
-	Unit v_[fp::maxUnitN];
+	Unit v_[maxN];
 };
 
+typedef BlockT<fp::maxUnitN> Block;
+
+template<class tag = fp::TagDefault, size_t maxBitN = MIE_FP_BLOCK_MAX_BIT_N>
+class FpDblT;
+
 template<class tag = fp::TagDefault, size_t maxBitN = MIE_FP_BLOCK_MAX_BIT_N>
 class FpT {
 	typedef fp::Unit Unit;
+	/*
+		op_, sq_ : default context set by setModulo
+		curOp_, curSq_ : context of the current thread(see FieldCtxT)
+	*/
 	static fp::Op op_;
 	static mie::SquareRoot sq_;
+	static MIE_THREAD_LOCAL const fp::Op *curOp_;
+	static MIE_THREAD_LOCAL const mie::SquareRoot *curSq_;
 	template<class tag2, size_t maxBitN2> friend class FpT;
-	Unit v_[fp::maxUnitN];
+	template<class tag2, size_t maxBitN2> friend class FpDblT;
+	template<class tag2, size_t maxBitN2> friend class FieldCtxT;
+	static const size_t maxN = fp::ElementNumT<Unit, maxBitN>::value;
+	Unit v_[maxN];
 public:
+	typedef BlockT<maxN> Block;
 	// return pointer to array v_[]
 	const Unit *getUnit() const { return v_; }
-	size_t getUnitN() const { return op_.N; }
+	size_t getUnitN() const { return getOp().N; }
+	/*
+		set v_[] = x[0..n) and zero for n <= getUnitN() without conversion
+		x must be the internal form(getUnit()) for the same p
+	*/
+	void setUnit(const Unit *x, size_t n)
+	{
+		const size_t N = getOp().N;
+		if (n > N) throw cybozu::Exception("fp:FpT:setUnit:bad n") << n << N;
+		for (size_t i = 0; i < n; i++) v_[i] = x[i];
+		for (size_t i = n; i < N; i++) v_[i] = 0;
+	}
 	typedef Unit BlockType;
 	void dump() const
 	{
-		const size_t N = op_.N;
+		const size_t N = getOp().N;
 		for (size_t i = 0; i < N; i++) {
 			printf("%016llx ", (long long)v_[N - 1 - i]);
 		}
 		printf("\n");
 	}
-	static inline void setModulo(const std::string& mstr, bool useMont = true, int base = 0)
+	/*
+		useSafegcd : constant time inversion by safegcd if true(see FpBase::init)
+	*/
+	static inline void setModulo(const std::string& mstr, bool useMont = true, int base = 0, bool useSafegcd = false)
 	{
-		bool isMinus;
-		mpz_class mp;
-		inFromStr(mp, &isMinus, mstr, base);
-		if (isMinus) throw cybozu::Exception("mie:FpT:setModulo:mstr is not minus") << mstr;
-		op_.setModulo<tag, maxBitN>(mp, useMont);
-		sq_.set(mp);
+		initContext(op_, sq_, mstr, useMont, base, useSafegcd);
+		op_.setDefault(&op_);
 	}
 	static inline void getModulo(std::string& pstr)
 	{
-		Gmp::toStr(pstr, op_.mp);
+		Gmp::toStr(pstr, getOp().mp);
 	}
 	static inline bool isYodd(const FpT& x)
 	{
@@ -74,26 +104,43 @@ public:
 	}
 	static inline bool squareRoot(FpT& y, const FpT& x)
 	{
-		mpz_class mx, my;
-		x.toGmp(mx);
-		bool b = sq_.get(my, mx);
-		if (!b) return false;
-		y.fromGmp(my);
-		return true;
+		return curSq_->get(y, x);
+	}
+	/*
+		context of the current thread
+		setThreadCtx(getThreadCtx()) makes another thread use the same context
+		(see EcT::powerVec)
+	*/
+	struct ThreadCtx {
+		const fp::Op *op;
+		const mie::SquareRoot *sq;
+	};
+	static inline ThreadCtx getThreadCtx()
+	{
+		ThreadCtx ctx;
+		ctx.op = curOp_;
+		ctx.sq = curSq_;
+		return ctx;
+	}
+	static inline void setThreadCtx(const ThreadCtx& ctx)
+	{
+		if (ctx.op->bindThread) ctx.op->bindThread(ctx.op == &op_ ? 0 : ctx.op);
+		curOp_ = ctx.op;
+		curSq_ = ctx.sq;
 	}
 	FpT() {}
 	FpT(const FpT& x)
 	{
-		op_.copy(v_, x.v_);
+		getOp().copy(v_, x.v_);
 	}
 	FpT& operator=(const FpT& x)
 	{
-		op_.copy(v_, x.v_);
+		getOp().copy(v_, x.v_);
 		return *this;
 	}
 	void clear()
 	{
-		op_.clear(v_);
+		getOp().clear(v_);
 	}
 	FpT(int64_t x) { operator=(x); }
 	explicit FpT(const std::string& str, int base = 0)
@@ -118,19 +165,21 @@ public:
 	}
 	void toMont(FpT& y, const FpT& x) const
 	{
-		if (op_.useMont) op_.toMont(y.v_, x.v_);
+		const fp::Op& op = getOp();
+		if (op.useMont) op.toMont(y.v_, x.v_);
 	}
 	void fromMont(FpT& y, const FpT& x) const
 	{
-		if (op_.useMont) op_.fromMont(y.v_, x.v_);
+		const fp::Op& op = getOp();
+		if (op.useMont) op.fromMont(y.v_, x.v_);
 	}
 	void fromStr(const std::string& str, int base = 0)
 	{
 		bool isMinus;
 		mpz_class x;
 		inFromStr(x, &isMinus, str, base);
-		if (x >= op_.mp) throw cybozu::Exception("fp:FpT:fromStr:large str") << str;
-		fp::local::toArray(v_, op_.N, x.get_mpz_t());
+		if (x >= getOp().mp) throw cybozu::Exception("fp:FpT:fromStr:large str") << str;
+		fp::local::toArray(v_, getOp().N, x.get_mpz_t());
 		if (isMinus) {
 			neg(*this, *this);
 		}
@@ -142,7 +191,7 @@ public:
 	void setRaw(const S *inBuf, size_t n)
 	{
 		const size_t byteN = sizeof(S) * n;
-		const size_t fpByteN = sizeof(Unit) * op_.N;
+		const size_t fpByteN = sizeof(Unit) * getOp().N;
 		if (byteN > fpByteN) throw cybozu::Exception("setRaw:bad n") << n << fpByteN;
 		assert(byteN <= fpByteN);
 		memcpy(v_, inBuf, byteN);
@@ -154,7 +203,7 @@ public:
 	size_t getRaw(S *outBuf, size_t n) const
 	{
 		const size_t byteN = sizeof(S) * n;
-		const size_t fpByteN = sizeof(Unit) * op_.N;
+		const size_t fpByteN = sizeof(Unit) * getOp().N;
 		if (byteN < fpByteN) throw cybozu::Exception("getRaw:bad n") << n << fpByteN;
 		assert(byteN >= fpByteN);
 		Block b;
@@ -166,10 +215,11 @@ public:
 	}
 	void getBlock(Block& b) const
 	{
-		assert(maxUnitN <= Block::maxUnitN);
-		b.n = op_.N;
-		if (op_.useMont) {
-			op_.fromMont(b.v_, v_);
+		const fp::Op& op = getOp();
+		assert(op.N <= maxN);
+		b.n = op.N;
+		if (op.useMont) {
+			op.fromMont(b.v_, v_);
 			b.p = &b.v_[0];
 		} else {
 			b.p = &v_[0];
@@ -178,7 +228,8 @@ public:
 	template<class RG>
 	void setRand(RG& rg)
 	{
-		fp::getRandVal(v_, rg, op_.p, op_.bitLen);
+		const fp::Op& op = getOp();
+		fp::getRandVal(v_, rg, op.p, op.bitLen);
 		fromMont(*this, *this);
 	}
 	static inline void toStr(std::string& str, const Unit *x, size_t n, int base = 10, bool withPrefix = false)
@@ -223,12 +274,46 @@ public:
 	{
 		setRaw(Gmp::getBlock(x), Gmp::getBlockSize(x));
 	}
-	static inline void add(FpT& z, const FpT& x, const FpT& y) { op_.add(z.v_, x.v_, y.v_); }
-	static inline void sub(FpT& z, const FpT& x, const FpT& y) { op_.sub(z.v_, x.v_, y.v_); }
-	static inline void mul(FpT& z, const FpT& x, const FpT& y) { op_.mul(z.v_, x.v_, y.v_); }
-	static inline void inv(FpT& y, const FpT& x) { op_.inv(y.v_, x.v_); }
-	static inline void neg(FpT& y, const FpT& x) { op_.neg(y.v_, x.v_); }
-	static inline void square(FpT& y, const FpT& x) { op_.square(y.v_, x.v_); }
+	static inline void add(FpT& z, const FpT& x, const FpT& y) { getOp().add(z.v_, x.v_, y.v_); }
+	static inline void sub(FpT& z, const FpT& x, const FpT& y) { getOp().sub(z.v_, x.v_, y.v_); }
+	static inline void mul(FpT& z, const FpT& x, const FpT& y) { getOp().mul(z.v_, x.v_, y.v_); }
+	static inline void inv(FpT& y, const FpT& x) { getOp().inv(y.v_, x.v_); }
+	// y = 1 / x in constant time for odd p(see fp::Op::invCT)
+	static inline void invCT(FpT& y, const FpT& x) { getOp().invCT(y.v_, x.v_); }
+	static inline void neg(FpT& y, const FpT& x) { getOp().neg(y.v_, x.v_); }
+	static inline void square(FpT& y, const FpT& x) { getOp().square(y.v_, x.v_); }
+	/*
+		number of unused top bits of p in Unit[N]
+		FpDblT::addPre can sum up to 2^getSpareBitN() products before mod
+	*/
+	static inline size_t getSpareBitN()
+	{
+		const fp::Op& op = getOp();
+		return op.N * sizeof(Unit) * 8 - op.bitLen;
+	}
+	static inline const fp::Op& getOp() { return *curOp_; }
+	/*
+		8-way multiplication
+		an Ifma8 value is uint64_t[getIfma8Size()] which packs 8 elements
+		mul8(z, x, y) ; z[k] = x[k] * y[k] for k = 0, ..., 7
+		use AVX-512 IFMA if available
+	*/
+	static inline size_t getIfma8Size() { return getOp().N52 * 8; }
+	static inline void toIfma8(uint64_t *y, const FpT x[8]) { getOp().toIfma8(y, x[0].v_, maxN); }
+	static inline void fromIfma8(FpT y[8], const uint64_t *x) { getOp().fromIfma8(y[0].v_, maxN, x); }
+	static inline void mul8(uint64_t *z, const uint64_t *x, const uint64_t *y)
+	{
+		getOp().mul8((Unit*)z, (const Unit*)x, (const Unit*)y);
+	}
+	/*
+		y[i] = 1 / x[i] for i = 0, ..., n - 1 with one inv
+		y[i] = 0 if x[i] = 0 ; y may be equal to x
+	*/
+	static inline void invVec(FpT *y, const FpT *x, size_t n)
+	{
+		if (n == 0) return;
+		getOp().invVec(y[0].v_, x[0].v_, n, maxN);
+	}
 	static inline void div(FpT& z, const FpT& x, const FpT& y)
 	{
 		FpT rev;
@@ -259,7 +344,7 @@ public:
 	template<class tag2, size_t maxBitN2>
 	static inline void power(FpT& z, const FpT& x, const FpT<tag2, maxBitN2>& y)
 	{
-		Block b;
+		typename FpT<tag2, maxBitN2>::Block b;
 		y.getBlock(b);
 		powerArray(z, x, b.p, b.n);
 	}
@@ -272,9 +357,14 @@ public:
 	static inline void power(FpT& z, const FpT& x, const mpz_class& y)
 	{
 		if (y < 0) throw cybozu::Exception("FpT:power with negative y is not support") << y;
-		powerArray(z, x, Gmp::getBlock(y), Gmp::getBlockSize(x));
+		powerArray(z, x, Gmp::getBlock(y), Gmp::getBlockSize(y));
+	}
+	bool isZero() const { return getOp().isZero(v_); }
+	bool isOne() const
+	{
+		const fp::Op& op = getOp();
+		return fp::local::isEqualArray(v_, op.R, op.N);
 	}
-	bool isZero() const { return op_.isZero(v_); }
 	/*
 		append to bv(not clear bv)
 	*/
@@ -282,20 +372,52 @@ public:
 	{
 		Block b;
 		getBlock(b);
-		bv.append(b.p, op_.bitLen);
+		bv.append(b.p, getOp().bitLen);
 	}
 	bool isValid() const
 	{
-		return fp::local::compareArray(v_, op_.p, op_.N) < 0;
+		const fp::Op& op = getOp();
+		return fp::local::compareArray(v_, op.p, op.N) < 0;
 	}
 	void fromBitVec(const cybozu::BitVector& bv)
 	{
-		if (bv.size() != op_.bitLen) throw cybozu::Exception("FpT:fromBitVec:bad size") << bv.size() << op_.bitLen;
+		const size_t bitLen = getOp().bitLen;
+		if (bv.size() != bitLen) throw cybozu::Exception("FpT:fromBitVec:bad size") << bv.size() << bitLen;
 		setRaw(bv.getBlock(), bv.getBlockSize());
 	}
-	static inline size_t getModBitLen() { return op_.bitLen; }
-	static inline size_t getBitVecSize() { return op_.bitLen; }
-	bool operator==(const FpT& rhs) const { return fp::local::isEqualArray(v_, rhs.v_, op_.N); }
+	static inline size_t getModBitLen() { return getOp().bitLen; }
+	static inline size_t getBitVecSize() { return getOp().bitLen; }
+	/*
+		size of big endian fixed width representation
+	*/
+	static inline size_t getByteSize() { return (getOp().bitLen + 7) / 8; }
+	/*
+		write getByteSize() bytes to buf in big endian
+		return getByteSize()
+	*/
+	size_t serialize(void *buf, size_t bufSize) const
+	{
+		const size_t n = getByteSize();
+		if (bufSize < n) throw cybozu::Exception("FpT:serialize:small buf") << bufSize << n;
+		Block b;
+		getBlock(b);
+		fp::toBigEndian((uint8_t*)buf, n, b.p, b.n);
+		return n;
+	}
+	/*
+		read getByteSize() bytes written by serialize
+		return getByteSize()
+	*/
+	size_t deserialize(const void *buf, size_t bufSize)
+	{
+		const size_t n = getByteSize();
+		if (bufSize < n) throw cybozu::Exception("FpT:deserialize:small buf") << bufSize << n;
+		Unit t[maxN];
+		fp::fromBigEndian(t, getOp().N, (const uint8_t*)buf, n);
+		setRaw(t, getOp().N);
+		return n;
+	}
+	bool operator==(const FpT& rhs) const { return fp::local::isEqualArray(v_, rhs.v_, getOp().N); }
 	bool operator!=(const FpT& rhs) const { return !operator==(rhs); }
 	inline friend FpT operator+(const FpT& x, const FpT& y) { FpT z; add(z, x, y); return z; }
 	inline friend FpT operator-(const FpT& x, const FpT& y) { FpT z; sub(z, x, y); return z; }
@@ -342,6 +464,15 @@ public:
 		return fp::local::compareArray(xb.p, yb.p, xb.n);
 	}
 private:
+	static inline void initContext(fp::Op& op, mie::SquareRoot& sq, const std::string& mstr, bool useMont, int base, bool useSafegcd)
+	{
+		bool isMinus;
+		mpz_class mp;
+		inFromStr(mp, &isMinus, mstr, base);
+		if (isMinus) throw cybozu::Exception("mie:FpT:setModulo:mstr is not minus") << mstr;
+		op.setModulo<tag, maxBitN>(mp, useMont, useSafegcd);
+		sq.set(mp);
+	}
 	static inline void inFromStr(mpz_class& x, bool *isMinus, const std::string& str, int base)
 	{
 		const char *p = fp::verifyStr(isMinus, &base, str);
@@ -353,15 +484,121 @@ private:
 
 template<class tag, size_t maxBitN> fp::Op FpT<tag, maxBitN>::op_;
 template<class tag, size_t maxBitN> mie::SquareRoot FpT<tag, maxBitN>::sq_;
+template<class tag, size_t maxBitN> MIE_THREAD_LOCAL const fp::Op *FpT<tag, maxBitN>::curOp_ = &FpT<tag, maxBitN>::op_;
+template<class tag, size_t maxBitN> MIE_THREAD_LOCAL const mie::SquareRoot *FpT<tag, maxBitN>::curSq_ = &FpT<tag, maxBitN>::sq_;
+
+/*
+	field context for FpT<tag, maxBitN>
+	FpT uses the context set by FpT::setModulo on every thread by default
+	and uses ctx on the current thread in the lifetime of FieldCtxT::Scope(ctx)
+	so each thread may use a different p without locks
+	a value of FpT is valid only in the context where it was made
+	ex.
+	FieldCtx ctx(pStr); // in any thread
+	{
+		FieldCtx::Scope scope(ctx);
+		Fp x = 3; x *= x; // mod pStr
+	}
+*/
+template<class tag = fp::TagDefault, size_t maxBitN = MIE_FP_BLOCK_MAX_BIT_N>
+class FieldCtxT {
+	typedef FpT<tag, maxBitN> Fp;
+	fp::Op op_;
+	mie::SquareRoot sq_;
+	FieldCtxT(const FieldCtxT&);
+	void operator=(const FieldCtxT&);
+public:
+	FieldCtxT() {}
+	explicit FieldCtxT(const std::string& mstr, bool useMont = true, int base = 0, bool useSafegcd = false)
+	{
+		setModulo(mstr, useMont, base, useSafegcd);
+	}
+	/*
+		same as FpT::setModulo but does not change the context of any thread
+		must not be called while ctx is used
+	*/
+	void setModulo(const std::string& mstr, bool useMont = true, int base = 0, bool useSafegcd = false)
+	{
+		Fp::initContext(op_, sq_, mstr, useMont, base, useSafegcd);
+	}
+	const fp::Op& getOp() const { return op_; }
+	/*
+		bind ctx to the current thread and restore the previous context at exit
+		Scope may be nested
+	*/
+	class Scope {
+		const fp::Op& op_;
+		const fp::Op *prevOp_;
+		const mie::SquareRoot *prevSq_;
+		const fp::Op *prevBaseOp_;
+		Scope(const Scope&);
+		void operator=(const Scope&);
+	public:
+		explicit Scope(const FieldCtxT& ctx)
+			: op_(ctx.op_)
+			, prevOp_(Fp::curOp_)
+			, prevSq_(Fp::curSq_)
+			, prevBaseOp_(0)
+		{
+			if (op_.bindThread == 0) throw cybozu::Exception("mie:FieldCtxT:Scope:setModulo is not called");
+			prevBaseOp_ = op_.bindThread(&op_);
+			Fp::curOp_ = &ctx.op_;
+			Fp::curSq_ = &ctx.sq_;
+		}
+		~Scope()
+		{
+			op_.bindThread(prevBaseOp_);
+			Fp::curOp_ = prevOp_;
+			Fp::curSq_ = prevSq_;
+		}
+	};
+};
+
+/*
+	double width value of FpT for lazy reduction
+	mulPre and sqrPre keep the product without reduction
+	add and sub are done modulo pR (R = 2^(N * unitBit))
+	mod reduces it to FpT, which costs as much as mul
+	ex. x0 y0 + x1 y1 with one reduction
+	FpDbl::mulPre(s, x0, y0); FpDbl::mulPre(t, x1, y1);
+	FpDbl::add(s, s, t); FpDbl::mod(z, s);
+*/
+template<class tag, size_t maxBitN>
+class FpDblT {
+	typedef fp::Unit Unit;
+	typedef FpT<tag, maxBitN> Fp;
+	static const size_t maxN = fp::ElementNumT<Unit, maxBitN>::value;
+	Unit v_[maxN * 2];
+public:
+	const Unit *getUnit() const { return v_; }
+	size_t getUnitN() const { return Fp::getOp().N * 2; }
+	void clear()
+	{
+		for (size_t i = 0, n = getUnitN(); i < n; i++) v_[i] = 0;
+	}
+	bool operator==(const FpDblT& rhs) const { return fp::local::isEqualArray(v_, rhs.v_, getUnitN()); }
+	bool operator!=(const FpDblT& rhs) const { return !operator==(rhs); }
+	static inline void add(FpDblT& z, const FpDblT& x, const FpDblT& y) { Fp::getOp().dblAdd(z.v_, x.v_, y.v_); }
+	static inline void sub(FpDblT& z, const FpDblT& x, const FpDblT& y) { Fp::getOp().dblSub(z.v_, x.v_, y.v_); }
+	/*
+		z = x + y without reduction
+		the sum of at most 2^Fp::getSpareBitN() products is less than pR
+	*/
+	static inline void addPre(FpDblT& z, const FpDblT& x, const FpDblT& y) { Fp::getOp().dblAddPre(z.v_, x.v_, y.v_); }
+	static inline void mulPre(FpDblT& z, const Fp& x, const Fp& y) { Fp::getOp().mulPre(z.v_, x.v_, y.v_); }
+	static inline void sqrPre(FpDblT& z, const Fp& x) { Fp::getOp().sqrPre(z.v_, x.v_); }
+	// z = x mod p ; x must be less than pR
+	static inline void mod(Fp& z, const FpDblT& x) { Fp::getOp().mod(z.v_, x.v_); }
+};
 
 namespace power_impl {
 
 template<class G, class tag, size_t bitN, template<class _tag, size_t _bitN>class FpT>
 void power(G& z, const G& x, const FpT<tag, bitN>& y)
 {
-	Block b;
+	typename FpT<tag, bitN>::Block b;
 	y.getBlock(b);
-	mie::power_impl::powerArray(z, x, b.p, b.n);
+	mie::power_impl::TagPower<G>::powerArray(z, x, b.p, b.n);
 }
 
 } // mie::power_impl
@@ -371,7 +608,7 @@ namespace std { CYBOZU_NAMESPACE_TR1_BEGIN
 template<class T> struct hash;
 
 template<class tag, size_t maxBitN>
-struct hash<mie::FpT<tag, maxBitN> > : public std::unary_function<mie::FpT<tag, maxBitN>, size_t> {
+struct hash<mie::FpT<tag, maxBitN> > {
 	size_t operator()(const mie::FpT<tag, maxBitN>& x, uint64_t v = 0) const
 	{
 		return static_cast<size_t>(cybozu::hash64(x.getUnit(), x.getUnitN(), v));
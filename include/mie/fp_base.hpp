@@ -17,11 +17,14 @@
 #endif
 #include <stdint.h>
 #include <assert.h>
+#include <algorithm>
+#include <vector>
 #include <mie/gmp_util.hpp>
 #ifdef _MSC_VER
 	#pragma warning(pop)
 #endif
 #include <cybozu/inttype.hpp>
+#include <mie/operator.hpp>
 #include <mie/fp_generator.hpp>
 //#undef MIE_FP_GENERATOR_USE_XBYAK
 
@@ -29,6 +32,14 @@
 	#define MIE_FP_BLOCK_MAX_BIT_N 521
 #endif
 
+/*
+	max bit length of p for FpT<tag, maxBitN> with large maxBitN
+	such as n^2 of Paillier or RSA modulus
+*/
+#ifndef MIE_FP_LARGE_MAX_BIT_N
+	#define MIE_FP_LARGE_MAX_BIT_N 8192
+#endif
+
 namespace mie { namespace fp {
 
 #if defined(CYBOZU_OS_BIT) && (CYBOZU_OS_BIT == 32)
@@ -42,6 +53,16 @@ struct ElementNumT {
 	static const size_t value = (bitLen + sizeof(T) * 8 - 1) / (sizeof(T) * 8);
 };
 static const size_t maxUnitN = fp::ElementNumT<Unit, MIE_FP_BLOCK_MAX_BIT_N>::value;
+static const size_t maxLargeUnitN = fp::ElementNumT<Unit, MIE_FP_LARGE_MAX_BIT_N>::value;
+/*
+	number of signed 62-bit limbs for safegcd
+	values in (-2p, p) for p < 2^bitLen need bitLen + 2 bits
+*/
+template<size_t bitLen>
+struct Limb62NumT {
+	static const size_t value = (bitLen + 2) / 62 + 1;
+};
+static const size_t maxLimb62N = Limb62NumT<maxLargeUnitN * sizeof(Unit) * 8>::value;
 
 typedef void (*void1op)(Unit*);
 typedef void (*void2op)(Unit*, const Unit*);
@@ -50,6 +71,8 @@ typedef void (*void4op)(Unit*, const Unit*, const Unit*, const Unit*);
 typedef int (*int2op)(Unit*, const Unit*);
 typedef void (*void4Iop)(Unit*, const Unit*, const Unit*, const Unit*, Unit);
 typedef void (*void3Iop)(Unit*, const Unit*, const Unit*, Unit);
+typedef void (*invVecOp)(Unit*, const Unit*, size_t, size_t);
+typedef int64_t (*divstepsOp)(int64_t, uint64_t, uint64_t, int64_t*);
 
 } } // mie::fp
 
@@ -131,6 +154,40 @@ inline void copyArray(Unit *y, const Unit *x, size_t n)
 	for (size_t i = 0; i < n; i++) y[i] = x[i];
 }
 
+/*
+	z[0..n) = x[0..n) + y[0..n) and return carry
+*/
+inline Unit addArray(Unit *z, const Unit *x, const Unit *y, size_t n)
+{
+	Unit c = 0;
+	for (size_t i = 0; i < n; i++) {
+		const Unit xi = x[i];
+		Unit t = xi + c;
+		c = t < xi;
+		t += y[i];
+		c += t < y[i];
+		z[i] = t;
+	}
+	return c;
+}
+
+/*
+	z[0..n) = x[0..n) - y[0..n) and return borrow
+*/
+inline Unit subArray(Unit *z, const Unit *x, const Unit *y, size_t n)
+{
+	Unit c = 0;
+	for (size_t i = 0; i < n; i++) {
+		const Unit xi = x[i];
+		const Unit yi = y[i];
+		const Unit t = xi - yi;
+		const Unit b = (xi < yi) + (t < c);
+		z[i] = t - c;
+		c = b;
+	}
+	return c;
+}
+
 inline void toArray(Unit *y, size_t yn, const mpz_srcptr x)
 {
 	const int xn = x->_mp_size;
@@ -141,14 +198,292 @@ inline void toArray(Unit *y, size_t yn, const mpz_srcptr x)
 	clearArray(y, xn, yn);
 }
 
+/*
+	y[j * stride] = the j-th w-bit digit of x[0..n) for j = 0, ..., yn - 1
+*/
+inline void splitBits(uint64_t *y, size_t stride, const Unit *x, size_t n, size_t yn, size_t w)
+{
+	const size_t unitBit = sizeof(Unit) * 8;
+	for (size_t j = 0; j < yn; j++) {
+		uint64_t v = 0;
+		size_t k = 0;
+		while (k < w) {
+			const size_t pos = j * w + k;
+			const size_t q = pos / unitBit;
+			const size_t r = pos % unitBit;
+			if (q >= n) break;
+			const size_t b = (std::min)(unitBit - r, w - k);
+			v |= (uint64_t(x[q] >> r) & ((uint64_t(1) << b) - 1)) << k;
+			k += b;
+		}
+		y[j * stride] = v;
+	}
+}
+
+/*
+	y[0..n) = sum_j x[j * stride] 2^(w j) for j = 0, ..., xn - 1
+	x[j * stride] < 2^w
+*/
+inline void joinBits(Unit *y, size_t n, const uint64_t *x, size_t stride, size_t xn, size_t w)
+{
+	const size_t unitBit = sizeof(Unit) * 8;
+	clearArray(y, 0, n);
+	for (size_t j = 0; j < xn; j++) {
+		const uint64_t v = x[j * stride];
+		size_t k = 0;
+		while (k < w) {
+			const size_t pos = j * w + k;
+			const size_t q = pos / unitBit;
+			const size_t r = pos % unitBit;
+			if (q >= n) break;
+			const size_t b = (std::min)(unitBit - r, w - k);
+			y[q] |= Unit((v >> k) & ((uint64_t(1) << b) - 1)) << r;
+			k += b;
+		}
+	}
+}
+
+/*
+	y[j * stride] = the j-th 52-bit digit of x[0..n) for j = 0, ..., n52 - 1
+*/
+inline void splitR52(uint64_t *y, size_t stride, const Unit *x, size_t n, size_t n52)
+{
+	splitBits(y, stride, x, n, n52, 52);
+}
+
+/*
+	x[0..n) = sum_j x[j * stride] 2^(52 j) for j = 0, ..., n52 - 1
+	x[j * stride] < 2^52
+*/
+inline void joinR52(Unit *y, size_t n, const uint64_t *x, size_t stride, size_t n52)
+{
+	joinBits(y, n, x, stride, n52, 52);
+}
+
+/*
+	signed 128-bit accumulator for safegcd
+*/
+#if defined(__SIZEOF_INT128__) && !defined(MIE_FP_NO_INT128)
+struct Int128 {
+	__int128 v;
+	Int128() : v(0) {}
+	// this += x * y
+	void mulAdd(int64_t x, int64_t y) { v += (__int128)x * y; }
+	uint64_t low() const { return uint64_t(v); }
+	void shr62() { v >>= 62; }
+};
+#else
+struct Int128 {
+	uint64_t lo;
+	uint64_t hi; // two's complement
+	Int128() : lo(0), hi(0) {}
+	void mulAdd(int64_t x, int64_t y)
+	{
+		const bool isNeg = (x < 0) != (y < 0);
+		const uint64_t a = x < 0 ? 0 - uint64_t(x) : uint64_t(x);
+		const uint64_t b = y < 0 ? 0 - uint64_t(y) : uint64_t(y);
+		const uint64_t a0 = uint32_t(a), a1 = a >> 32;
+		const uint64_t b0 = uint32_t(b), b1 = b >> 32;
+		const uint64_t t00 = a0 * b0, t01 = a0 * b1, t10 = a1 * b0, t11 = a1 * b1;
+		const uint64_t mid = (t00 >> 32) + uint32_t(t01) + uint32_t(t10);
+		uint64_t L = uint32_t(t00) | (mid << 32);
+		uint64_t H = t11 + (t01 >> 32) + (t10 >> 32) + (mid >> 32);
+		if (isNeg) {
+			L = 0 - L;
+			H = ~H + (L == 0 ? 1 : 0);
+		}
+		lo += L;
+		hi += H + (lo < L ? 1 : 0);
+	}
+	uint64_t low() const { return lo; }
+	void shr62()
+	{
+		lo = (lo >> 62) | (hi << 2);
+		hi = uint64_t(int64_t(hi) >> 62);
+	}
+};
+#endif
+
+/*
+	portable version of FpGenerator::gen_divsteps62
+*/
+inline int64_t divsteps62(int64_t delta, uint64_t f, uint64_t g, int64_t *t)
+{
+	uint64_t u = 1, v = 0, q = 0, r = 1;
+	for (int i = 0; i < 62; i++) {
+		const uint64_t odd = 0 - (g & 1);
+		const uint64_t m = uint64_t((-delta) >> 63) & odd;
+		uint64_t x;
+		x = (f ^ g) & m; f ^= x; g ^= x; g = (g ^ m) - m;
+		x = (u ^ q) & m; u ^= x; q ^= x; q = (q ^ m) - m;
+		x = (v ^ r) & m; v ^= x; r ^= x; r = (r ^ m) - m;
+		delta = (delta ^ int64_t(m)) - int64_t(m);
+		g += f & odd;
+		q += u & odd;
+		r += v & odd;
+		delta++;
+		g >>= 1;
+		u <<= 1;
+		v <<= 1;
+	}
+	t[0] = int64_t(u);
+	t[1] = int64_t(v);
+	t[2] = int64_t(q);
+	t[3] = int64_t(r);
+	return delta;
+}
+
+/*
+	x[0..n) is an integer in radix 2^62 such that
+	0 <= x[i] < 2^62 for i < n - 1 and x[n - 1] is signed
+*/
+static const uint64_t mask62 = (uint64_t(1) << 62) - 1;
+
+/*
+	(f, g) = (u f + v g, q f + r g) / 2^62 for t = { u, v, q, r }
+*/
+inline void updateFG62(int64_t *f, int64_t *g, const int64_t *t, size_t n)
+{
+	const int64_t u = t[0], v = t[1], q = t[2], r = t[3];
+	Int128 cf, cg;
+	cf.mulAdd(u, f[0]);
+	cf.mulAdd(v, g[0]);
+	cg.mulAdd(q, f[0]);
+	cg.mulAdd(r, g[0]);
+	assert((cf.low() & mask62) == 0 && (cg.low() & mask62) == 0);
+	cf.shr62();
+	cg.shr62();
+	for (size_t i = 1; i < n; i++) {
+		cf.mulAdd(u, f[i]);
+		cf.mulAdd(v, g[i]);
+		cg.mulAdd(q, f[i]);
+		cg.mulAdd(r, g[i]);
+		f[i - 1] = int64_t(cf.low() & mask62);
+		g[i - 1] = int64_t(cg.low() & mask62);
+		cf.shr62();
+		cg.shr62();
+	}
+	f[n - 1] = int64_t(cf.low());
+	g[n - 1] = int64_t(cg.low());
+}
+
+/*
+	(d, e) = (u d + v e, q d + r e) / 2^62 mod p for t = { u, v, q, r }
+	pInv = p^(-1) mod 2^62
+	input and output are in (-2p, p)
+*/
+inline void updateDE62(int64_t *d, int64_t *e, const int64_t *t, const int64_t *p, uint64_t pInv, size_t n)
+{
+	const int64_t u = t[0], v = t[1], q = t[2], r = t[3];
+	const int64_t sd = d[n - 1] >> 63;
+	const int64_t se = e[n - 1] >> 63;
+	// add p * (u, q) if d < 0 and p * (v, r) if e < 0 to keep the range
+	int64_t md = (u & sd) + (v & se);
+	int64_t me = (q & sd) + (r & se);
+	Int128 cd, ce;
+	cd.mulAdd(u, d[0]);
+	cd.mulAdd(v, e[0]);
+	ce.mulAdd(q, d[0]);
+	ce.mulAdd(r, e[0]);
+	// choose md, me such that cd + p md = ce + p me = 0 mod 2^62
+	md -= int64_t((pInv * cd.low() + uint64_t(md)) & mask62);
+	me -= int64_t((pInv * ce.low() + uint64_t(me)) & mask62);
+	cd.mulAdd(p[0], md);
+	ce.mulAdd(p[0], me);
+	assert((cd.low() & mask62) == 0 && (ce.low() & mask62) == 0);
+	cd.shr62();
+	ce.shr62();
+	for (size_t i = 1; i < n; i++) {
+		cd.mulAdd(u, d[i]);
+		cd.mulAdd(v, e[i]);
+		cd.mulAdd(p[i], md);
+		ce.mulAdd(q, d[i]);
+		ce.mulAdd(r, e[i]);
+		ce.mulAdd(p[i], me);
+		d[i - 1] = int64_t(cd.low() & mask62);
+		e[i - 1] = int64_t(ce.low() & mask62);
+		cd.shr62();
+		ce.shr62();
+	}
+	d[n - 1] = int64_t(cd.low());
+	e[n - 1] = int64_t(ce.low());
+}
+
+inline void carry62(int64_t *x, size_t n)
+{
+	for (size_t i = 0; i < n - 1; i++) {
+		x[i + 1] += x[i] >> 62;
+		x[i] &= int64_t(mask62);
+	}
+}
+
+/*
+	d = d mod p if s = 0, -d mod p if s = -1
+	input d is in (-2p, p), output d is in [0, p)
+*/
+inline void normalize62(int64_t *d, int64_t s, const int64_t *p, size_t n)
+{
+	int64_t c = d[n - 1] >> 63;
+	for (size_t i = 0; i < n; i++) {
+		d[i] = ((d[i] + (p[i] & c)) ^ s) - s;
+	}
+	carry62(d, n);
+	c = d[n - 1] >> 63;
+	for (size_t i = 0; i < n; i++) {
+		d[i] += p[i] & c;
+	}
+	carry62(d, n);
+}
+
+/*
+	detect p = 2^k - c for |c| < 2^62 (c may be negative)
+	or a Solinas prime such as NIST P-192/P-224/P-256/P-384
+*/
+inline PrimeForm getPrimeForm(const mpz_class& p)
+{
+	PrimeForm f;
+	const size_t bitLen = Gmp::getBitLen(p);
+	if (bitLen < 2 || (p & 1) == 0) return f;
+	const mpz_class maxC = mpz_class(1) << 62;
+	int k = (int)bitLen;
+	mpz_class c = (mpz_class(1) << k) - p;
+	if (c >= maxC) {
+		c = (mpz_class(1) << (k - 1)) - p;
+		if (-c < maxC) k--;
+	}
+	if (c != 0 && c < maxC && -c < maxC) {
+		const mpz_class absC = c < 0 ? mpz_class(-c) : c;
+		const uint64_t v = (uint64_t(mpz_class(absC >> 32).get_ui()) << 32) | mpz_class(absC & 0xffffffff).get_ui();
+		f.type = PrimePseudoMersenne;
+		f.k = k;
+		f.c = c < 0 ? -int64_t(v) : int64_t(v);
+		return f;
+	}
+	uint64_t a[maxSolinasPn];
+	int d[maxSolinasWordN];
+	const int pn = int((bitLen + 63) / 64);
+	if (pn <= maxSolinasPn && Gmp::getRaw(a, pn, p) && getSolinasDigit(d, a, pn, (int)bitLen)) {
+		f.type = PrimeSolinas;
+		f.k = (int)bitLen;
+	}
+	return f;
+}
+
 } // mie::fp::local
 
 struct TagDefault;
 
 struct Op {
 	bool useMont; // Montgomery
+	/*
+		special form of p detected by setModulo
+		mul and sqr of a pseudo-Mersenne prime use folding reduction
+		and those of a Solinas prime use NIST-style word reduction
+		and then useMont is false even if Montgomery form is requested
+	*/
+	PrimeForm primeForm;
 	mpz_class mp;
-	Unit p[fp::maxUnitN];
+	Unit p[fp::maxLargeUnitN];
 	size_t N;
 	size_t bitLen;
 	bool (*isZero)(const Unit*);
@@ -160,16 +495,93 @@ struct Op {
 	void3op add;
 	void3op sub;
 	void3op mul;
+	/*
+		invVec(y, x, n, stride) ; y[i] = 1 / x[i] for i = 0, ..., n - 1
+		x[i] is at x + i * stride
+	*/
+	invVecOp invVec;
+	/*
+		for FpDbl(double width value without reduction)
+		mulPre(z, x, y) : z[2N] = x[N] * y[N]
+		sqrPre(z, x) : z[2N] = x[N]^2
+		mod(z, xy) : z[N] = xy[2N] / R mod p(R = 1 if !useMont)
+		xy < pR is required if useMont
+		dblAdd(z, x, y) : z[2N] = x[2N] + y[2N] mod p 2^(N * unitBit)
+		dblSub(z, x, y) : z[2N] = x[2N] - y[2N] mod p 2^(N * unitBit)
+		dblAddPre(z, x, y) : z[2N] = x[2N] + y[2N] without reduction
+	*/
+	void3op mulPre;
+	void2op sqrPre;
+	void2op mod;
+	void3op dblAdd;
+	void3op dblSub;
+	void3op dblAddPre;
 	// for Montgomery
-	Unit one[fp::maxUnitN]; // one = 1
-	Unit RR[fp::maxUnitN]; // R = (1 << (N * 64)) % p; RR = (R * R) % p
+	Unit one[fp::maxLargeUnitN]; // one = 1
+	Unit RR[fp::maxLargeUnitN]; // R = (1 << (N * 64)) % p; RR = (R * R) % p
+	Unit R[fp::maxLargeUnitN]; // 1 in the internal form(R if useMont else 1)
 	std::vector<Unit> invTbl;
+	/*
+		for safegcd inversion(Bernstein-Yang)
+		inv(y, x) returns invE0 / x in invIterN calls of divsteps
+		p62, invE0 : p and invE0 in radix 2^62
+		invE0 = R^2 mod p for Montgomery form else 1
+		pInv62 : p^(-1) mod 2^62
+	*/
+	bool useSafegcd;
+	/*
+		invCT(y, x) : y = 1 / x in constant time by safegcd for odd p regardless of useSafegcd
+		invCT = inv for even p
+	*/
+	void2op invCT;
+	size_t invIterN;
+	divstepsOp divsteps;
+	uint64_t pInv62;
+	int64_t p62[fp::maxLimb62N];
+	int64_t invE0[fp::maxLimb62N];
+	/*
+		for 8-way multiplication
+		an element of Ifma8 form is uint64_t[N52 * 8] which has 8 values
+		in radix 2^52; the j-th digit of the k-th value is at [j * 8 + k]
+		mul8(z, x, y) : z[k] = x[k] * y[k] / R52 (R52 = 2^(52 * N52))
+	*/
+	void3op mul8;
+	size_t N52;
+	Unit toR52[fp::maxLargeUnitN]; // R52 mod p
+	Unit fromR52[fp::maxLargeUnitN]; // R^2 / R52 mod p (R = 1 if !useMont)
+	// preInv(r, x) : r = 2^k / x and return k for Montgomery inversion with invTbl
+	int2op preInv;
+	/*
+		the functions above refer to the Op of FpBase<tag, N> which set it
+		setDefault(op) : op is used by all threads
+		bindThread(op) : op is used by the current thread instead of the default
+		op = 0 means the default ; return the previous one
+	*/
+	void (*setDefault)(const Op*);
+	const Op *(*bindThread)(const Op*);
+#ifdef MIE_FP_GENERATOR_USE_XBYAK
+	// own generator for p of more than FpGenerator::maxUnrollPn limbs(not cached)
+	FpGenerator *largeFg;
+#endif
 
 	Op()
-		: useMont(false), mp(), p(), N(0), bitLen(0)
+		: useMont(false), primeForm(), mp(), p(), N(0), bitLen(0)
 		, isZero(0), clear(0), neg(0), inv(0)
 		, square(0), copy(0),add(0), sub(0), mul(0)
+		, invVec(0), mulPre(0), sqrPre(0), mod(0)
+		, dblAdd(0), dblSub(0), dblAddPre(0), useSafegcd(false), invCT(0), invIterN(0), divsteps(0), pInv62(0)
+		, p62(), invE0(), mul8(0), N52(0), toR52(), fromR52()
+		, preInv(0), setDefault(0), bindThread(0)
+#ifdef MIE_FP_GENERATOR_USE_XBYAK
+		, largeFg(0)
+#endif
 	{
+	}
+	~Op()
+	{
+#ifdef MIE_FP_GENERATOR_USE_XBYAK
+		delete largeFg;
+#endif
 	}
 	void toMont(Unit *y, const Unit *x) const
 	{
@@ -193,19 +605,57 @@ struct Op {
 			tbl -= N;
 		}
 	}
+	/*
+		y[N52 * 8] <- Ifma8 form of x[0], ..., x[7]
+		x[k] is at x + k * xStride
+	*/
+	void toIfma8(uint64_t *y, const Unit *x, size_t xStride) const
+	{
+		Unit t[fp::maxLargeUnitN];
+		for (size_t k = 0; k < 8; k++) {
+			mul(t, x + k * xStride, toR52);
+			local::splitR52(y + k, 8, t, N, N52);
+		}
+	}
+	/*
+		y[k] <- k-th value of x[N52 * 8]
+		y[k] is at y + k * yStride
+	*/
+	void fromIfma8(Unit *y, size_t yStride, const uint64_t *x) const
+	{
+		Unit t[fp::maxLargeUnitN];
+		for (size_t k = 0; k < 8; k++) {
+			local::joinR52(t, N, x + k, 8, N52);
+			mul(y + k * yStride, t, fromR52);
+		}
+	}
 	template<class tag, size_t maxBitN>
-	void setModulo(const mpz_class& mp, bool useMont);
+	void setModulo(const mpz_class& mp, bool useMont, bool useSafegcd = false);
+private:
+	Op(const Op&);
+	void operator=(const Op&);
 };
 
 template<class tag, size_t bitN>
 struct FpBase {
 	typedef fp::Unit Unit;
 	static const size_t N = fp::ElementNumT<Unit, bitN>::value;
+	static const size_t N62 = fp::Limb62NumT<N * sizeof(Unit) * 8>::value;
+	/*
+		op_ : default Op set by Op::setDefault
+		curOp_ : Op of the current thread set by Op::bindThread(0 means op_)
+		an Op of the same tag and size may be used by each thread at once
+	*/
 	static const Op *op_;
-	// for Montgomery
-#ifdef MIE_FP_GENERATOR_USE_XBYAK
-	static FpGenerator fg_;
-#endif
+	static MIE_THREAD_LOCAL const Op *curOp_;
+	static inline const Op& getOp() { return curOp_ ? *curOp_ : *op_; }
+	static inline void setDefault(const Op *op) { op_ = op; }
+	static inline const Op *bindThread(const Op *op)
+	{
+		const Op *prev = curOp_;
+		curOp_ = op;
+		return prev;
+	}
 
 	//////////////////////////////////////////////////////////////////
 	// for FixedFp
@@ -217,7 +667,8 @@ struct FpBase {
 			i--;
 		}
 		z->_mp_size = i;
-		z->_mp_d = (mp_limb_t*)p;
+		// mz is read only
+		z->_mp_d = const_cast<mp_limb_t*>(reinterpret_cast<const mp_limb_t*>(p));
 	}
 	static inline void set_zero(mpz_t& z, Unit *p, size_t n)
 	{
@@ -233,8 +684,9 @@ struct FpBase {
 		set_mpz_t(mx, x);
 		set_mpz_t(my, y);
 		mpz_add(mz, mx, my);
-		if (mpz_cmp(mz, op_->mp.get_mpz_t()) >= 0) {
-			mpz_sub(mz, mz, op_->mp.get_mpz_t());
+		const mpz_srcptr mp = getOp().mp.get_mpz_t();
+		if (mpz_cmp(mz, mp) >= 0) {
+			mpz_sub(mz, mz, mp);
 		}
 		local::toArray(z, N, mz);
 	}
@@ -247,7 +699,7 @@ struct FpBase {
 		set_mpz_t(my, y);
 		mpz_sub(mz, mx, my);
 		if (mpz_sgn(mz) < 0) {
-			mpz_add(mz, mz, op_->mp.get_mpz_t());
+			mpz_add(mz, mz, getOp().mp.get_mpz_t());
 		}
 		local::toArray(z, N, mz);
 	}
@@ -257,7 +709,7 @@ struct FpBase {
 			if (x != y) clear(y);
 			return;
 		}
-		sub(y, op_->p, x);
+		sub(y, getOp().p, x);
 	}
 	// z[N * 2] = x[N] * y[N]
 	static inline void mulPre(Unit *z, const Unit *x, const Unit *y)
@@ -275,7 +727,7 @@ struct FpBase {
 		mpz_t mx, my;
 		set_mpz_t(mx, x, N * 2);
 		set_mpz_t(my, y, N);
-		mpz_mod(my, mx, op_->mp.get_mpz_t());
+		mpz_mod(my, mx, getOp().mp.get_mpz_t());
 		local::clearArray(y, my->_mp_size, N);
 	}
 	// z[N] = x[N] * y[N] mod p[N]
@@ -291,14 +743,14 @@ struct FpBase {
 		set_mpz_t(mx, x);
 		set_mpz_t(my, y);
 		mpz_mul(mz, mx, my);
-		mpz_mod(mz, mz, op_->mp.get_mpz_t());
+		mpz_mod(mz, mz, getOp().mp.get_mpz_t());
 		local::toArray(z, N, mz);
 #endif
 	}
 #ifdef MIE_USE_LLVM
 #define MIE_FP_DEF_METHOD(len, suffix) \
-static inline void add ## len(Unit* z, const Unit* x, const Unit* y) { mie_fp_add ## len ## suffix(z, x, y, op_->p); } \
-static inline void sub ## len(Unit* z, const Unit* x, const Unit* y) { mie_fp_sub ## len ## suffix(z, x, y, op_->p); } \
+static inline void add ## len(Unit* z, const Unit* x, const Unit* y) { mie_fp_add ## len ## suffix(z, x, y, getOp().p); } \
+static inline void sub ## len(Unit* z, const Unit* x, const Unit* y) { mie_fp_sub ## len ## suffix(z, x, y, getOp().p); } \
 static inline void mul ## len(Unit* z, const Unit* x, const Unit* y) { Unit ret[N * 2]; mie_fp_mul ## len ## pre(ret, x, y); modF(z, ret); }
 
 #if CYBOZU_OS_BIT == 64
@@ -328,13 +780,47 @@ MIE_FP_DEF_METHOD(544, L)
 #endif
 #undef MIE_FP_DEF_METHOD
 #endif
+	/*
+		y[N] = x[N * 2] / R mod p by mpz
+		x < pR
+	*/
+	static inline void montRedF(Unit *y, const Unit *x)
+	{
+		const Op& op = getOp();
+		modF(y, x);
+		op.mul(y, y, op.one);
+	}
+	static inline void sqrPre(Unit *y, const Unit *x)
+	{
+		getOp().mulPre(y, x, x);
+	}
+	// z[N * 2] = x[N * 2] + y[N * 2] mod pR
+	static inline void dblAdd(Unit *z, const Unit *x, const Unit *y)
+	{
+		const Unit c = local::addArray(z, x, y, N * 2);
+		Unit t[N];
+		const Unit b = local::subArray(t, z + N, getOp().p, N);
+		if (c || !b) copy(z + N, t);
+	}
+	// z[N * 2] = x[N * 2] - y[N * 2] mod pR
+	static inline void dblSub(Unit *z, const Unit *x, const Unit *y)
+	{
+		if (local::subArray(z, x, y, N * 2)) {
+			local::addArray(z + N, z + N, getOp().p, N);
+		}
+	}
+	// z[N * 2] = x[N * 2] + y[N * 2]
+	static inline void dblAddPre(Unit *z, const Unit *x, const Unit *y)
+	{
+		local::addArray(z, x, y, N * 2);
+	}
 	// y[N] = 1 / x[N] mod p[N]
 	static inline void invF(Unit *y, const Unit *x)
 	{
 		mpz_class my;
 		mpz_t mx;
 		set_mpz_t(mx, x);
-		mpz_invert(my.get_mpz_t(), mx, op_->mp.get_mpz_t());
+		mpz_invert(my.get_mpz_t(), mx, getOp().mp.get_mpz_t());
 		local::toArray(y, N, my.get_mpz_t());
 	}
 	static inline void fromRawGmp(Unit *y, const mpz_class& x)
@@ -344,21 +830,128 @@ MIE_FP_DEF_METHOD(544, L)
 #ifdef MIE_FP_GENERATOR_USE_XBYAK
 	static inline void invM(Unit *y, const Unit *x)
 	{
-		const int2op preInv = Xbyak::CastTo<int2op>(fg_.preInv_);
+		const Op& op = getOp();
 		Unit r[N];
-		int k = preInv(r, x);
+		int k = op.preInv(r, x);
 		/*
 			xr = 2^k
 			R = 2^(N * 64)
 			get r2^(-k)R^2 = r 2^(N * 64 * 2 - k)
 		*/
-		op_->mul(y, r, op_->invTbl.data() + k * N);
+		op.mul(y, r, op.invTbl.data() + k * N);
 	}
 #endif
+	/*
+		y = 1 / x for Montgomery form without invTbl
+		invF(xR) = 1 / (xR), then multiply by R^2 twice
+	*/
+	static inline void invMontF(Unit *y, const Unit *x)
+	{
+		const Op& op = getOp();
+		invF(y, x);
+		op.mul(y, y, op.RR);
+		op.mul(y, y, op.RR);
+	}
+	/*
+		y = invE0 / x by safegcd(Bernstein-Yang) in constant time
+		y = 0 if x = 0
+	*/
+	static inline void invSafegcd(Unit *y, const Unit *x)
+	{
+		const Op& op = getOp();
+		int64_t f[N62], g[N62], d[N62], e[N62], t[4];
+		for (size_t i = 0; i < N62; i++) {
+			f[i] = op.p62[i];
+			d[i] = 0;
+			e[i] = op.invE0[i];
+		}
+		local::splitBits((uint64_t*)g, 1, x, N, N62, 62);
+		int64_t delta = 1;
+		for (size_t i = 0; i < op.invIterN; i++) {
+			delta = op.divsteps(delta, uint64_t(f[0]), uint64_t(g[0]), t);
+			local::updateDE62(d, e, t, op.p62, op.pInv62, N62);
+			local::updateFG62(f, g, t, N62);
+		}
+		// g = 0 and f = +-1
+		local::normalize62(d, f[N62 - 1] >> 63, op.p62, N62);
+		local::joinBits(y, N, (const uint64_t*)d, 1, N62, 62);
+	}
+	/*
+		portable version of FpGenerator::mul8_
+		(x R52)(y R52) / R * (R^2 / R52) / R = (x y) R52
+	*/
+	static inline void mul8(Unit *z, const Unit *x, const Unit *y)
+	{
+		const Op& op = getOp();
+		const size_t n52 = op.N52;
+		uint64_t *pz = (uint64_t*)z;
+		const uint64_t *px = (const uint64_t*)x;
+		const uint64_t *py = (const uint64_t*)y;
+		Unit s[N], t[N];
+		for (size_t k = 0; k < 8; k++) {
+			local::joinR52(s, N, px + k, 8, n52);
+			local::joinR52(t, N, py + k, 8, n52);
+			op.mul(s, s, t);
+			op.mul(s, s, op.fromR52);
+			local::splitR52(pz + k, 8, s, N, n52);
+		}
+	}
+	/*
+		y[i] = 1 / x[i] for i = 0, ..., n - 1 with one inv (Montgomery's trick)
+		y[i] = 0 if x[i] = 0
+		x[i] is at x + i * stride, y[i] is at y + i * stride
+		y may be equal to x
+	*/
+	static inline void invVec(Unit *y, const Unit *x, size_t n, size_t stride)
+	{
+		if (n == 0) return;
+		const Op& op = getOp();
+		std::vector<Unit> tmp;
+		Unit *pre = y; // pre[i] = product of non-zero x[0..i]
+		size_t preStride = stride;
+		if (y == x) {
+			tmp.resize(n * N);
+			pre = &tmp[0];
+			preStride = N;
+		}
+		size_t first = n; // position of the first non-zero x[i]
+		Unit acc[N];
+		for (size_t i = 0; i < n; i++) {
+			const Unit *xi = x + i * stride;
+			if (!isZero(xi)) {
+				if (first == n) {
+					copy(acc, xi);
+					first = i;
+				} else {
+					op.mul(acc, acc, xi);
+				}
+			}
+			if (first < n) copy(pre + i * preStride, acc);
+		}
+		if (first == n) {
+			for (size_t i = 0; i < n; i++) clear(y + i * stride);
+			return;
+		}
+		op.inv(acc, acc);
+		for (size_t i = n - 1; i > first; i--) {
+			const Unit *xi = x + i * stride;
+			Unit *yi = y + i * stride;
+			if (isZero(xi)) {
+				clear(yi);
+				continue;
+			}
+			Unit t[N];
+			op.mul(t, acc, pre + (i - 1) * preStride);
+			op.mul(acc, acc, xi);
+			copy(yi, t);
+		}
+		copy(y + first * stride, acc);
+		for (size_t i = 0; i < first; i++) clear(y + i * stride);
+	}
 	// common
 	static inline void square(Unit *y, const Unit *x)
 	{
-		op_->mul(y, x, x);
+		getOp().mul(y, x, x);
 	}
 	static inline void clear(Unit *x)
 	{
@@ -372,48 +965,96 @@ MIE_FP_DEF_METHOD(544, L)
 	{
 		return local::isZeroArray(x, N);
 	}
-	static inline void init(Op& op, const mpz_class& mp, size_t bitLen, bool useMont = true)
+	// bind op to the current thread in the scope
+	struct ThreadScope {
+		const Op *prev_;
+		explicit ThreadScope(const Op *op) : prev_(bindThread(op)) {}
+		~ThreadScope() { curOp_ = prev_; }
+	};
+	/*
+		useSafegcd : use invSafegcd for inv instead of preInv(or GMP) with invTbl
+		(off by default ; invSafegcd runs in constant time)
+		init does not change the default Op(see Op::setDefault)
+	*/
+	static inline void init(Op& op, const mpz_class& mp, size_t bitLen, bool useMont = true, bool useSafegcd = false)
 	{
 #ifndef MIE_FP_GENERATOR_USE_XBYAK
 		useMont = false;
 #endif
 		assert(N >= 2);
 		assert(sizeof(mp_limb_t) == sizeof(Unit));
-		op_ = &op;
+		ThreadScope scope(&op); // functions below may refer to op by getOp()
 		op.mp = mp;
 		fromRawGmp(op.p, mp);
 
 		op.useMont = useMont;
 		op.N = N;
 		op.bitLen = bitLen;
+		if (!useMont) op.primeForm = PrimeForm();
 
 		op.isZero = &isZero;
 		op.clear = &clear;
 		op.copy = &copy;
+		op.invVec = &invVec;
+		op.mul8 = 0;
+		op.mulPre = &mulPre;
+		op.sqrPre = &sqrPre;
+		op.mod = &modF;
+		op.dblAdd = &dblAdd;
+		op.dblSub = &dblSub;
+		op.dblAddPre = &dblAddPre;
+		op.preInv = 0;
+		op.setDefault = &setDefault;
+		op.bindThread = &bindThread;
+		divstepsOp jitDivsteps = 0;
 
 		if (op.useMont) {
 
 #ifdef MIE_FP_GENERATOR_USE_XBYAK
-			fg_.init(op.p, N);
+			const FpGenerator *fg;
+			if (N <= (size_t)FpGenerator::maxUnrollPn) {
+				fg = FpGeneratorCache::get(op.p, (int)N, op.primeForm);
+			} else {
+				if (op.largeFg == 0) op.largeFg = new FpGenerator();
+				op.largeFg->init(op.p, (int)N, op.primeForm);
+				fg = op.largeFg;
+			}
+			// fg may reject the form
+			op.primeForm = fg->form_;
+			op.preInv = fg->preInv_;
+			jitDivsteps = fg->divsteps_;
 
-			op.neg = Xbyak::CastTo<void2op>(fg_.neg_);
-			op.inv = &invM;
-			op.square = Xbyak::CastTo<void2op>(fg_.sqr_);
+			op.neg = Xbyak::CastTo<void2op>(fg->neg_);
+			op.inv = fg->preInv_ ? &invM : &invMontF;
+			op.square = Xbyak::CastTo<void2op>(fg->sqr_);
 			if (op.square == 0) op.square = &square;
-			op.add = Xbyak::CastTo<void3op>(fg_.add_);
-			op.sub = Xbyak::CastTo<void3op>(fg_.sub_);
-			op.mul = Xbyak::CastTo<void3op>(fg_.mul_);
+			op.add = Xbyak::CastTo<void3op>(fg->add_);
+			op.sub = Xbyak::CastTo<void3op>(fg->sub_);
+			op.mul = Xbyak::CastTo<void3op>(fg->mul_);
+			op.mul8 = Xbyak::CastTo<void3op>(fg->mul8_);
+			op.mod = &montRedF;
+			if (fg->mulPre_) {
+				op.mulPre = Xbyak::CastTo<void3op>(fg->mulPre_);
+				op.sqrPre = Xbyak::CastTo<void2op>(fg->sqrPre_);
+				op.mod = Xbyak::CastTo<void2op>(fg->montRed_);
+			}
+			if (fg->red_) {
+				// no Montgomery form for a special prime
+				op.useMont = false;
+				op.inv = &invF;
+				op.mod = Xbyak::CastTo<void2op>(fg->red_);
+			}
 
-	//		shr1 = Xbyak::CastTo<void2op>(fg_.shr1_);
-	//		addNc = Xbyak::CastTo<bool3op>(fg_.addNc_);
-	//		subNc = Xbyak::CastTo<bool3op>(fg_.subNc_);
+	//		shr1 = Xbyak::CastTo<void2op>(fg->shr1_);
+	//		addNc = Xbyak::CastTo<bool3op>(fg->addNc_);
+	//		subNc = Xbyak::CastTo<bool3op>(fg->subNc_);
 #endif
 			mpz_class t = 1;
 			fromRawGmp(op.one, t);
 			t = (t << (N * sizeof(Unit) * 8)) % op.mp;
 			t = (t * t) % op.mp;
 			fromRawGmp(op.RR, t);
-			op.initInvTbl(N);
+			if (op.preInv && !useSafegcd) op.initInvTbl(N);
 		} else {
 			op.neg = &neg;
 			op.inv = &invF;
@@ -444,46 +1085,110 @@ MIE_FP_DEF_METHOD(544, L)
 			case 544: op.add = &add544; op.sub = &sub544; op.mul = &mul544; break;
 #endif
 			}
-			if (op_->mp == mpz_class("0xfffffffffffffffffffffffffffffffeffffffffffffffff")) {
+			if (op.mp == mpz_class("0xfffffffffffffffffffffffffffffffeffffffffffffffff")) {
 				op.mul = &mie_fp_mul_NIST_P192; // slower than MontFp192
 			}
 #endif
 		}
+		initSafegcd(op, useSafegcd, jitDivsteps);
+		initIfma8(op);
+		mpz_class R = 1;
+		if (op.useMont) R = (R << (N * sizeof(Unit) * 8)) % op.mp;
+		fromRawGmp(op.R, R);
+	}
+	/*
+		jitDivsteps : divsteps of FpGenerator for op if any
+	*/
+	static inline void initSafegcd(Op& op, bool useSafegcd, divstepsOp jitDivsteps = 0)
+	{
+		const bool isOdd = (op.p[0] & 1) != 0;
+		op.useSafegcd = useSafegcd && isOdd;
+		op.invCT = op.inv;
+		if (!isOdd) return;
+		local::splitBits((uint64_t*)op.p62, 1, op.p, N, N62, 62);
+		if (op.useMont) {
+			local::splitBits((uint64_t*)op.invE0, 1, op.RR, N, N62, 62);
+		} else {
+			Unit one[N] = { 1 };
+			local::splitBits((uint64_t*)op.invE0, 1, one, N, N62, 62);
+		}
+		op.pInv62 = (0 - montgomery::getCoff<uint64_t>(uint64_t(op.p62[0]))) & local::mask62;
+		/*
+			number of divsteps for p < 2^d by Theorem 11.2 of
+			"Fast constant-time gcd computation and modular inversion"
+		*/
+		const size_t d = op.bitLen;
+		const size_t stepN = d < 46 ? (49 * d + 80) / 17 : (49 * d + 57) / 17;
+		op.invIterN = (stepN + 61) / 62;
+		op.divsteps = jitDivsteps ? jitDivsteps : &local::divsteps62;
+		op.invCT = &invSafegcd;
+		if (!op.useSafegcd) return;
+		std::vector<Unit>().swap(op.invTbl);
+		op.inv = &invSafegcd;
+	}
+	static inline void initIfma8(Op& op)
+	{
+		op.N52 = (op.bitLen + 51) / 52;
+		if (op.mul8 == 0) op.mul8 = &mul8;
+		const mpz_class R52 = mpz_class(1) << (op.N52 * 52);
+		mpz_class R = 1;
+		if (op.useMont) R = (R << (N * sizeof(Unit) * 8)) % op.mp;
+		mpz_class t = R52 % op.mp;
+		fromRawGmp(op.toR52, t);
+		mpz_invert(t.get_mpz_t(), t.get_mpz_t(), op.mp.get_mpz_t());
+		t = (R * R * t) % op.mp;
+		fromRawGmp(op.fromR52, t);
 	}
 };
 template<class tag, size_t bitN> const Op *FpBase<tag, bitN>::op_;
-#ifdef MIE_FP_GENERATOR_USE_XBYAK
-template<class tag, size_t bitN> FpGenerator FpBase<tag, bitN>::fg_;
-#endif
+template<class tag, size_t bitN> MIE_THREAD_LOCAL const Op *FpBase<tag, bitN>::curOp_;
 
 template<class tag, size_t maxBitN>
-inline void Op::setModulo(const mpz_class& mp, bool useMont)
+inline void Op::setModulo(const mpz_class& mp, bool useMont, bool useSafegcd)
 {
 	const size_t bitLen = Gmp::getBitLen(mp);
 	if (bitLen > maxBitN) throw cybozu::Exception("mie:fp:Op:setModulo:large mp") << mp << maxBitN;
+	primeForm = useMont ? local::getPrimeForm(mp) : PrimeForm();
 	const size_t unitBit = sizeof(Unit) * 8;
 	const size_t n = (bitLen + unitBit - 1) / unitBit;
-	if (n == 0 || n > fp::maxUnitN) throw cybozu::Exception("mie:fp:Op:setModulo:large mp") << mp << fp::maxUnitN;
+	if (n == 0 || n > fp::maxLargeUnitN) throw cybozu::Exception("mie:fp:Op:setModulo:large mp") << mp << fp::maxLargeUnitN;
+	if (n > fp::maxUnitN) {
+		/*
+			round up to the typical size of RSA or Paillier
+			FpBase<tag, x> is instantiated only if x <= maxBitN
+		*/
+#define MIE_FP_LARGE_INIT(x) \
+	if (n * unitBit <= x) { FpBase<tag, (x < maxBitN ? x : maxBitN)>::init(*this, mp, bitLen, useMont, useSafegcd); return; }
+		MIE_FP_LARGE_INIT(1024)
+		MIE_FP_LARGE_INIT(1536)
+		MIE_FP_LARGE_INIT(2048)
+		MIE_FP_LARGE_INIT(3072)
+		MIE_FP_LARGE_INIT(4096)
+		MIE_FP_LARGE_INIT(6144)
+#undef MIE_FP_LARGE_INIT
+		FpBase<tag, maxBitN>::init(*this, mp, bitLen, useMont, useSafegcd);
+		return;
+	}
 	switch (n * unitBit) {
-	case 128: FpBase<tag, 128>::init(*this, mp, bitLen, useMont); break;
-	case 192: FpBase<tag, 192>::init(*this, mp, bitLen, useMont); break;
-	case 256: FpBase<tag, 256>::init(*this, mp, bitLen, useMont); break;
-	case 320: FpBase<tag, 320>::init(*this, mp, bitLen, useMont); break;
-	case 384: FpBase<tag, 384>::init(*this, mp, bitLen, useMont); break;
-	case 448: FpBase<tag, 448>::init(*this, mp, bitLen, useMont); break;
-	case 512: FpBase<tag, 512>::init(*this, mp, bitLen, useMont); break;
+	case 128: FpBase<tag, 128>::init(*this, mp, bitLen, useMont, useSafegcd); break;
+	case 192: FpBase<tag, 192>::init(*this, mp, bitLen, useMont, useSafegcd); break;
+	case 256: FpBase<tag, 256>::init(*this, mp, bitLen, useMont, useSafegcd); break;
+	case 320: FpBase<tag, 320>::init(*this, mp, bitLen, useMont, useSafegcd); break;
+	case 384: FpBase<tag, 384>::init(*this, mp, bitLen, useMont, useSafegcd); break;
+	case 448: FpBase<tag, 448>::init(*this, mp, bitLen, useMont, useSafegcd); break;
+	case 512: FpBase<tag, 512>::init(*this, mp, bitLen, useMont, useSafegcd); break;
 #if CYBOZU_OS_BIT == 64
-	case 576: FpBase<tag, 576>::init(*this, mp, bitLen, useMont); break;
+	case 576: FpBase<tag, 576>::init(*this, mp, bitLen, useMont, useSafegcd); break;
 #else
-	case 160: FpBase<tag, 160>::init(*this, mp, bitLen, useMont); break;
-	case 224: FpBase<tag, 224>::init(*this, mp, bitLen, useMont); break;
-	case 288: FpBase<tag, 288>::init(*this, mp, bitLen, useMont); break;
-	case 352: FpBase<tag, 352>::init(*this, mp, bitLen, useMont); break;
-	case 416: FpBase<tag, 416>::init(*this, mp, bitLen, useMont); break;
-	case 480: FpBase<tag, 480>::init(*this, mp, bitLen, useMont); break;
-	case 544: FpBase<tag, 544>::init(*this, mp, bitLen, useMont); break;
+	case 160: FpBase<tag, 160>::init(*this, mp, bitLen, useMont, useSafegcd); break;
+	case 224: FpBase<tag, 224>::init(*this, mp, bitLen, useMont, useSafegcd); break;
+	case 288: FpBase<tag, 288>::init(*this, mp, bitLen, useMont, useSafegcd); break;
+	case 352: FpBase<tag, 352>::init(*this, mp, bitLen, useMont, useSafegcd); break;
+	case 416: FpBase<tag, 416>::init(*this, mp, bitLen, useMont, useSafegcd); break;
+	case 480: FpBase<tag, 480>::init(*this, mp, bitLen, useMont, useSafegcd); break;
+	case 544: FpBase<tag, 544>::init(*this, mp, bitLen, useMont, useSafegcd); break;
 #endif
-	default:  FpBase<tag, maxBitN>::init(*this, mp, bitLen, useMont); break;
+	default:  FpBase<tag, maxBitN>::init(*this, mp, bitLen, useMont, useSafegcd); break;
 	}
 }
 
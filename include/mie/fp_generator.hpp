@@ -8,6 +8,8 @@
 */
 #include <stdio.h>
 #include <assert.h>
+#include <vector>
+#include <algorithm>
 #include <cybozu/exception.hpp>
 
 namespace mie {
@@ -38,7 +40,71 @@ T getCoff(T pLow)
 	return ret;
 }
 
-} } // mie::montgomery
+} // mie::montgomery
+
+namespace fp {
+
+/*
+	special form of p for fast reduction without Montgomery form
+	PrimePseudoMersenne : p = 2^k - c (c may be negative)
+	PrimeSolinas : p = 2^k - c where c is sparse in radix 2^32(see getSolinasDigit)
+	c is not used for PrimeSolinas
+*/
+enum PrimeType {
+	PrimeGeneric = 0,
+	PrimePseudoMersenne,
+	PrimeSolinas
+};
+
+struct PrimeForm {
+	PrimeType type;
+	int k;
+	int64_t c;
+	PrimeForm() : type(PrimeGeneric), k(0), c(0) {}
+};
+
+static const int maxSolinasPn = 6;
+static const int maxSolinasWordN = maxSolinasPn * 2;
+
+/*
+	get d[0..k/32) such that 2^k - p = sum_i d[i] 2^(32 i) and d[i] is in {-1, 0, 1}
+	p[0..pn) is a k-bit prime and k is a multiple of 32
+	return false if there is no such d[]
+*/
+inline bool getSolinasDigit(int *d, const uint64_t *p, int pn, int k)
+{
+	if (k <= 0 || k % 32 || k > maxSolinasWordN * 32 || k > pn * 64) return false;
+	const int wn = k / 32;
+	for (int i = k / 64; i < pn; i++) {
+		const uint64_t v = (i * 64 < k) ? (p[i] >> 32) : p[i];
+		if (v) return false;
+	}
+	if (((p[(wn - 1) / 2] >> (((wn - 1) & 1) * 32)) >> 31) == 0) return false;
+	// 2^k - p = sum_i (~p[i] + 1) 2^(32 i) in 32-bit words
+	uint64_t borrow = 0;
+	uint64_t carry = 0;
+	for (int i = 0; i < wn; i++) {
+		const uint64_t w = uint32_t(p[i / 2] >> ((i & 1) * 32));
+		const uint64_t v = (uint64_t(1) << 32) - w - borrow;
+		borrow = 1 - (v >> 32);
+		const uint64_t u = uint32_t(v) + carry;
+		if (u == 0 || u == (uint64_t(1) << 32)) {
+			d[i] = 0;
+			carry = u >> 32;
+		} else if (u == 1) {
+			d[i] = 1;
+			carry = 0;
+		} else if (u == 0xffffffff) {
+			d[i] = -1;
+			carry = 1;
+		} else {
+			return false;
+		}
+	}
+	return carry == 0;
+}
+
+} } // mie::fp
 
 #if (CYBOZU_HOST == CYBOZU_HOST_INTEL) && (CYBOZU_OS_BIT == 64)
 
@@ -49,11 +115,60 @@ T getCoff(T pLow)
 #endif
 #include <xbyak/xbyak.h>
 #include <xbyak/xbyak_util.h>
+#include <map>
+#include <cybozu/mutex.hpp>
 
 namespace mie {
 
 namespace fp_gen_local {
 
+/*
+	executable memory for the cached FpGenerators
+	each code buffer is carved out of a large chunk, so that the kernels
+	are packed into a few pages
+	a buffer is never freed because the kernels live until the process exits
+*/
+class CodePool : public Xbyak::Allocator {
+	static const size_t chunkSize = 1024 * 1024;
+	static const size_t alignSize = 64;
+	uint8_t *cur_;
+	size_t remain_;
+	uint8_t *last_;
+	static size_t roundUp(size_t n) { return (n + alignSize - 1) & ~(alignSize - 1); }
+public:
+	CodePool() : cur_(0), remain_(0), last_(0) {}
+	uint8_t *alloc(size_t size)
+	{
+		size = roundUp(size);
+		if (size > remain_) {
+			// page aligned(std::max takes a reference so copy chunkSize)
+			const size_t minSize = chunkSize;
+			const size_t n = std::max(size, minSize);
+			cur_ = Xbyak::Allocator().alloc(n);
+			if (cur_ == 0) throw cybozu::Exception("mie:CodePool:alloc") << n;
+			remain_ = n;
+		}
+		last_ = cur_;
+		cur_ += size;
+		remain_ -= size;
+		return last_;
+	}
+	void free(uint8_t *) {}
+	/*
+		return the unused tail of the last buffer to the pool
+	*/
+	void shrink(const uint8_t *p, size_t usedSize)
+	{
+		if (p == 0 || p != last_) return;
+		usedSize = roundUp(usedSize);
+		const size_t size = cur_ - last_;
+		if (usedSize >= size) return;
+		cur_ = last_ + usedSize;
+		remain_ += size - usedSize;
+	}
+	size_t getRemain() const { return remain_; }
+};
+
 class MemReg {
 	const Xbyak::Reg64 *r_;
 	const Xbyak::RegExp *m_;
@@ -163,12 +278,46 @@ struct FpGenerator : Xbyak::CodeGenerator {
 	typedef fp_gen_local::MemReg MemReg;
 	static const int UseRDX = Xbyak::util::UseRDX;
 	static const int UseRCX = Xbyak::util::UseRCX;
+	// max pn for the fully unrolled kernels
+	static const int maxUnrollPn = 9;
+	// max pn (8192 bit) for the looped kernels
+	static const int maxLargePn = 128;
+	// max number of 52-bit digits for mul8_
+	static const int maxN52 = (64 * 9 + 51) / 52;
 	Xbyak::util::Cpu cpu_;
 	bool useMulx_;
+	bool useIfma_;
+	// p_ points to pBuf_ because the kernels refer to p_ after init
+	uint64_t pBuf_[maxLargePn];
 	const uint64_t *p_;
 	uint64_t pp_;
 	int pn_;
 	bool isFullBit_;
+	int n52_; // number of 52-bit digits of p
+	/*
+		constant table for mul8_
+		ifmaTbl_[0..n52_) : p in radix 2^52
+		ifmaTbl_[n52_] : -p^(-1) mod 2^52
+		ifmaTbl_[n52_ + 1] : 2^52 - 1
+	*/
+	uint64_t ifmaTbl_[maxN52 + 2];
+	/*
+		for a pseudo-Mersenne prime
+		pmTbl_[i] : 2^e p added at the i-th folding if c < 0
+	*/
+	static const int maxFoldN = 4;
+	static const int maxFoldPn = maxUnrollPn + 4;
+	fp::PrimeForm form_;
+	uint64_t pmTbl_[maxFoldN][maxFoldPn];
+	/*
+		for a Solinas prime
+		solTbl_[(h + solM_) * (pn_ + 1)..] : -h' p mod 2^(64(pn_ + 1))
+		for -solM_ <= h < solP_, where h' = h if h >= 0 else h - 1
+	*/
+	static const int maxSolTermN = 16;
+	int solP_;
+	int solM_;
+	uint64_t solTbl_[maxSolTermN * (fp::maxSolinasPn + 1)];
 	// add/sub without carry. return true if overflow
 	typedef bool (*bool3op)(uint64_t*, const uint64_t*, const uint64_t*);
 
@@ -183,48 +332,120 @@ struct FpGenerator : Xbyak::CodeGenerator {
 
 	// preInv
 	typedef int (*int2op)(uint64_t*, const uint64_t*);
+
+	// divsteps
+	typedef int64_t (*divstepsOp)(int64_t, uint64_t, uint64_t, int64_t*);
 	bool3op addNc_;
 	bool3op subNc_;
 	void3op add_;
 	void3op sub_;
 	void3op mul_;
+	/*
+		Montgomery multiplication of 8 elements at once(AVX-512 IFMA)
+		see gen_mul8 for the layout. 0 if not supported
+	*/
+	void3op mul8_;
+	/*
+		double width operations for lazy reduction
+		mulPre_(z, x, y) : z[0..2pn) = x[0..pn) * y[0..pn)
+		sqrPre_(z, x) : z[0..2pn) = x[0..pn)^2
+		montRed_(z, xy) : z[0..pn) = xy[0..2pn) / R mod p for xy < pR
+		0 if pn > maxUnrollPn
+	*/
+	void3op mulPre_;
+	void2op sqrPre_;
+	void2op montRed_;
+	/*
+		red_(z, xy) : z[0..pn) = xy[0..2pn) mod p
+		for a pseudo-Mersenne or Solinas prime, 0 otherwise
+		then mul_ and sqr_ do not use Montgomery form
+	*/
+	void2op red_;
 	uint3opI mulI_;
 	void2op sqr_;
 	void2op neg_;
 	void2op shr1_;
 	int2op preInv_;
-	FpGenerator()
-		: CodeGenerator(4096 * 8)
+	/*
+		62 divsteps of safegcd(Bernstein-Yang) in constant time
+		see gen_divsteps62. independent of p
+	*/
+	divstepsOp divsteps_;
+	/*
+		allocator : allocate the code buffer from it if not 0
+	*/
+	explicit FpGenerator(Xbyak::Allocator *allocator = 0)
+		: CodeGenerator(4096 * 8, 0, allocator)
 		, p_(0)
 		, pp_(0)
 		, pn_(0)
 		, isFullBit_(0)
+		, n52_(0)
+		, solP_(0)
+		, solM_(0)
 		, addNc_(0)
 		, subNc_(0)
 		, add_(0)
 		, sub_(0)
 		, mul_(0)
+		, mul8_(0)
+		, mulPre_(0)
+		, sqrPre_(0)
+		, montRed_(0)
+		, red_(0)
 		, mulI_(0)
 		, neg_(0)
 		, shr1_(0)
 		, preInv_(0)
+		, divsteps_(0)
 	{
-		useMulx_ = cpu_.has(Xbyak::util::Cpu::tBMI2);
+		const int feature = getCpuFeature(cpu_);
+		useMulx_ = (feature & 1) != 0;
+		useIfma_ = (feature & 2) != 0;
+	}
+	/*
+		CPU features used by the kernels
+		bit 0 : mulx, bit 1 : AVX-512 IFMA
+	*/
+	static int getCpuFeature(const Xbyak::util::Cpu& cpu)
+	{
+		int feature = 0;
+		if (cpu.has(Xbyak::util::Cpu::tBMI2)) feature |= 1;
+		if (cpu.has(Xbyak::util::Cpu::tAVX512F) && cpu.has(Xbyak::util::Cpu::tAVX512_IFMA)) feature |= 2;
+		return feature;
 	}
 	/*
 		@param p [in] pointer to prime
 		@param pn [in] length of prime
+		@param form [in] special form of p
+		mul_ and sqr_ are Montgomery multiplication if form is PrimeGeneric
+		and modular multiplication otherwise
 	*/
-	void init(const uint64_t *p, int pn)
+	void init(const uint64_t *p, int pn, const fp::PrimeForm& form = fp::PrimeForm())
 	{
 		if (pn < 2) throw cybozu::Exception("mie:FpGenerator:small pn") << pn;
-		p_ = p;
-		pp_ = montgomery::getCoff(p[0]);
+		if (pn > maxLargePn) throw cybozu::Exception("mie:FpGenerator:large pn") << pn;
+		std::copy(p, p + pn, pBuf_);
+		p_ = pBuf_;
+		pp_ = montgomery::getCoff(p_[0]);
 		pn_ = pn;
 		isFullBit_ = (p_[pn_ - 1] >> 63) != 0;
+		form_ = form;
+		red_ = 0;
 //		printf("p=%p, pn_=%d, isFullBit_=%d\n", p_, pn_, isFullBit_);
 
 		setSize(0); // reset code
+		if (pn_ > maxUnrollPn) {
+			form_ = fp::PrimeForm();
+			initLarge();
+			return;
+		}
+		if (form_.type == fp::PrimePseudoMersenne && !isValidPseudoMersenne()) {
+			form_ = fp::PrimeForm();
+		}
+		if (form_.type == fp::PrimeSolinas && !initSolinas()) {
+			form_ = fp::PrimeForm();
+		}
 		align(16);
 		addNc_ = getCurr<bool3op>();
 		gen_addSubNc(true);
@@ -244,18 +465,121 @@ struct FpGenerator : Xbyak::CodeGenerator {
 		mulI_ = getCurr<uint3opI>();
 		gen_mulI();
 		align(16);
-		mul_ = getCurr<void3op>();
-		gen_mul();
+		mulPre_ = getCurr<void3op>();
+		gen_mulPre();
 		align(16);
-		sqr_ = getCurr<void2op>();
-		if (!gen_sqr()) {
-			sqr_ = 0;
+		sqrPre_ = getCurr<void2op>();
+		gen_sqrPre();
+		if (form_.type == fp::PrimePseudoMersenne) {
+			align(16);
+			mul_ = getCurr<void3op>();
+			gen_mulPM(false);
+			align(16);
+			sqr_ = getCurr<void2op>();
+			gen_mulPM(true);
+			align(16);
+			red_ = getCurr<void2op>();
+			gen_redPM();
+			montRed_ = 0;
+		} else if (form_.type == fp::PrimeSolinas) {
+			align(16);
+			mul_ = getCurr<void3op>();
+			gen_mulSolinas(false);
+			align(16);
+			sqr_ = getCurr<void2op>();
+			gen_mulSolinas(true);
+			align(16);
+			red_ = getCurr<void2op>();
+			gen_redSolinas();
+			montRed_ = 0;
+		} else {
+			align(16);
+			mul_ = getCurr<void3op>();
+			gen_mul();
+			align(16);
+			sqr_ = getCurr<void2op>();
+			if (!gen_sqr()) {
+				sqr_ = 0;
+			}
+			align(16);
+			montRed_ = getCurr<void2op>();
+			gen_montRed();
 		}
 		align(16);
 		shr1_ = getCurr<void2op>();
 		gen_shr1();
-		preInv_ = getCurr<int2op>();
-		gen_preInv();
+		preInv_ = 0;
+		if (form_.type == fp::PrimeGeneric) {
+			preInv_ = getCurr<int2op>();
+			gen_preInv();
+		}
+		align(16);
+		divsteps_ = getCurr<divstepsOp>();
+		gen_divsteps62();
+		mul8_ = 0;
+		if (useIfma_ && initIfmaTbl()) {
+			align(16);
+			mul8_ = getCurr<void3op>();
+			gen_mul8();
+		}
+	}
+	/*
+		generate looped kernels for pn_ > maxUnrollPn
+		only add_, sub_, neg_, mul_, sqr_ and divsteps_ are available
+	*/
+	void initLarge()
+	{
+		addNc_ = 0;
+		subNc_ = 0;
+		mulI_ = 0;
+		shr1_ = 0;
+		preInv_ = 0;
+		mul8_ = 0;
+		mulPre_ = 0;
+		sqrPre_ = 0;
+		montRed_ = 0;
+		align(16);
+		add_ = getCurr<void3op>();
+		gen_addModLarge();
+		align(16);
+		sub_ = getCurr<void3op>();
+		gen_subLarge();
+		align(16);
+		neg_ = getCurr<void2op>();
+		gen_negLarge();
+		align(16);
+		mul_ = getCurr<void3op>();
+		gen_montMulLarge();
+		align(16);
+		sqr_ = getCurr<void2op>();
+		gen_montSqrLarge();
+		align(16);
+		divsteps_ = getCurr<divstepsOp>();
+		gen_divsteps62();
+	}
+	/*
+		set n52_ and ifmaTbl_
+		return false if p is too large
+	*/
+	bool initIfmaTbl()
+	{
+		int bitLen = pn_ * 64;
+		while (bitLen > 0 && ((p_[(bitLen - 1) / 64] >> ((bitLen - 1) % 64)) & 1) == 0) {
+			bitLen--;
+		}
+		n52_ = (bitLen + 51) / 52;
+		if (n52_ > maxN52) return false;
+		const uint64_t mask = (uint64_t(1) << 52) - 1;
+		for (int i = 0; i < n52_; i++) {
+			const int q = (i * 52) / 64;
+			const int r = (i * 52) % 64;
+			uint64_t v = p_[q] >> r;
+			if (r > 12 && q + 1 < pn_) v |= p_[q + 1] << (64 - r);
+			ifmaTbl_[i] = v & mask;
+		}
+		ifmaTbl_[n52_] = pp_ & mask; // pp_ = -p^(-1) mod 2^64
+		ifmaTbl_[n52_ + 1] = mask;
+		return true;
 	}
 	void gen_addSubNc(bool isAdd)
 	{
@@ -582,6 +906,10 @@ struct FpGenerator : Xbyak::CodeGenerator {
 			gen_montSqr3(p_, pp_);
 			return true;
 		}
+		if (pn_ <= 9) {
+			gen_montSqrN(p_, pp_, pn_);
+			return true;
+		}
 		return false;
 	}
 	/*
@@ -622,6 +950,1130 @@ struct FpGenerator : Xbyak::CodeGenerator {
 		}
 	L("@@");
 	}
+	/*
+		one folding step for p = 2^k - c
+		x = H 2^k + L = L + H c mod p for x < 2^bits
+		A = H |c| < 2^aBits
+		c > 0 : T = L + A
+		c < 0 : T = L + 2^e p - A (e = aBits - k) to keep T >= 0
+		if isFinal then
+		c > 0 : T < 2p and z = T or T - p
+		c < 0 : -p < L - A < p and z = L - A or L - A + p
+		nt : number of limbs of T, nextBits : T < 2^nextBits
+	*/
+	struct Fold {
+		int hBits;
+		int nh;
+		int aBits;
+		bool isFinal;
+		int nt;
+		int nextBits;
+	};
+	static int getBitLen64(uint64_t x)
+	{
+		int n = 0;
+		while (x) {
+			n++;
+			x >>= 1;
+		}
+		return n;
+	}
+	uint64_t getAbsC() const { return form_.c < 0 ? 0 - uint64_t(form_.c) : uint64_t(form_.c); }
+	Fold getFold(int bits) const
+	{
+		const int k = form_.k;
+		const bool isNeg = form_.c < 0;
+		Fold f;
+		f.hBits = bits - k;
+		f.nh = (f.hBits + 63) / 64;
+		f.aBits = f.hBits + getBitLen64(getAbsC());
+		f.isFinal = isNeg ? f.aBits <= k : f.aBits <= k - 1;
+		if (f.isFinal) {
+			f.nextBits = k + 1;
+			f.nt = isNeg ? pn_ : (k + 1 + 63) / 64;
+		} else {
+			f.nextBits = isNeg ? f.aBits + 2 : std::max(k, f.aBits) + 1;
+			f.nt = (f.nextBits + 63) / 64;
+		}
+		return f;
+	}
+	/*
+		p = 2^k - c is supported if |c| is small enough
+		and the folding from 2pn_ limbs terminates within maxFoldN steps
+	*/
+	bool isValidPseudoMersenne() const
+	{
+		const int k = form_.k;
+		const uint64_t absC = getAbsC();
+		if (absC == 0 || absC >= (uint64_t(1) << 62)) return false;
+		if (k <= 64 * (pn_ - 1) || k > 64 * pn_) return false;
+		if (form_.c < 0 && k == 64 * pn_) return false;
+		if (getBitLen64(absC) * 2 + 2 > k) return false;
+		int bits = pn_ * 128;
+		for (int i = 0; i < maxFoldN; i++) {
+			const Fold f = getFold(bits);
+			if (f.nh + 1 > maxFoldPn || f.nt > maxFoldPn) return false;
+			if (f.isFinal) return true;
+			bits = f.nextBits;
+		}
+		return false;
+	}
+	/*
+		input (pz[], px[], py[]) or (pz[], px[]) if isSqr
+		z[] <- x[] * y[] mod p for a pseudo-Mersenne prime
+	*/
+	void gen_mulPM(bool isSqr)
+	{
+		assert(2 <= pn_ && pn_ <= 9);
+		const int n = pn_;
+		const int stackSize = (n - 1 + n * 2 + (isSqr ? n * 2 : n) + maxFoldPn * 3) * 8;
+		StackFrame sf(this, isSqr ? 2 : 3, 10 | UseRDX, stackSize);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& y = sf.t[0];
+		const Reg64& t = sf.t[1];
+		Pack remain = sf.t.sub(2);
+		size_t rspPos = 0;
+
+		MixPack wk(remain, rspPos, n - 1);
+		const RegExp pw = rsp + rspPos; // pw[0..2n-1] or pw[0..n-1]
+		const RegExp pc = pw + (isSqr ? n * 2 : n) * 8; // pc[0..2n-1]
+		const RegExp pa = pc + n * 2 * 8;
+		const RegExp pt0 = pa + maxFoldPn * 8;
+		const RegExp pt1 = pt0 + maxFoldPn * 8;
+		if (isSqr) {
+			gen_raw_sqrPre(pc, px, pw, y, t, wk, n);
+		} else {
+			gen_raw_mulPre(pc, px, sf.p[2], pw, y, t, wk, n);
+		}
+		// wk is not used any more
+		gen_raw_redPM(pz, pc, n * 2, pa, pt0, pt1, sf.t[2], sf.t[3], sf.t[4], t);
+	}
+	/*
+		input (pz[], pxy[])
+		z[] <- xy[0..2n-1] mod p for a pseudo-Mersenne prime
+	*/
+	void gen_redPM()
+	{
+		StackFrame sf(this, 2, 4 | UseRDX, maxFoldPn * 3 * 8);
+		const RegExp pa = rsp;
+		const RegExp pt0 = pa + maxFoldPn * 8;
+		const RegExp pt1 = pt0 + maxFoldPn * 8;
+		gen_raw_redPM(sf.p[0], sf.p[1], pn_ * 2, pa, pt0, pt1, sf.t[0], sf.t[1], sf.t[2], sf.t[3]);
+	}
+	/*
+		pz[0..pn_-1] <- px[0..nx-1] mod p by folding(see getFold)
+		use pa[], pt0[], pt1[] of maxFoldPn limbs as work area
+		destroy pAddr, cr, c, t
+	*/
+	void gen_raw_redPM(const RegExp& pz, const RegExp& px, int nx, const RegExp& pa, const RegExp& pt0, const RegExp& pt1, const Reg64& pAddr, const Reg64& cr, const Reg64& c, const Reg64& t)
+	{
+		const int k = form_.k;
+		const bool isNeg = form_.c < 0;
+		const int q = k / 64;
+		const int r = k % 64;
+		RegExp src = px;
+		int ns = nx;
+		int bits = nx * 64;
+		mov(pAddr, (size_t)p_);
+		mov(cr, getAbsC());
+		for (int foldI = 0; ; foldI++) {
+			assert(foldI < maxFoldN);
+			const Fold f = getFold(bits);
+			const RegExp dst = (foldI & 1) ? pt1 : pt0;
+			// pa[0..nh] = H |c|
+			for (int i = 0; i < f.nh; i++) {
+				mov(rax, ptr [src + (q + i) * 8]);
+				if (r) {
+					if (q + i + 1 < ns) {
+						mov(t, ptr [src + (q + i + 1) * 8]);
+						shrd(rax, t, r);
+					} else {
+						shr(rax, r);
+					}
+				}
+				mul(cr);
+				if (i > 0) {
+					add(rax, c);
+					adc(rdx, 0);
+				}
+				mov(ptr [pa + i * 8], rax);
+				mov(c, rdx);
+			}
+			mov(ptr [pa + f.nh * 8], c);
+			// dst[0..nt) = L
+			for (int i = 0; i < f.nt; i++) {
+				if (i < q || (i == q && r)) {
+					mov(t, ptr [src + i * 8]);
+					if (i == q) {
+						shl(t, 64 - r);
+						shr(t, 64 - r);
+					}
+					mov(ptr [dst + i * 8], t);
+				} else {
+					mov(qword [dst + i * 8], 0);
+				}
+			}
+			if (isNeg && !f.isFinal) {
+				// dst[] += 2^e p
+				setShiftedP(pmTbl_[foldI], f.nt, f.aBits - k);
+				mov(c, (size_t)pmTbl_[foldI]);
+				for (int i = 0; i < f.nt; i++) {
+					mov(t, ptr [c + i * 8]);
+					if (i == 0) {
+						add(ptr [dst], t);
+					} else {
+						adc(ptr [dst + i * 8], t);
+					}
+				}
+			}
+			// dst[] += pa[] or dst[] -= pa[]
+			// pa[i] = 0 for i >= nt if isFinal
+			for (int i = 0; i < f.nt; i++) {
+				if (i <= f.nh) {
+					mov(t, ptr [pa + i * 8]);
+					if (i == 0) {
+						if (isNeg) {
+							sub(ptr [dst], t);
+						} else {
+							add(ptr [dst], t);
+						}
+					} else {
+						if (isNeg) {
+							sbb(ptr [dst + i * 8], t);
+						} else {
+							adc(ptr [dst + i * 8], t);
+						}
+					}
+				} else {
+					if (isNeg) {
+						sbb(qword [dst + i * 8], 0);
+					} else {
+						adc(qword [dst + i * 8], 0);
+					}
+				}
+			}
+			if (f.isFinal) {
+				if (isNeg) {
+					// dst[] += p if dst[] < 0
+					jnc("@f");
+					gen_raw_add(dst, dst, pAddr, t);
+				L("@@");
+					gen_mov(pz, dst, t, pn_);
+				} else {
+					// pz[] = dst[] - p if dst[] >= p
+					gen_raw_sub(pz, dst, pAddr, t);
+					if (f.nt > pn_) sbb(qword [dst + pn_ * 8], 0);
+					jnc("@f");
+					gen_mov(pz, dst, t, pn_);
+				L("@@");
+				}
+				return;
+			}
+			src = dst;
+			ns = f.nt;
+			bits = f.nextBits;
+		}
+	}
+	/*
+		x mod p = sum_i pos[i] - sum_i neg[i] for x[0..nw) in 32-bit words
+		each term is wn words of x given by their indices(-1 means zero)
+	*/
+	struct SolinasTerm {
+		int wn;
+		int posN;
+		int negN;
+		std::vector<int> pos; // pos[i * wn + j] : j-th word of the i-th term
+		std::vector<int> neg;
+	};
+	/*
+		substitute 2^k = c repeatedly into 2^(32 j) for j >= wn
+		then the coefficient of each word is small for a Solinas prime
+	*/
+	void getSolinasTerm(SolinasTerm& st, int nw) const
+	{
+		const int wn = form_.k / 32;
+		int d[fp::maxSolinasWordN];
+		fp::getSolinasDigit(d, p_, pn_, form_.k);
+		// co[j * wn + i] : coefficient of 2^(32 i) in 2^(32 j) mod p
+		std::vector<int> co(nw * wn);
+		for (int j = 0; j < nw; j++) {
+			if (j < wn) {
+				co[j * wn + j] = 1;
+				continue;
+			}
+			for (int e = 0; e < wn; e++) {
+				if (d[e] == 0) continue;
+				const int src = (j - wn + e) * wn;
+				for (int i = 0; i < wn; i++) {
+					co[j * wn + i] += d[e] * co[src + i];
+				}
+			}
+		}
+		std::vector<std::vector<int> > posL(wn), negL(wn);
+		for (int j = 0; j < nw; j++) {
+			for (int i = 0; i < wn; i++) {
+				const int c = co[j * wn + i];
+				std::vector<int>& v = c > 0 ? posL[i] : negL[i];
+				for (int k = 0; k < std::abs(c); k++) v.push_back(j);
+			}
+		}
+		st.wn = wn;
+		st.posN = 0;
+		st.negN = 0;
+		for (int i = 0; i < wn; i++) {
+			st.posN = std::max(st.posN, (int)posL[i].size());
+			st.negN = std::max(st.negN, (int)negL[i].size());
+		}
+		st.pos.assign(st.posN * wn, -1);
+		st.neg.assign(st.negN * wn, -1);
+		for (int i = 0; i < wn; i++) {
+			for (size_t j = 0; j < posL[i].size(); j++) st.pos[j * wn + i] = posL[i][j];
+			for (size_t j = 0; j < negL[i].size(); j++) st.neg[j * wn + i] = negL[i][j];
+		}
+	}
+	/*
+		check whether the reduction of 2pn_ limbs is bounded and set solTbl_
+		v = sum pos - sum neg satisfies -solM_ 2^k <= v < solP_ 2^k
+		then v - h' p is in [0, 2p) for h = v >> k if (solP_ + 1) c < 2^k and solM_ c < p
+	*/
+	bool initSolinas()
+	{
+		const int k = form_.k;
+		int d[fp::maxSolinasWordN];
+		if (pn_ > fp::maxSolinasPn || !fp::getSolinasDigit(d, p_, pn_, k)) return false;
+		int top = k / 32 - 1;
+		while (top > 0 && d[top] == 0) top--;
+		SolinasTerm st;
+		getSolinasTerm(st, pn_ * 4);
+		solP_ = st.posN;
+		solM_ = st.negN;
+		if (solP_ == 0 || solP_ + solM_ > maxSolTermN) return false;
+		// c < 2^(32 top + 1) and p >= 2^(k - 1)
+		if (getBitLen64(std::max(solP_ + 1, solM_)) + 32 * top + 2 > k) return false;
+		const int n = pn_ + 1;
+		for (int h = -solM_; h < solP_; h++) {
+			uint64_t *q = solTbl_ + (h + solM_) * n;
+			const uint64_t a = h >= 0 ? h : 1 - h; // |h'|
+			uint64_t H = 0;
+			for (int i = 0; i < pn_; i++) {
+				const uint64_t lo = (p_[i] & 0xffffffff) * a + H;
+				const uint64_t hi = (p_[i] >> 32) * a + (lo >> 32);
+				q[i] = (hi << 32) | (lo & 0xffffffff);
+				H = hi >> 32;
+			}
+			q[pn_] = H;
+			if (h >= 0) {
+				// negate
+				uint64_t borrow = 0;
+				for (int i = 0; i < n; i++) {
+					const uint64_t v = q[i];
+					q[i] = 0 - v - borrow;
+					borrow = (v | borrow) != 0;
+				}
+			}
+		}
+		return true;
+	}
+	/*
+		input (pz[], px[], py[]) or (pz[], px[]) if isSqr
+		z[] <- x[] * y[] mod p for a Solinas prime
+	*/
+	void gen_mulSolinas(bool isSqr)
+	{
+		assert(2 <= pn_ && pn_ <= fp::maxSolinasPn);
+		const int n = pn_;
+		const int stackSize = (n - 1 + n * 2 + (isSqr ? n * 2 : n) + n) * 8;
+		StackFrame sf(this, isSqr ? 2 : 3, 10 | UseRDX, stackSize);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& y = sf.t[0];
+		const Reg64& t = sf.t[1];
+		Pack remain = sf.t.sub(2);
+		size_t rspPos = 0;
+
+		MixPack wk(remain, rspPos, n - 1);
+		const RegExp pw = rsp + rspPos; // pw[0..2n-1] or pw[0..n-1]
+		const RegExp pc = pw + (isSqr ? n * 2 : n) * 8; // pc[0..2n-1]
+		const RegExp ps = pc + n * 2 * 8;
+		if (isSqr) {
+			gen_raw_sqrPre(pc, px, pw, y, t, wk, n);
+		} else {
+			gen_raw_mulPre(pc, px, sf.p[2], pw, y, t, wk, n);
+		}
+		// x[] < 2^k and y[] < 2^k, so pc[] has 2k / 32 words
+		gen_raw_redSolinas(pz, pc, form_.k / 16, ps, sf.t.sub(0, n), sf.t[n], sf.t[n + 1], sf.t[n + 2]);
+	}
+	/*
+		input (pz[], pxy[])
+		z[] <- xy[0..2n-1] mod p for a Solinas prime
+	*/
+	void gen_redSolinas()
+	{
+		const int n = pn_;
+		StackFrame sf(this, 2, (n + 3) | UseRDX, n * 8);
+		gen_raw_redSolinas(sf.p[0], sf.p[1], n * 4, rsp, sf.t.sub(0, n), sf.t[n], sf.t[n + 1], sf.t[n + 2]);
+	}
+	/*
+		pz[0..pn_-1] <- px[0..nw) mod p where px[] is read as 32-bit words
+		use ps[0..pn_-1] as work area
+		destroy rax, rdx, z, top, t, pAddr
+	*/
+	void gen_raw_redSolinas(const RegExp& pz, const RegExp& px, int nw, const RegExp& ps, const Pack& z, const Reg64& top, const Reg64& t, const Reg64& pAddr)
+	{
+		const int n = pn_;
+		SolinasTerm st;
+		getSolinasTerm(st, nw);
+		const int wn = st.wn;
+		assert(st.posN <= solP_ && st.negN <= solM_);
+		// z:top = sum_i pos[i] - sum_i neg[i]
+		for (int j = 0; j < st.posN + st.negN; j++) {
+			const bool isPos = j < st.posN;
+			const int *w = isPos ? &st.pos[j * wn] : &st.neg[(j - st.posN) * wn];
+			// limbs which are not in px[] as they are
+			for (int i = 0; i < n; i++) {
+				const int a = w[i * 2];
+				const int b = i * 2 + 1 < wn ? w[i * 2 + 1] : -1;
+				if (b < 0 || b == a + 1) continue;
+				mov(eax, dword [px + b * 4]);
+				shl(rax, 32);
+				if (a >= 0) {
+					mov(edx, dword [px + a * 4]);
+					or_(rax, rdx);
+				}
+				mov(ptr [ps + i * 8], rax);
+			}
+			for (int i = 0; i < n; i++) {
+				const int a = w[i * 2];
+				const int b = i * 2 + 1 < wn ? w[i * 2 + 1] : -1;
+				const Reg64& r = j == 0 ? z[i] : rax;
+				// mov does not change CF
+				if (b >= 0 && b == a + 1) {
+					mov(r, ptr [px + a * 4]);
+				} else if (b >= 0) {
+					mov(r, ptr [ps + i * 8]);
+				} else if (a >= 0) {
+					mov(r.cvt32(), dword [px + a * 4]);
+				} else {
+					mov(r.cvt32(), 0);
+				}
+				if (j == 0) continue;
+				if (isPos) {
+					if (i == 0) {
+						add(z[i], rax);
+					} else {
+						adc(z[i], rax);
+					}
+				} else {
+					if (i == 0) {
+						sub(z[i], rax);
+					} else {
+						sbb(z[i], rax);
+					}
+				}
+			}
+			if (j == 0) {
+				mov(top, 0);
+			} else if (isPos) {
+				adc(top, 0);
+			} else {
+				sbb(top, 0);
+			}
+		}
+		// z:top += solTbl_[h] for h = (z:top) >> k
+		if (form_.k % 64) {
+			mov(t, z[n - 1]);
+			shrd(t, top, 32);
+		} else {
+			mov(t, top);
+		}
+		imul(t, t, (n + 1) * 8);
+		mov(pAddr, (size_t)(solTbl_ + solM_ * (n + 1)));
+		add(pAddr, t);
+		for (int i = 0; i < n; i++) {
+			if (i == 0) {
+				add(z[i], ptr [pAddr]);
+			} else {
+				adc(z[i], ptr [pAddr + i * 8]);
+			}
+		}
+		adc(top, ptr [pAddr + n * 8]);
+		// z:top is in [0, 2p)
+		for (int i = 0; i < n; i++) {
+			mov(ptr [ps + i * 8], z[i]);
+		}
+		mov(pAddr, (size_t)p_);
+		for (int i = 0; i < n; i++) {
+			if (i == 0) {
+				sub(z[i], ptr [pAddr]);
+			} else {
+				sbb(z[i], ptr [pAddr + i * 8]);
+			}
+		}
+		sbb(top, 0);
+		for (int i = 0; i < n; i++) {
+			cmovc(z[i], ptr [ps + i * 8]);
+			mov(ptr [pz + i * 8], z[i]);
+		}
+	}
+	/*
+		tbl[0..n) = p 2^e
+	*/
+	void setShiftedP(uint64_t *tbl, int n, int e) const
+	{
+		const int q = e / 64;
+		const int r = e % 64;
+		for (int i = 0; i < n; i++) tbl[i] = 0;
+		for (int i = 0; i < pn_; i++) {
+			assert(q + i < n);
+			tbl[q + i] |= p_[i] << r;
+			if (r && q + i + 1 < n) tbl[q + i + 1] |= p_[i] >> (64 - r);
+		}
+	}
+	/*
+		input (pz[], px[], py[])
+		z[0..2n-1] <- x[] * y[] without reduction
+	*/
+	void gen_mulPre()
+	{
+		assert(2 <= pn_ && pn_ <= 9);
+		const int n = pn_;
+		const int regNum = useMulx_ ? 3 : 2 + std::min(n - 1, 8);
+		const int stackSize = (n * 2 - 1) * 8;
+		StackFrame sf(this, 3, regNum | UseRDX, stackSize);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		const Reg64& y = sf.t[0];
+		const Reg64& t = sf.t[1];
+		Pack remain = sf.t.sub(2);
+		size_t rspPos = 0;
+
+		MixPack wk(remain, rspPos, n - 1);
+		const RegExp pw = rsp + rspPos; // pw[0..n-1]
+		gen_raw_mulPre(pz, px, py, pw, y, t, wk, n);
+	}
+	/*
+		input (pz[], px[])
+		z[0..2n-1] <- x[]^2 without reduction
+	*/
+	void gen_sqrPre()
+	{
+		assert(2 <= pn_ && pn_ <= 9);
+		const int n = pn_;
+		const int regNum = useMulx_ ? 3 : 2 + std::min(n - 1, 8);
+		const int stackSize = (n - 1 + n * 2) * 8;
+		StackFrame sf(this, 2, regNum | UseRDX, stackSize);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& y = sf.t[0];
+		const Reg64& t = sf.t[1];
+		Pack remain = sf.t.sub(2);
+		size_t rspPos = 0;
+
+		MixPack wk(remain, rspPos, n - 1);
+		const RegExp pw = rsp + rspPos; // pw[0..2n-1]
+		gen_raw_sqrPre(pz, px, pw, y, t, wk, n);
+	}
+	/*
+		input (pz[], pxy[])
+		z[] <- xy[0..2n-1] / R mod p for xy[] < p R
+	*/
+	void gen_montRed()
+	{
+		assert(2 <= pn_ && pn_ <= 9);
+		const int n = pn_;
+		const int regNum = useMulx_ ? 5 : 4 + std::min(n - 1, 6);
+		const int stackSize = (n - 1 + n * 3) * 8;
+		StackFrame sf(this, 2, regNum | UseRDX, stackSize);
+		const Reg64& pz = sf.p[0];
+		const Reg64& pxy = sf.p[1];
+		const Reg64& q = sf.t[0];
+		const Reg64& pAddr = sf.t[1];
+		const Reg64& t = sf.t[2];
+		const Reg64& c = sf.t[3];
+		Pack remain = sf.t.sub(4);
+		size_t rspPos = 0;
+
+		MixPack wk(remain, rspPos, n - 1);
+		const RegExp pw = rsp + rspPos; // pw[0..n-1]
+		const RegExp pc = pw + n * 8; // pc[0..2n-1]
+		mov(pAddr, (size_t)p_);
+		// gen_raw_montRed destroys pc[]
+		gen_mov(pc, pxy, t, n * 2);
+		gen_raw_montRed(pz, pc, pAddr, pw, pp_, q, c, t, wk, n);
+	}
+	/*
+		pz[0..2n-1] <- px[0..n-1] * py[0..n-1]
+		use pw[0..n-1] as work area
+		@note pz must not be px or py
+	*/
+	void gen_raw_mulPre(const RegExp& pz, const RegExp& px, const RegExp& py, const RegExp& pw, const Reg64& y, const Reg64& t, const MixPack& wk, int n)
+	{
+		mov(y, ptr [py]);
+		gen_raw_mulI(pz, px, y, wk, t, n);
+		mov(ptr [pz + n * 8], rdx);
+		for (int i = 1; i < n; i++) {
+			mov(y, ptr [py + i * 8]);
+			gen_raw_mulI(pw, px, y, wk, t, n);
+			// [rdx:pw[0..n-1]] = x[] * y[i] is added to pz[i..i+n]
+			mov(t, ptr [pw]);
+			add(ptr [pz + i * 8], t);
+			for (int k = 1; k < n; k++) {
+				mov(t, ptr [pw + k * 8]);
+				adc(ptr [pz + (i + k) * 8], t);
+			}
+			adc(rdx, 0);
+			mov(ptr [pz + (i + n) * 8], rdx);
+		}
+	}
+	/*
+		input (pz[], px[])
+		z[] <- montgomery(x[], x[])
+	*/
+	void gen_montSqrN(const uint64_t *p, uint64_t pp, int n)
+	{
+		assert(2 <= pn_ && pn_ <= 9);
+		const int regNum = useMulx_ ? 5 : 4 + std::min(n - 1, 7);
+		const int stackSize = (n - 1 + n * 4) * 8;
+		StackFrame sf(this, 2, regNum | UseRDX, stackSize);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& y = sf.t[0];
+		const Reg64& pAddr = sf.t[1];
+		const Reg64& t = sf.t[2];
+		const Reg64& c = sf.t[3];
+		Pack remain = sf.t.sub(4);
+		size_t rspPos = 0;
+
+		MixPack wk(remain, rspPos, n - 1);
+		const RegExp pw = rsp + rspPos; // pw[0..2n-1]
+		const RegExp pc = pw + n * 2 * 8; // pc[0..2n-1]
+		mov(pAddr, (size_t)p);
+
+		gen_raw_sqrPre(pc, px, pw, y, t, wk, n);
+		gen_raw_montRed(pz, pc, pAddr, pw, pp, y, c, t, wk, n);
+	}
+	/*
+		pz[0..2n-1] <- px[0..n-1]^2
+		use pw[0..2n-1] as work area
+		compute the cross products x[i] x[j] (i < j) once and double them
+		@note pz must not be px
+	*/
+	void gen_raw_sqrPre(const RegExp& pz, const RegExp& px, const RegExp& pw, const Reg64& y, const Reg64& t, const MixPack& wk, int n)
+	{
+		// [pz[2n-2]:...:pz[1]] = sum_{i < j} x[i] x[j] 2^(64(i + j - 1))
+		// the i-th row x[i] * x[i + 1..n - 1] is added to pz[2i + 1..n + i]
+		for (int i = 0; i < n - 1; i++) {
+			const int m = n - 1 - i;
+			const RegExp dst = i == 0 ? pz + 8 : pw;
+			mov(y, ptr [px + i * 8]);
+			if (m == 1) {
+				mov(rax, ptr [px + (i + 1) * 8]);
+				mul(y);
+				mov(ptr [dst], rax);
+			} else {
+				gen_raw_mulI(dst, px + (i + 1) * 8, y, wk, t, m);
+			}
+			// [rdx:dst[0..m-1]] = x[i + 1..n - 1] * x[i]
+			if (i == 0) {
+				mov(ptr [pz + n * 8], rdx);
+				continue;
+			}
+			for (int k = 0; k < m; k++) {
+				mov(t, ptr [pw + k * 8]);
+				if (k == 0) {
+					add(ptr [pz + (i * 2 + 1 + k) * 8], t);
+				} else {
+					adc(ptr [pz + (i * 2 + 1 + k) * 8], t);
+				}
+			}
+			adc(rdx, 0);
+			mov(ptr [pz + (n + i) * 8], rdx);
+		}
+		// pz[1..2n-1] = pz[1..2n-2] * 2
+		mov(t, ptr [pz + 8]);
+		add(t, t);
+		mov(ptr [pz + 8], t);
+		for (int k = 2; k < n * 2 - 1; k++) {
+			mov(t, ptr [pz + k * 8]);
+			adc(t, t);
+			mov(ptr [pz + k * 8], t);
+		}
+		mov(t, 0);
+		adc(t, 0);
+		mov(ptr [pz + (n * 2 - 1) * 8], t);
+		// pw[] = x[i]^2
+		for (int i = 0; i < n; i++) {
+			mov(rax, ptr [px + i * 8]);
+			mul(rax);
+			mov(ptr [pw + i * 16], rax);
+			mov(ptr [pw + i * 16 + 8], rdx);
+		}
+		mov(t, ptr [pw]);
+		mov(ptr [pz], t);
+		mov(t, ptr [pw + 8]);
+		add(ptr [pz + 8], t);
+		for (int k = 2; k < n * 2; k++) {
+			mov(t, ptr [pw + k * 8]);
+			adc(ptr [pz + k * 8], t);
+		}
+	}
+	/*
+		pz[0..n-1] <- pc[0..2n-1] / R mod p
+		pc[] < p R
+		use pw[0..n-1] as work area
+		destroy pc[], q, c, t
+	*/
+	void gen_raw_montRed(const RegExp& pz, const RegExp& pc, const Reg64& pAddr, const RegExp& pw, uint64_t pp, const Reg64& q, const Reg64& c, const Reg64& t, const MixPack& wk, int n)
+	{
+		for (int i = 0; i < n; i++) {
+			mov(rax, pp);
+			mul(qword [pc + i * 8]);
+			mov(q, rax); // q = pc[i] * pp
+			gen_raw_mulI(pw, pAddr, q, wk, t, n);
+			// [c:pc[i..i+n]] = pc[i..i+n] + [rdx:pw[0..n-1]] + (c << 64n)
+			if (i > 0) add(rdx, c); // never overflow because rdx < 2^64 - 1
+			mov(t, ptr [pw]);
+			add(ptr [pc + i * 8], t);
+			for (int k = 1; k < n; k++) {
+				mov(t, ptr [pw + k * 8]);
+				adc(ptr [pc + (i + k) * 8], t);
+			}
+			adc(ptr [pc + (i + n) * 8], rdx);
+			mov(c, 0);
+			adc(c, 0);
+		}
+		// pz[] = [c:pc[n..2n-1]] - p
+		gen_raw_sub(pz, pc + n * 8, pAddr, t);
+		sbb(c, 0);
+		jnc("@f");
+		for (int i = 0; i < n; i++) {
+			mov(t, ptr [pc + (n + i) * 8]);
+			mov(ptr [pz + i * 8], t);
+		}
+	L("@@");
+	}
+	/*
+		pz[0..n-1] = px[0..n-1] + py[0..n-1] (isAdd = true)
+		pz[0..n-1] = px[0..n-1] - py[0..n-1] (isAdd = false)
+		with a loop; CF is the carry(borrow) at the end
+		destroy j, t
+	*/
+	void gen_raw_addSubLoop(const RegExp& pz, const RegExp& px, const RegExp& py, const Reg64& j, const Reg64& t, int n, bool isAdd)
+	{
+		inLocalLabel();
+		mov(t, ptr [px]);
+		if (isAdd) {
+			add(t, ptr [py]);
+		} else {
+			sub(t, ptr [py]);
+		}
+		mov(ptr [pz], t);
+		// j = -(n - 1), ..., -1 ; inc does not change CF
+		mov(j, -(n - 1));
+	L(".lp");
+		mov(t, ptr [px + j * 8 + n * 8]);
+		if (isAdd) {
+			adc(t, ptr [py + j * 8 + n * 8]);
+		} else {
+			sbb(t, ptr [py + j * 8 + n * 8]);
+		}
+		mov(ptr [pz + j * 8 + n * 8], t);
+		inc(j);
+		jnz(".lp");
+		outLocalLabel();
+	}
+	/*
+		pz[0..n-1] = px[0..n-1] with a loop
+		destroy j, t
+	*/
+	void gen_movLoop(const RegExp& pz, const RegExp& px, const Reg64& j, const Reg64& t, int n)
+	{
+		inLocalLabel();
+		mov(j, -n);
+	L(".lp");
+		mov(t, ptr [px + j * 8 + n * 8]);
+		mov(ptr [pz + j * 8 + n * 8], t);
+		inc(j);
+		jnz(".lp");
+		outLocalLabel();
+	}
+	/*
+		pz[] = [c:px[]] - p if [c:px[]] >= p else px[]
+		destroy c, j, t
+	*/
+	void gen_condSubLoop(const RegExp& pz, const RegExp& px, const Reg64& pAddr, const Reg64& c, const Reg64& j, const Reg64& t, int n)
+	{
+		inLocalLabel();
+		gen_raw_addSubLoop(pz, px, pAddr, j, t, n, false);
+		sbb(c, 0);
+		jnc(".exit");
+		gen_movLoop(pz, px, j, t, n);
+	L(".exit");
+		outLocalLabel();
+	}
+	void gen_addModLarge()
+	{
+		const int n = pn_;
+		StackFrame sf(this, 3, 2, n * 8);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		const Reg64& j = sf.t[0];
+		const Reg64& t = sf.t[1];
+
+		inLocalLabel();
+		gen_raw_addSubLoop(pz, px, py, j, t, n, true);
+		mov(py, 0); // py = carry
+		adc(py, 0);
+		mov(px, (size_t)p_);
+		gen_raw_addSubLoop(rsp, pz, px, j, t, n, false);
+		sbb(py, 0);
+		jc(".exit");
+		gen_movLoop(pz, rsp, j, t, n);
+	L(".exit");
+		outLocalLabel();
+	}
+	void gen_subLarge()
+	{
+		const int n = pn_;
+		StackFrame sf(this, 3, 2);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		const Reg64& j = sf.t[0];
+		const Reg64& t = sf.t[1];
+
+		inLocalLabel();
+		gen_raw_addSubLoop(pz, px, py, j, t, n, false);
+		jnc(".exit");
+		mov(px, (size_t)p_);
+		gen_raw_addSubLoop(pz, pz, px, j, t, n, true);
+	L(".exit");
+		outLocalLabel();
+	}
+	void gen_negLarge()
+	{
+		const int n = pn_;
+		StackFrame sf(this, 2, 3);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& j = sf.t[0];
+		const Reg64& t = sf.t[1];
+		const Reg64& pAddr = sf.t[2];
+
+		inLocalLabel();
+		mov(t, ptr [px]);
+		mov(j, -(n - 1));
+	L(".lp");
+		or_(t, ptr [px + j * 8 + n * 8]);
+		inc(j);
+		jnz(".lp");
+		test(t, t);
+		jnz(".neg");
+		// zero
+		mov(j, -n);
+	L(".zero");
+		mov(ptr [pz + j * 8 + n * 8], t);
+		inc(j);
+		jnz(".zero");
+		jmp(".exit");
+	L(".neg");
+		mov(pAddr, (size_t)p_);
+		gen_raw_addSubLoop(pz, pAddr, px, j, t, n, false);
+	L(".exit");
+		outLocalLabel();
+	}
+	/*
+		input (pz[], px[], py[])
+		z[] <- montgomery(x[], y[]) for pn_ > maxUnrollPn
+		CIOS method ; the inner loop computes c += x * y[i] + p * q at once
+	*/
+	void gen_montMulLarge()
+	{
+		const int n = pn_;
+		StackFrame sf(this, 3, 8 | UseRDX, (n + 1) * 8);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		const Reg64& pAddr = sf.t[0];
+		const Reg64& i = sf.t[1];
+		const Reg64& j = sf.t[2];
+		const Reg64& y = sf.t[3];
+		const Reg64& q = sf.t[4];
+		const Reg64& cx = sf.t[5]; // carry of x * y[i]
+		const Reg64& cp = sf.t[6]; // carry of p * q
+		const Reg64& t = sf.t[7];
+		const RegExp pc = rsp; // pc[0..n]
+
+		inLocalLabel();
+		mov(pAddr, (size_t)p_);
+		xor_(eax, eax);
+		mov(j, -(n + 1));
+	L(".clear");
+		mov(ptr [pc + j * 8 + (n + 1) * 8], rax);
+		inc(j);
+		jnz(".clear");
+
+		xor_(i, i);
+	L(".lpi");
+		mov(y, ptr [py + i * 8]);
+		mov(rax, ptr [px]);
+		mul(y);
+		add(rax, ptr [pc]);
+		adc(rdx, 0);
+		mov(t, rax);
+		mov(cx, rdx);
+		mov(rax, pp_);
+		mul(t);
+		mov(q, rax); // q = c[0] * pp
+		mov(rax, ptr [pAddr]);
+		mul(q);
+		add(rax, t); // rax = 0
+		adc(rdx, 0);
+		mov(cp, rdx);
+		mov(j, 1);
+	L(".lpj");
+		// t = c[j] + x[j] * y + cx
+		mov(rax, ptr [px + j * 8]);
+		mul(y);
+		add(rax, cx);
+		adc(rdx, 0);
+		add(rax, ptr [pc + j * 8]);
+		adc(rdx, 0);
+		mov(cx, rdx);
+		mov(t, rax);
+		// c[j - 1] = t + p[j] * q + cp
+		mov(rax, ptr [pAddr + j * 8]);
+		mul(q);
+		add(rax, cp);
+		adc(rdx, 0);
+		add(rax, t);
+		adc(rdx, 0);
+		mov(cp, rdx);
+		mov(ptr [pc + j * 8 - 8], rax);
+		inc(j);
+		cmp(j, n);
+		jne(".lpj");
+		// [c[n]:c[n-1]] = c[n] + cx + cp
+		mov(t, 0);
+		add(cx, cp);
+		adc(t, 0);
+		add(cx, ptr [pc + n * 8]);
+		adc(t, 0);
+		mov(ptr [pc + (n - 1) * 8], cx);
+		mov(ptr [pc + n * 8], t);
+		inc(i);
+		cmp(i, n);
+		jne(".lpi");
+
+		mov(t, ptr [pc + n * 8]);
+		gen_condSubLoop(pz, pc, pAddr, t, j, rax, n);
+		outLocalLabel();
+	}
+	/*
+		input (pz[], px[])
+		z[] <- montgomery(x[], x[]) for pn_ > maxUnrollPn
+		x^2 = sum_i x[i]^2 + 2 sum_{i < j} x[i] x[j] followed by the reduction
+	*/
+	void gen_montSqrLarge()
+	{
+		const int n = pn_;
+		StackFrame sf(this, 2, 8 | UseRDX, n * 2 * 8);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& pAddr = sf.t[0];
+		const Reg64& i = sf.t[1];
+		const Reg64& j = sf.t[2];
+		const Reg64& y = sf.t[3];
+		const Reg64& cy = sf.t[4]; // carry in the inner loop
+		const Reg64& c = sf.t[5];
+		const Reg64& pr = sf.t[6]; // pointer to pc[i] or pc[2i]
+		const Reg64& t = sf.t[7];
+		const RegExp pc = rsp; // pc[0..2n-1]
+
+		inLocalLabel();
+		mov(pAddr, (size_t)p_);
+		xor_(eax, eax);
+		mov(j, -n * 2);
+	L(".clear");
+		mov(ptr [pc + j * 8 + n * 2 * 8], rax);
+		inc(j);
+		jnz(".clear");
+
+		// pc[] = sum_{i < j} x[i] x[j] 2^(64(i + j))
+		xor_(i, i);
+		mov(pr, rsp);
+	L(".cross_i");
+		mov(y, ptr [px + i * 8]);
+		xor_(cy, cy);
+		lea(j, ptr [i + 1]);
+	L(".cross_j");
+		mov(rax, ptr [px + j * 8]);
+		mul(y);
+		add(rax, cy);
+		adc(rdx, 0);
+		add(ptr [pr + j * 8], rax);
+		adc(rdx, 0);
+		mov(cy, rdx);
+		inc(j);
+		cmp(j, n);
+		jne(".cross_j");
+		mov(ptr [pr + n * 8], cy);
+		add(pr, 8);
+		inc(i);
+		cmp(i, n - 1);
+		jne(".cross_i");
+
+		// pc[] *= 2
+		mov(t, ptr [pc]);
+		add(t, t);
+		mov(ptr [pc], t);
+		mov(j, -(n * 2 - 1));
+	L(".twice");
+		mov(t, ptr [pc + j * 8 + n * 2 * 8]);
+		adc(t, t);
+		mov(ptr [pc + j * 8 + n * 2 * 8], t);
+		inc(j);
+		jnz(".twice");
+
+		// pc[] += sum_i x[i]^2 2^(128 i)
+		xor_(c, c);
+		xor_(i, i);
+		mov(pr, rsp);
+	L(".diag");
+		mov(rax, ptr [px + i * 8]);
+		mul(rax);
+		add(rax, c);
+		adc(rdx, 0);
+		add(ptr [pr], rax);
+		adc(ptr [pr + 8], rdx);
+		mov(c, 0);
+		adc(c, 0);
+		add(pr, 16);
+		inc(i);
+		cmp(i, n);
+		jne(".diag");
+
+		// Montgomery reduction of pc[0..2n-1]
+		xor_(c, c);
+		xor_(i, i);
+		mov(pr, rsp);
+	L(".red_i");
+		mov(rax, pp_);
+		mul(qword [pr]);
+		mov(y, rax); // y = q
+		xor_(cy, cy);
+		xor_(j, j);
+	L(".red_j");
+		mov(rax, ptr [pAddr + j * 8]);
+		mul(y);
+		add(rax, cy);
+		adc(rdx, 0);
+		add(ptr [pr + j * 8], rax);
+		adc(rdx, 0);
+		mov(cy, rdx);
+		inc(j);
+		cmp(j, n);
+		jne(".red_j");
+		// [c:pc[i + n]] = pc[i + n] + cy + c
+		mov(t, c);
+		mov(c, 0);
+		add(t, cy);
+		adc(c, 0);
+		add(ptr [pr + n * 8], t);
+		adc(c, 0);
+		add(pr, 8);
+		inc(i);
+		cmp(i, n);
+		jne(".red_i");
+
+		gen_condSubLoop(pz, pc + n * 8, pAddr, c, j, t, n);
+		outLocalLabel();
+	}
+	/*
+		input (pz[], px[], py[])
+		z[k] <- montgomery(x[k], y[k]) for k = 0, ..., 7
+		R = 2^(52 * n52_)
+		x[], y[], z[] are uint64_t[n52_ * 8] in radix 2^52 SoA form;
+		the j-th digit of the k-th element is at [j * 8 + k]
+		0 <= x[k], y[k] < p, 0 <= z[k] < p
+		@note z may be equal to x or y
+		use zmm0-5, zmm16-31 because zmm6-15 are callee-saved on Win64
+	*/
+	void gen_mul8()
+	{
+		const int n = n52_;
+		StackFrame sf(this, 3, 1);
+		const Reg64& pz = sf.p[0];
+		const Reg64& px = sf.p[1];
+		const Reg64& py = sf.p[2];
+		const Reg64& tbl = sf.t[0];
+		const RegExp pp = tbl + n * 8;
+		const RegExp mask = tbl + (n + 1) * 8;
+
+		std::vector<Xbyak::Zmm> zs;
+		for (int i = 0; i < 6; i++) zs.push_back(Xbyak::Zmm(i));
+		for (int i = 16; i < 32; i++) zs.push_back(Xbyak::Zmm(i));
+		assert((int)zs.size() >= n + 3);
+		// t[0..n] : accumulator
+		std::vector<Xbyak::Zmm> t(zs.begin(), zs.begin() + n + 1);
+		const Xbyak::Zmm& y = zs[n + 1];
+		const Xbyak::Zmm& q = zs[n + 2];
+
+		mov(tbl, (size_t)ifmaTbl_);
+		for (int j = 0; j <= n; j++) {
+			vpxorq(t[j], t[j], t[j]);
+		}
+		for (int i = 0; i < n; i++) {
+			// t += x * y[i]
+			vmovdqu64(y, ptr [py + i * 64]);
+			for (int j = 0; j < n; j++) {
+				vpmadd52luq(t[j], y, ptr [px + j * 64]);
+				vpmadd52huq(t[j + 1], y, ptr [px + j * 64]);
+			}
+			// q = t[0] * pp mod 2^52
+			vpxorq(q, q, q);
+			vpmadd52luq(q, t[0], ptr_b [pp]);
+			// t += p * q
+			for (int j = 0; j < n; j++) {
+				vpmadd52luq(t[j], q, ptr_b [tbl + j * 8]);
+				vpmadd52huq(t[j + 1], q, ptr_b [tbl + j * 8]);
+			}
+			// t >>= 52 ; the lower 52 bits of t[0] are zero
+			vpsrlq(q, t[0], 52);
+			vpaddq(t[1], t[1], q);
+			vpxorq(t[0], t[0], t[0]);
+			std::rotate(t.begin(), t.begin() + 1, t.end());
+		}
+		// normalize t ; t[n - 1] may have 53 bits because t < 2p
+		for (int j = 0; j < n - 1; j++) {
+			vpsrlq(q, t[j], 52);
+			vpandq(t[j], t[j], ptr_b [mask]);
+			vpaddq(t[j + 1], t[j + 1], q);
+		}
+		// y = borrow of t - p
+		vpxorq(y, y, y);
+		for (int j = 0; j < n; j++) {
+			vpsubq(q, t[j], ptr_b [tbl + j * 8]);
+			vpsubq(q, q, y);
+			vpsrlq(y, q, 63);
+		}
+		// t -= p for lanes with t >= p
+		vptestnmq(k1, y, y);
+		vpxorq(y, y, y);
+		for (int j = 0; j < n; j++) {
+			vpsubq(t[j] | k1, t[j], ptr_b [tbl + j * 8]);
+			vpsubq(t[j] | k1, t[j], y);
+			if (j < n - 1) {
+				vpsrlq(y, t[j], 63);
+				vpandq(t[j], t[j], ptr_b [mask]);
+			}
+			vmovdqu64(ptr [pz + j * 64], t[j]);
+		}
+		vzeroupper();
+	}
 	/*
 		input (z, x, y) = (p0, p1, p2)
 		z[0..3] <- montgomery(x[0..3], y[0..3])
@@ -1179,6 +2631,89 @@ struct FpGenerator : Xbyak::CodeGenerator {
 	L("@@");
 		outLocalLabel();
 	}
+	/*
+		int64_t delta = divsteps62(delta, f, g, t)
+		apply 62 divsteps to the low 64 bits of (delta, f, g) without branch
+		and set the transition matrix t[] = { u, v, q, r } such that
+		(f', g') * 2^62 = (u f + v g, q f + r g)
+		one step is
+		if (delta > 0 && g is odd) (delta, f, g) = (1 - delta, g, (g - f) / 2)
+		else if (g is odd) (delta, f, g) = (1 + delta, f, (g + f) / 2)
+		else (delta, f, g) = (1 + delta, f, g / 2)
+		|u| + |v| <= 2^62, |q| + |r| <= 2^62
+	*/
+	void gen_divsteps62()
+	{
+		StackFrame sf(this, 4, 7);
+		const Reg64& delta = sf.p[0];
+		const Reg64& f = sf.p[1];
+		const Reg64& g = sf.p[2];
+		const Reg64& pt = sf.p[3];
+		const Reg64& u = sf.t[0];
+		const Reg64& v = sf.t[1];
+		const Reg64& q = sf.t[2];
+		const Reg64& r = sf.t[3];
+		const Reg64& m = sf.t[4];
+		const Reg64& odd = sf.t[5];
+		const Reg64& c = sf.t[6];
+		const Reg64& x = rax;
+		mov(u, 1);
+		xor_(v, v);
+		xor_(q, q);
+		mov(r, 1);
+		mov(c, 62);
+		align(16);
+	L("@@");
+		// odd = (g & 1) ? -1 : 0, m = (delta > 0) ? odd : 0
+		mov(m, delta);
+		neg(m);
+		sar(m, 63);
+		mov(odd, g);
+		and_(odd, 1);
+		neg(odd);
+		and_(m, odd);
+		// (f, g) = (g, -f) if m
+		gen_condSwapNeg(f, g, m, x);
+		gen_condSwapNeg(u, q, m, x);
+		gen_condSwapNeg(v, r, m, x);
+		xor_(delta, m);
+		sub(delta, m);
+		// g += f if odd
+		mov(x, f);
+		and_(x, odd);
+		add(g, x);
+		mov(x, u);
+		and_(x, odd);
+		add(q, x);
+		mov(x, v);
+		and_(x, odd);
+		add(r, x);
+		inc(delta);
+		shr(g, 1);
+		add(u, u);
+		add(v, v);
+		dec(c);
+		jnz("@b");
+		mov(ptr [pt], u);
+		mov(ptr [pt + 8], v);
+		mov(ptr [pt + 16], q);
+		mov(ptr [pt + 24], r);
+		mov(rax, delta);
+	}
+	/*
+		(x, y) = (y, -x) if m = -1
+		(x, y) = (x, y) if m = 0
+	*/
+	void gen_condSwapNeg(const Reg64& x, const Reg64& y, const Reg64& m, const Reg64& t)
+	{
+		mov(t, x);
+		xor_(t, y);
+		and_(t, m);
+		xor_(x, t);
+		xor_(y, t);
+		xor_(y, m);
+		sub(y, m);
+	}
 	void mov32c(const Reg64& r, uint64_t c)
 	{
 		if (c & 0xffffffff00000000ULL) {
@@ -1672,6 +3207,63 @@ private:
 	}
 };
 
+/*
+	process-wide cache of FpGenerator shared by FpBase and MontFpT
+	keyed by (p, form of p, CPU features used by the kernels)
+	the code of all the cached generators is in one CodePool
+	thread safe
+*/
+class FpGeneratorCache {
+	typedef std::map<std::vector<uint64_t>, FpGenerator*> Map;
+	cybozu::Mutex m_;
+	Map map_;
+	fp_gen_local::CodePool pool_;
+	static FpGeneratorCache& getInstance()
+	{
+		static FpGeneratorCache cache;
+		return cache;
+	}
+	FpGeneratorCache() {}
+	FpGeneratorCache(const FpGeneratorCache&);
+	void operator=(const FpGeneratorCache&);
+public:
+	/*
+		get the generator initialized by init(p, pn, form)
+		it is generated at the first call for the key
+		the returned one must not be re-initialized and lives until the process exits
+	*/
+	static const FpGenerator *get(const uint64_t *p, int pn, const fp::PrimeForm& form = fp::PrimeForm())
+	{
+		std::vector<uint64_t> key(p, p + pn);
+		key.push_back(form.type);
+		key.push_back(form.k);
+		key.push_back(form.c);
+		key.push_back(FpGenerator::getCpuFeature(Xbyak::util::Cpu()));
+		FpGeneratorCache& self = getInstance();
+		cybozu::AutoLock al(self.m_);
+		Map::const_iterator i = self.map_.find(key);
+		if (i != self.map_.end()) return i->second;
+		if (pn < 2 || pn > FpGenerator::maxLargePn) throw cybozu::Exception("mie:FpGeneratorCache:bad pn") << pn;
+		/*
+			fg is not deleted even if init throws
+			because its code buffer may share a page with another generator
+		*/
+		FpGenerator *fg = new FpGenerator(&self.pool_);
+		fg->init(p, pn, form);
+		self.pool_.shrink(fg->getCode(), fg->getSize());
+		self.map_[key] = fg;
+		return fg;
+	}
+	// number of cached generators
+	static size_t size()
+	{
+		FpGeneratorCache& self = getInstance();
+		cybozu::AutoLock al(self.m_);
+		return self.map_.size();
+	}
+};
+
+
 } // mie
 
 #endif
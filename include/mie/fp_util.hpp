@@ -289,6 +289,90 @@ void concatBitVec(cybozu::BitVectorT<T>& bv, const Vec& v, size_t width, size_t
 	bv.append(v[v.size() - 1], lastWidth);
 }
 
+/*
+	write x[0..n) to buf[0..byteSize) in big endian
+	x[] must be less than 2^(byteSize * 8)
+*/
+template<class S>
+void toBigEndian(uint8_t *buf, size_t byteSize, const S *x, size_t n)
+{
+	for (size_t i = 0; i < byteSize; i++) {
+		const size_t pos = byteSize - 1 - i;
+		const size_t q = pos / sizeof(S);
+		buf[i] = q < n ? uint8_t(x[q] >> ((pos % sizeof(S)) * 8)) : 0;
+	}
+}
+
+/*
+	read x[0..n) from buf[0..byteSize) in big endian
+	throw if the value does not fit in x[0..n)
+*/
+template<class S>
+void fromBigEndian(S *x, size_t n, const uint8_t *buf, size_t byteSize)
+{
+	for (size_t i = 0; i < n; i++) x[i] = 0;
+	for (size_t i = 0; i < byteSize; i++) {
+		const size_t pos = byteSize - 1 - i;
+		const size_t q = pos / sizeof(S);
+		if (q < n) {
+			x[q] |= S(buf[i]) << ((pos % sizeof(S)) * 8);
+		} else if (buf[i]) {
+			throw cybozu::Exception("fp:fromBigEndian:large value") << i << byteSize << n;
+		}
+	}
+}
+
+/*
+	y[i] = 1 / x[i] for i = 0, ..., n - 1 (Montgomery's trick)
+	one inv and 3(n - 1) mul
+	y[i] = 0 if x[i] = 0
+	y may be equal to x
+	F must have mul, inv, isZero and clear
+*/
+template<class F>
+void invVec(F *y, const F *x, size_t n)
+{
+	if (n == 0) return;
+	std::vector<F> tmp;
+	F *pre = y; // pre[i] = product of non-zero x[0..i]
+	if (y == x) {
+		tmp.resize(n);
+		pre = &tmp[0];
+	}
+	size_t first = n; // position of the first non-zero x[i]
+	F acc;
+	for (size_t i = 0; i < n; i++) {
+		if (!x[i].isZero()) {
+			if (first == n) {
+				acc = x[i];
+				first = i;
+			} else {
+				F::mul(acc, acc, x[i]);
+			}
+		}
+		if (first < n) pre[i] = acc;
+	}
+	if (first == n) {
+		for (size_t i = 0; i < n; i++) y[i].clear();
+		return;
+	}
+	F::inv(acc, acc);
+	for (size_t i = n - 1; i > first; i--) {
+		if (x[i].isZero()) {
+			y[i].clear();
+			continue;
+		}
+		F t;
+		F::mul(t, acc, pre[i - 1]);
+		F::mul(acc, acc, x[i]);
+		y[i] = t;
+	}
+	y[first] = acc;
+	for (size_t i = 0; i < first; i++) {
+		y[i].clear();
+	}
+}
+
 } // mie::fp
 
 } // fp
@@ -126,6 +126,10 @@ struct Gmp {
 	{
 		return mpz_sgn(z.get_mpz_t()) == 0;
 	}
+	static inline bool isOne(const mpz_class& z)
+	{
+		return mpz_cmp_ui(z.get_mpz_t(), 1) == 0;
+	}
 	static inline bool isNegative(const mpz_class& z)
 	{
 		return mpz_sgn(z.get_mpz_t()) < 0;
@@ -279,6 +283,81 @@ class SquareRoot {
 	int r;
 	mpz_class q; // p - 1 = 2^r q
 	mpz_class s; // s = g^q
+	std::vector<mpz_class> sTbl; // sTbl[i] = s^(2^i) for i < r
+	mpz_class ex; // (p + 1) / 4 if r == 1 else (q - 1) / 2
+	int w; // window size for ex
+	std::vector<int> eDigit; // sliding window digits of ex
+	/*
+		z = x^ex by the precomputed digits
+		about bitLen(ex) squares and bitLen(ex) / (w + 1) multiplications
+	*/
+	template<class F>
+	void powE(F& z, const F& x) const
+	{
+		const size_t tblN = size_t(1) << (w - 1);
+		std::vector<F> tbl(tblN);
+		tbl[0] = x;
+		F x2;
+		F::square(x2, x);
+		for (size_t i = 1; i < tblN; i++) {
+			F::mul(tbl[i], tbl[i - 1], x2);
+		}
+		size_t i = eDigit.size() - 1;
+		F t = tbl[eDigit[i] >> 1];
+		while (i > 0) {
+			i--;
+			F::square(t, t);
+			if (eDigit[i]) F::mul(t, t, tbl[eDigit[i] >> 1]);
+		}
+		z = t;
+	}
+	/*
+		x = m for F of fp.hpp
+	*/
+	template<class F>
+	static void setMpz(F& x, const mpz_class& m)
+	{
+		x.setRaw(Gmp::getBlock(m), Gmp::getBlockSize(m));
+	}
+	// for MontFpT
+	template<size_t N, class tag, template<size_t _N, class _tag>class F>
+	static void setMpz(F<N, tag>& x, const mpz_class& m)
+	{
+		F<N, tag>::toMont(x, m);
+	}
+	// for FpT of fp2.hpp
+	template<class tag, size_t maxBitN, template<class _tag, size_t _maxBitN>class F>
+	static void setMpz(F<tag, maxBitN>& x, const mpz_class& m)
+	{
+		x.fromGmp(m);
+	}
+	/*
+		eDigit[i] = odd d if e = ... + d 2^i + ... (left to right sliding window)
+	*/
+	void initDigit(const mpz_class& e)
+	{
+		const int bitLen = (int)Gmp::getBitLen(e);
+		w = bitLen < 128 ? 4 : 5;
+		eDigit.assign(bitLen, 0);
+		int i = bitLen - 1;
+		while (i >= 0) {
+			if (!mpz_tstbit(e.get_mpz_t(), i)) {
+				i--;
+				continue;
+			}
+			int j = i - w + 1;
+			if (j < 0) j = 0;
+			while (!mpz_tstbit(e.get_mpz_t(), j)) j++;
+			int d = 0;
+			for (int k = i; k >= j; k--) {
+				d = d * 2 + mpz_tstbit(e.get_mpz_t(), k);
+			}
+			eDigit[j] = d;
+			i = j - 1;
+		}
+		// the top digit is the last element
+		while (eDigit.back() == 0) eDigit.pop_back();
+	}
 public:
 	SquareRoot() : isPrime(false) {}
 	void set(const mpz_class& p)
@@ -300,6 +379,17 @@ public:
 			q /= 2;
 		}
 		Gmp::powMod(s, g, q, p);
+		sTbl.resize(r);
+		sTbl[0] = s;
+		for (int i = 1; i < r; i++) {
+			sTbl[i] = (sTbl[i - 1] * sTbl[i - 1]) % p;
+		}
+		if (r == 1) {
+			ex = (p + 1) / 4;
+		} else {
+			ex = (q - 1) / 2;
+		}
+		initDigit(ex);
 	}
 	/*
 		solve x^2 = a mod p
@@ -309,13 +399,14 @@ public:
 		if (!isPrime) throw cybozu::Exception("SquareRoot:get:not prime") << p;
 		if (Gmp::legendre(a, p) < 0) return false;
 		if (r == 1) {
-			Gmp::powMod(x, a, (p + 1) / 4, p);
+			Gmp::powMod(x, a, ex, p);
 			return true;
 		}
-		mpz_class c = s, d;
-		int e = r;
-		Gmp::powMod(d, a, q, p);
-		Gmp::powMod(x, a, (q + 1) / 2, p); // destroy a if &x == &a
+		// t = a^((q - 1) / 2), y = a^((q + 1) / 2), d = a^q
+		mpz_class t, y, d;
+		Gmp::powMod(t, a, ex, p);
+		y = (t * a) % p;
+		d = (t * y) % p;
 		while (d != 1) {
 			int i = 1;
 			mpz_class dd = (d * d) % p;
@@ -323,14 +414,61 @@ public:
 				dd = (dd * dd) % p;
 				i++;
 			}
-			mpz_class b = 1;
-			b <<= e - i - 1;
-			Gmp::powMod(b, c, b, p);
-			x = (x * b) % p;
-			c = (b * b) % p;
-			d = (d * c) % p;
+			// y *= s^(2^(r - i - 1)), d *= s^(2^(r - i))
+			y = (y * sTbl[r - i - 1]) % p;
+			d = (d * sTbl[r - i]) % p;
+		}
+		x = y; // destroy a if &x == &a
+		return true;
+	}
+	/*
+		solve x^2 = a in F(FpT or MontFpT)
+		all operations are done in F without conversion to mpz_class
+		return false if a is not a square
+	*/
+	template<class F>
+	bool get(F& x, const F& a) const
+	{
+		if (!isPrime) throw cybozu::Exception("SquareRoot:get:not prime") << p;
+		if (a.isZero()) {
+			x = a;
+			return true;
+		}
+		F t;
+		powE(t, a);
+		if (r == 1) {
+			// t = a^((p + 1) / 4)
+			F t2;
+			F::square(t2, t);
+			if (t2 != a) return false;
+			x = t;
+			return true;
+		}
+		// t = a^((q - 1) / 2), y = a^((q + 1) / 2), d = a^q
+		const F one = 1;
+		F y, d;
+		F::mul(y, t, a);
+		F::mul(d, t, y);
+		int e = r;
+		while (d != one) {
+			// d^(2^i) = 1
+			int i = 1;
+			F dd;
+			F::square(dd, d);
+			while (dd != one) {
+				i++;
+				if (i == e) return false;
+				F::square(dd, dd);
+			}
+			// b = s^(2^(r - i - 1)), c = b^2
+			F b, c;
+			setMpz(b, sTbl[r - i - 1]);
+			F::mul(y, y, b);
+			F::square(c, b);
+			F::mul(d, d, c);
 			e = i;
 		}
+		x = y;
 		return true;
 	}
 };
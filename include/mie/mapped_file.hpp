@@ -0,0 +1,119 @@
+#pragma once
+/**
+	@file
+	@brief read only memory mapped file
+	@author MITSUNARI Shigeo(@herumi)
+	@license modified new BSD license
+	http://opensource.org/licenses/BSD-3-Clause
+*/
+#include <string>
+#include <cybozu/exception.hpp>
+#include <cybozu/inttype.hpp>
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace mie {
+
+/*
+	map a whole file to memory for reading
+	the pages are shared by all processes which map the same file
+	get() is aligned to a page
+*/
+class MappedFile {
+	const uint8_t *p_;
+	size_t size_;
+#ifdef _WIN32
+	HANDLE hFile_;
+	HANDLE hMap_;
+#endif
+	MappedFile(const MappedFile&);
+	void operator=(const MappedFile&);
+public:
+	MappedFile()
+		: p_(0), size_(0)
+#ifdef _WIN32
+		, hFile_(INVALID_HANDLE_VALUE), hMap_(NULL)
+#endif
+	{
+	}
+	explicit MappedFile(const std::string& path)
+		: p_(0), size_(0)
+#ifdef _WIN32
+		, hFile_(INVALID_HANDLE_VALUE), hMap_(NULL)
+#endif
+	{
+		open(path);
+	}
+	~MappedFile() { close(); }
+	void open(const std::string& path)
+	{
+		close();
+#ifdef _WIN32
+		hFile_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hFile_ == INVALID_HANDLE_VALUE) throw cybozu::Exception("MappedFile:open:can't open") << path;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(hFile_, &size)) {
+			close();
+			throw cybozu::Exception("MappedFile:open:can't get size") << path;
+		}
+		size_ = size_t(size.QuadPart);
+		if (size_ == 0) return;
+		hMap_ = CreateFileMappingA(hFile_, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (hMap_ == NULL) {
+			close();
+			throw cybozu::Exception("MappedFile:open:can't map") << path;
+		}
+		p_ = (const uint8_t*)MapViewOfFile(hMap_, FILE_MAP_READ, 0, 0, 0);
+		if (p_ == 0) {
+			close();
+			throw cybozu::Exception("MappedFile:open:can't map") << path;
+		}
+#else
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) throw cybozu::Exception("MappedFile:open:can't open") << path;
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			::close(fd);
+			throw cybozu::Exception("MappedFile:open:can't get size") << path;
+		}
+		size_ = size_t(st.st_size);
+		if (size_ > 0) {
+			void *p = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+			if (p == MAP_FAILED) {
+				::close(fd);
+				size_ = 0;
+				throw cybozu::Exception("MappedFile:open:can't map") << path;
+			}
+			p_ = (const uint8_t*)p;
+		}
+		::close(fd);
+#endif
+	}
+	void close()
+	{
+#ifdef _WIN32
+		if (p_) UnmapViewOfFile(p_);
+		if (hMap_ != NULL) CloseHandle(hMap_);
+		if (hFile_ != INVALID_HANDLE_VALUE) CloseHandle(hFile_);
+		hMap_ = NULL;
+		hFile_ = INVALID_HANDLE_VALUE;
+#else
+		if (p_) munmap(const_cast<uint8_t*>(p_), size_);
+#endif
+		p_ = 0;
+		size_ = 0;
+	}
+	const uint8_t *get() const { return p_; }
+	size_t size() const { return size_; }
+};
+
+} // mie
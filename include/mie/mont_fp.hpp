@@ -32,7 +32,8 @@ class MontFpT : public ope::addsub<MontFpT<N, tag>,
 	static MontFpT invTbl_[N * 64 * 2];
 	static size_t modBitLen_;
 public:
-	static FpGenerator fg_;
+	// shared through FpGeneratorCache
+	static const FpGenerator *fg_;
 private:
 	uint64_t v_[N];
 	void fromRawGmp(const mpz_class& x)
@@ -195,17 +196,17 @@ public:
 		R_.fromRawGmp(t);
 		t = (t * t) % pOrg_;
 		RR_.fromRawGmp(t);
-		fg_.init(p_.v_, N);
-		add = Xbyak::CastTo<void3op>(fg_.add_);
-		sub = Xbyak::CastTo<void3op>(fg_.sub_);
-		mul = Xbyak::CastTo<void3op>(fg_.mul_);
-		square = Xbyak::CastTo<void2op>(fg_.sqr_);
+		fg_ = FpGeneratorCache::get(p_.v_, N);
+		add = Xbyak::CastTo<void3op>(fg_->add_);
+		sub = Xbyak::CastTo<void3op>(fg_->sub_);
+		mul = Xbyak::CastTo<void3op>(fg_->mul_);
+		square = Xbyak::CastTo<void2op>(fg_->sqr_);
 		if (square == 0) square = squareC;
-		neg = Xbyak::CastTo<void2op>(fg_.neg_);
-		shr1 = Xbyak::CastTo<void2op>(fg_.shr1_);
-		addNc = Xbyak::CastTo<bool3op>(fg_.addNc_);
-		subNc = Xbyak::CastTo<bool3op>(fg_.subNc_);
-		preInv = Xbyak::CastTo<int2op>(fg_.preInv_);
+		neg = Xbyak::CastTo<void2op>(fg_->neg_);
+		shr1 = Xbyak::CastTo<void2op>(fg_->shr1_);
+		addNc = Xbyak::CastTo<bool3op>(fg_->addNc_);
+		subNc = Xbyak::CastTo<bool3op>(fg_->subNc_);
+		preInv = Xbyak::CastTo<int2op>(fg_->preInv_);
 		initInvTbl(invTbl_);
 	}
 	static inline void getModulo(std::string& pstr)
@@ -224,11 +225,7 @@ public:
 	}
 	static inline bool squareRoot(MontFpT& y, const MontFpT& x)
 	{
-		mpz_class t;
-		fromMont(t, x);
-		if (!sq_.get(t, t)) return false;
-		toMont(y, t);
-		return true;
+		return sq_.get(y, x);
 	}
 	static inline void fromMont(mpz_class& z, const MontFpT& x)
 	{
@@ -331,6 +328,11 @@ public:
 		toMont(z, t);
 #endif
 	}
+	/*
+		y[i] = 1 / x[i] for i = 0, ..., n - 1 with one inv
+		y[i] = 0 if x[i] = 0 ; y may be equal to x
+	*/
+	static inline void invVec(MontFpT *y, const MontFpT *x, size_t n) { fp::invVec(y, x, n); }
 	static inline void div(MontFpT& z, const MontFpT& x, const MontFpT& y)
 	{
 		MontFpT ry;
@@ -384,6 +386,39 @@ public:
 		}
 	}
 	static inline size_t getBitVecSize() { return modBitLen_; }
+	/*
+		size of big endian fixed width representation
+	*/
+	static inline size_t getByteSize() { return (modBitLen_ + 7) / 8; }
+	/*
+		write getByteSize() bytes to buf in big endian
+		return getByteSize()
+	*/
+	size_t serialize(void *buf, size_t bufSize) const
+	{
+		const size_t n = getByteSize();
+		if (bufSize < n) throw cybozu::Exception("MontFpT:serialize:small buf") << bufSize << n;
+		MontFpT t;
+		mul(t, *this, one_);
+		fp::toBigEndian((uint8_t*)buf, n, t.v_, N);
+		return n;
+	}
+	/*
+		read getByteSize() bytes written by serialize
+		return getByteSize()
+	*/
+	size_t deserialize(const void *buf, size_t bufSize)
+	{
+		const size_t n = getByteSize();
+		if (bufSize < n) throw cybozu::Exception("MontFpT:deserialize:small buf") << bufSize << n;
+		MontFpT t;
+		fp::fromBigEndian(t.v_, N, (const uint8_t*)buf, n);
+		if (compare(t, p_) >= 0) {
+			throw cybozu::Exception("MontFpT:deserialize:large x") << n;
+		}
+		mul(*this, t, RR_);
+		return n;
+	}
 	static inline int compare(const MontFpT& x, const MontFpT& y)
 	{
 		return fp::compareArray(x.v_, y.v_, N);
@@ -398,6 +433,8 @@ public:
 		return r == 0;
 	}
 	bool isZero() const { return isZero(*this); }
+	// R_ is 1 in Montgomery form
+	bool isOne() const { return fp::compareArray(v_, R_.v_, N) == 0; }
 	template<class Z>
 	static void power(MontFpT& z, const MontFpT& x, const Z& y)
 	{
@@ -434,7 +471,7 @@ template<size_t N, class tag>MontFpT<N, tag> MontFpT<N, tag>::one_;
 template<size_t N, class tag>MontFpT<N, tag> MontFpT<N, tag>::R_;
 template<size_t N, class tag>MontFpT<N, tag> MontFpT<N, tag>::RR_;
 template<size_t N, class tag>MontFpT<N, tag> MontFpT<N, tag>::invTbl_[N * 64 * 2];
-template<size_t N, class tag>FpGenerator MontFpT<N, tag>::fg_;
+template<size_t N, class tag>const FpGenerator *MontFpT<N, tag>::fg_;
 template<size_t N, class tag>size_t MontFpT<N, tag>::modBitLen_;
 
 template<size_t N, class tag>typename MontFpT<N, tag>::void3op MontFpT<N, tag>::add;
@@ -20,6 +20,13 @@
 		#define MIE_FORCE_INLINE __attribute__((always_inline))
 	#endif
 #endif
+#ifndef MIE_THREAD_LOCAL
+	#ifdef _MSC_VER
+		#define MIE_THREAD_LOCAL __declspec(thread)
+	#else
+		#define MIE_THREAD_LOCAL __thread
+	#endif
+#endif
 #ifdef __APPLE__
 	#define MIE_DONT_DEFINE_HASH
 #endif
@@ -8,11 +8,131 @@
 */
 #include <fstream>
 #include <vector>
+#include <map>
+#include <cybozu/mutex.hpp>
 #include <mie/gmp_util.hpp>
+#include <mie/fp2.hpp>
 #include <cybozu/random_generator.hpp>
 
+/*
+	max bit length of n^2 computed by FpNN
+	Gmp is used for a larger n^2
+*/
+#ifndef MIE_PAILLIER_MAX_BIT_N
+	#define MIE_PAILLIER_MAX_BIT_N MIE_FP_LARGE_MAX_BIT_N
+#endif
+
 namespace mie { namespace paillier {
 
+namespace local {
+
+struct TagNN;
+/*
+	Montgomery arithmetic modulo n^2 with the JIT kernels of FpGenerator
+	a key binds its FieldCtxNN to the current thread while it computes,
+	so keys may be used by threads at the same time
+*/
+typedef mie::FpT<TagNN, MIE_PAILLIER_MAX_BIT_N> FpNN;
+typedef mie::FieldCtxT<TagNN, MIE_PAILLIER_MAX_BIT_N> FieldCtxNN;
+
+inline void setNN(FpNN& y, const mpz_class& x, const mpz_class& nn)
+{
+	if (x < 0 || x >= nn) {
+		mpz_class t;
+		mpz_mod(t.get_mpz_t(), x.get_mpz_t(), nn.get_mpz_t());
+		y.fromGmp(t);
+	} else {
+		y.fromGmp(x);
+	}
+}
+
+/*
+	FieldCtxNN shared by the keys with the same n^2
+	a process-wide table keyed by n^2 holds one context with a reference count,
+	and the last SharedCtxNN of n^2 deletes it
+	thread safe
+*/
+class SharedCtxNN {
+	struct Entry {
+		FieldCtxNN ctx;
+		std::string key; // n^2 in hex
+		size_t refN;
+		explicit Entry(const std::string& key) : ctx(key, true, 16), key(key), refN(1) {}
+	};
+	typedef std::map<std::string, Entry*> Map;
+	struct Tbl {
+		cybozu::Mutex m;
+		Map map;
+	};
+	// never deleted because a static key may release its context after exit
+	static Tbl& getTbl()
+	{
+		static Tbl *tbl = new Tbl();
+		return *tbl;
+	}
+	Entry *e_;
+	void acquire(Entry *e)
+	{
+		if (e) {
+			Tbl& tbl = getTbl();
+			cybozu::AutoLock al(tbl.m);
+			e->refN++;
+		}
+		e_ = e;
+	}
+public:
+	SharedCtxNN() : e_(0) {}
+	SharedCtxNN(const SharedCtxNN& rhs) : e_(0) { acquire(rhs.e_); }
+	SharedCtxNN& operator=(const SharedCtxNN& rhs)
+	{
+		if (e_ != rhs.e_) {
+			clear();
+			acquire(rhs.e_);
+		}
+		return *this;
+	}
+	~SharedCtxNN() { clear(); }
+	void clear()
+	{
+		if (e_ == 0) return;
+		Tbl& tbl = getTbl();
+		cybozu::AutoLock al(tbl.m);
+		if (--e_->refN == 0) {
+			tbl.map.erase(e_->key);
+			delete e_;
+		}
+		e_ = 0;
+	}
+	// share the context modulo nn with the other keys
+	void set(const mpz_class& nn)
+	{
+		clear();
+		const std::string key = nn.get_str(16);
+		Tbl& tbl = getTbl();
+		cybozu::AutoLock al(tbl.m);
+		Map::iterator i = tbl.map.find(key);
+		if (i != tbl.map.end()) {
+			i->second->refN++;
+			e_ = i->second;
+			return;
+		}
+		Entry *e = new Entry(key);
+		tbl.map[key] = e;
+		e_ = e;
+	}
+	// 0 if not set
+	const FieldCtxNN *get() const { return e_ ? &e_->ctx : 0; }
+	// number of the contexts in the table
+	static size_t size()
+	{
+		Tbl& tbl = getTbl();
+		cybozu::AutoLock al(tbl.m);
+		return tbl.map.size();
+	}
+};
+
+} // mie::paillier::local
+
 template<class T>
 struct LoadSave {
 	void load(const std::string& fileName)
@@ -29,20 +149,71 @@ struct LoadSave {
 	}
 };
 
+class PublicKey;
+class PrivateKey;
+
+/*
+	ciphertext c modulo n^2 in the internal form of its key
+	v_ = c R mod n^2 for R of the Montgomery form of FpNN,
+	so add and mul of PublicKey do not convert it
+	v_ = c if n^2 is too large for FpNN
+	use it only with the key that made it(see PublicKey::toGmp and fromGmp)
+*/
+class CipherText {
+	mpz_class v_;
+	friend class PublicKey;
+	friend class PrivateKey;
+public:
+	bool operator==(const CipherText& rhs) const { return v_ == rhs.v_; }
+	bool operator!=(const CipherText& rhs) const { return !operator==(rhs); }
+};
+
 class PublicKey : public LoadSave<PublicKey> {
 	mpz_class n;
 	size_t nLen;
 	mpz_class nn; // n^2
 	mpz_class g; // n + 1
+	local::SharedCtxNN ctx_; // context of FpNN modulo n^2(not set if n^2 is too large)
 	// call finish after setting n
 	void finish()
 	{
 		nLen = Gmp::getBitLen(n);
 		nn = n * n;
 		g = n + 1;
+		ctx_.clear();
+		if (nn > 1 && Gmp::getBitLen(nn) <= MIE_PAILLIER_MAX_BIT_N) {
+			ctx_.set(nn);
+		}
+	}
+	// y = x in the internal form without conversion
+	static void getNN(local::FpNN& y, const CipherText& x)
+	{
+		y.setUnit(Gmp::getBlock(x.v_), Gmp::getBlockSize(x.v_));
+	}
+	static void setNN(CipherText& y, const local::FpNN& x)
+	{
+		Gmp::setRaw(y.v_, x.getUnit(), x.getUnitN());
+	}
+	// z = x^y for the internal form
+	void powNN(CipherText& z, const CipherText& x, const mpz_class& y) const
+	{
+		const local::FieldCtxNN *ctx = ctx_.get();
+		if (ctx == 0 || y < 0) {
+			mpz_class t;
+			toGmp(t, x);
+			Gmp::powMod(t, t, y, nn);
+			fromGmp(z, t);
+			return;
+		}
+		local::FieldCtxNN::Scope scope(*ctx);
+		local::FpNN a;
+		getNN(a, x);
+		local::FpNN::power(a, a, y);
+		setNN(z, a);
 	}
 	friend class PrivateKey;
 public:
+	PublicKey() : nLen(0) {}
 	const mpz_class& getN() const { return n; }
 	friend inline std::istream& operator>>(std::istream& is, PublicKey& self)
 	{
@@ -60,28 +231,131 @@ public:
 		y = x - 1;
 		y /= n;
 	}
+	/*
+		y = x mod n^2 in the internal form
+	*/
+	void fromGmp(CipherText& y, const mpz_class& x) const
+	{
+		const local::FieldCtxNN *ctx = ctx_.get();
+		if (ctx == 0) {
+			mpz_mod(y.v_.get_mpz_t(), x.get_mpz_t(), nn.get_mpz_t());
+			return;
+		}
+		local::FieldCtxNN::Scope scope(*ctx);
+		local::FpNN a;
+		local::setNN(a, x, nn);
+		setNN(y, a);
+	}
+	/*
+		y = x as an integer in [0, n^2)
+	*/
+	void toGmp(mpz_class& y, const CipherText& x) const
+	{
+		const local::FieldCtxNN *ctx = ctx_.get();
+		if (ctx == 0) {
+			y = x.v_;
+			return;
+		}
+		local::FieldCtxNN::Scope scope(*ctx);
+		local::FpNN a;
+		getNN(a, x);
+		a.toGmp(y);
+	}
 	void mul(mpz_class& z, const mpz_class& x, const mpz_class &y) const
 	{
-		z = x * y;
-		z %= nn;
+		const local::FieldCtxNN *ctx = ctx_.get();
+		if (ctx == 0) {
+			z = x * y;
+			z %= nn;
+			return;
+		}
+		local::FieldCtxNN::Scope scope(*ctx);
+		local::FpNN a, b;
+		local::setNN(a, x, nn);
+		local::setNN(b, y, nn);
+		a *= b;
+		a.toGmp(z);
 	}
+	/*
+		z = x^y mod n^2 (y >= 0)
+	*/
 	void pow(mpz_class& z, const mpz_class& x, const mpz_class& y) const
 	{
-		Gmp::powMod(z, x, y, nn);
+		const local::FieldCtxNN *ctx = ctx_.get();
+		if (ctx == 0 || y < 0) {
+			Gmp::powMod(z, x, y, nn);
+			return;
+		}
+		local::FieldCtxNN::Scope scope(*ctx);
+		local::FpNN a;
+		local::setNN(a, x, nn);
+		local::FpNN::power(a, a, y);
+		a.toGmp(z);
+	}
+	/*
+		z = x y mod n^2
+		dec(z) = dec(x) + dec(y) mod n
+	*/
+	void add(CipherText& z, const CipherText& x, const CipherText& y) const
+	{
+		const local::FieldCtxNN *ctx = ctx_.get();
+		if (ctx == 0) {
+			z.v_ = x.v_ * y.v_;
+			z.v_ %= nn;
+			return;
+		}
+		local::FieldCtxNN::Scope scope(*ctx);
+		local::FpNN a, b;
+		getNN(a, x);
+		getNN(b, y);
+		a *= b;
+		setNN(z, a);
+	}
+	/*
+		z = x^y mod n^2 (y >= 0)
+		dec(z) = y dec(x) mod n
+	*/
+	void mul(CipherText& z, const CipherText& x, const mpz_class& y) const
+	{
+		powNN(z, x, y);
 	}
 	/*
 		encMsg = (g^msg) (r^n) mod n^2
 	*/
 	template<class RG>
-	void enc(mpz_class& encMsg, const mpz_class& msg, RG& rg) const
+	void enc(CipherText& encMsg, const mpz_class& msg, RG& rg) const
 	{
 		if (msg >= n) throw cybozu::Exception("too large msg");
 		mpz_class r;
 		Gmp::getRand(r, nLen * 2 - 2, rg);
-		Gmp::powMod(r, r, n, nn);
-
-		Gmp::powMod(encMsg, g, msg, nn);
-		mul(encMsg, encMsg, r);
+		// g^msg = (1 + n)^msg = 1 + msg n mod n^2
+		const mpz_class gm = msg * n + 1;
+		const local::FieldCtxNN *ctx = ctx_.get();
+		if (ctx == 0) {
+			Gmp::powMod(r, r, n, nn);
+			encMsg.v_ = gm * r;
+			encMsg.v_ %= nn;
+			return;
+		}
+		local::FieldCtxNN::Scope scope(*ctx);
+		local::FpNN a, b;
+		local::setNN(a, r, nn);
+		local::FpNN::power(a, a, n);
+		local::setNN(b, gm, nn);
+		a *= b;
+		setNN(encMsg, a);
+	}
+	void enc(CipherText& encMsg, const mpz_class& msg) const
+	{
+		cybozu::RandomGenerator rg;
+		enc(encMsg, msg, rg);
+	}
+	template<class RG>
+	void enc(mpz_class& encMsg, const mpz_class& msg, RG& rg) const
+	{
+		CipherText c;
+		enc(c, msg, rg);
+		toGmp(encMsg, c);
 	}
 	void enc(mpz_class& encMsg, const mpz_class& msg) const
 	{
@@ -109,20 +383,25 @@ class PrivateKey : public LoadSave<PrivateKey> {
 		pub.finish();
 		Gmp::lcm(lambda, p - 1, q - 1);
 		// x = (n + 1)^lambda mod n^2
-		Gmp::powMod(x, pub.g, lambda, pub.nn);
+		pub.pow(x, pub.g, lambda);
 		pub.L(x, x);
 		// 1 / L() mod n
 		Gmp::invMod(x, x, pub.n);
 	}
+	// decMsg = L(t) / L(g^lambda mod n^2) mod n for t = encMsg^lambda mod n^2
+	void decSub(mpz_class& decMsg, const mpz_class& t) const
+	{
+		pub.L(decMsg, t);
+		decMsg *= x;
+		decMsg %= pub.n;
+	}
 public:
 	template<class RG>
 	void init(size_t keyLen, RG& rg)
 	{
 		Gmp::getRandPrime(p, (keyLen + 1) / 2, rg, true);
 		Gmp::getRandPrime(q, (keyLen + 1) / 2, rg, true);
-		pub.n = p * q;
 		finish();
-		pub.finish();
 	}
 	void init(size_t keyLen)
 	{
@@ -146,10 +425,17 @@ public:
 	*/
 	void dec(mpz_class& decMsg, const mpz_class& encMsg) const
 	{
-		Gmp::powMod(decMsg, encMsg, lambda, pub.nn);
-		pub.L(decMsg, decMsg);
-		decMsg *= x;
-		decMsg %= pub.n;
+		mpz_class t;
+		pub.pow(t, encMsg, lambda);
+		decSub(decMsg, t);
+	}
+	void dec(mpz_class& decMsg, const CipherText& encMsg) const
+	{
+		CipherText c;
+		pub.powNN(c, encMsg, lambda);
+		mpz_class t;
+		pub.toGmp(t, c);
+		decSub(decMsg, t);
 	}
 	bool operator==(const PrivateKey& rhs) const
 	{
@@ -159,4 +445,3 @@ public:
 };
 
 } } // mie::paillier
-
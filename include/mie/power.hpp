@@ -157,6 +157,19 @@ void powerArray(G& z, const G& x, const BlockType *y, size_t n)
 	z = out;
 }
 
+/*
+	z = x^y for y = y[n - 1] ... y[0] > 0
+	specialize it for G which has a faster method(see EcT)
+*/
+template<class G>
+struct TagPower {
+	template<class BlockType>
+	static void powerArray(G& z, const G& x, const BlockType *y, size_t n)
+	{
+		power_impl::powerArray(z, x, y, n);
+	}
+};
+
 template<class G, class F>
 void power(G& z, const G& x, const F& _y)
 {
@@ -172,7 +185,7 @@ void power(G& z, const G& x, const F& _y)
 	}
 	bool isNegative = _y < 0;
 	const F& y = isNegative ? -_y : _y;
-	powerArray(z, x, TagI::getBlock(y), TagI::getBlockSize(y));
+	TagPower<G>::powerArray(z, x, TagI::getBlock(y), TagI::getBlockSize(y));
 	if (isNegative) {
 		TagG::inv(z, z);
 	}
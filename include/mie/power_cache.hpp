@@ -0,0 +1,251 @@
+#pragma once
+/**
+	@file
+	@brief LRU cache of w-NAF tables of points
+	@author MITSUNARI Shigeo(@herumi)
+	@license modified new BSD license
+	http://opensource.org/licenses/BSD-3-Clause
+*/
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <cybozu/mutex.hpp>
+#include <mie/ec.hpp>
+
+namespace mie {
+
+/*
+	cache of the tables tbl[i] = (2i + 1)Q for i < 2^(w-2) in affine coordinates
+	for points Q which are used again and again such as public keys of signers
+	a hit costs copying the table instead of tblN additions and one inversion
+
+	the key is x || y of Fp::serialize of normalized Q
+	the least recently used tables are evicted while the size exceeds maxByteSize
+	where the size of a table is (2 tblN + 2) Fp::getByteSize()
+	(the key and the coordinates without the overhead of containers and Fp)
+
+	all methods may be called by threads at the same time
+	a lookup holds the lock only to find and copy the table
+	and a miss makes the table without the lock
+	maxByteSize and w are fixed at construction
+	call clear after changing the curve
+*/
+template<class _Fp>
+class PowerCacheT {
+public:
+	typedef _Fp Fp;
+	typedef EcT<Fp> Ec;
+	// a digit of w-NAF must fit in signed char
+	static const int maxW = 8;
+	static const size_t defaultMaxByteSize = size_t(8) << 20;
+private:
+	struct Entry {
+		std::string key;
+		std::vector<Fp> x, y;
+	};
+	typedef std::list<Entry> List;
+	typedef std::map<std::string, typename List::iterator> Map;
+	List list_; // the most recently used one is the front
+	Map map_;
+	const size_t maxByteSize_;
+	size_t byteSize_;
+	const int w_;
+	size_t hitN_;
+	size_t missN_;
+	mutable cybozu::Mutex m_;
+	PowerCacheT(const PowerCacheT&);
+	void operator=(const PowerCacheT&);
+	size_t getEntryByteSize() const
+	{
+		return (getTableSize() * 2 + 2) * Fp::getByteSize();
+	}
+	static inline void getKey(std::string& key, const Ec& Q)
+	{
+		Ec T = Q;
+		T.normalize();
+		const size_t n = Fp::getByteSize();
+		key.resize(n * 2);
+		T.x.serialize(&key[0], n);
+		T.y.serialize(&key[n], n);
+	}
+	void evict()
+	{
+		while (byteSize_ > maxByteSize_ && !list_.empty()) {
+			map_.erase(list_.back().key);
+			list_.pop_back();
+			byteSize_ -= getEntryByteSize();
+		}
+	}
+public:
+	/*
+		maxByteSize : budget of the tables(0 disables the cache)
+		w : width of w-NAF(2 <= w <= maxW)
+	*/
+	explicit PowerCacheT(size_t maxByteSize = defaultMaxByteSize, int w = Ec::maxWnafWidth)
+		: maxByteSize_(maxByteSize), byteSize_(0), w_(w), hitN_(0), missN_(0)
+	{
+		if (w < 2 || w > maxW) throw cybozu::Exception("PowerCacheT:bad w") << w;
+	}
+	/*
+		x[i], y[i] = (2i + 1)Q in affine coordinates for i < tblN without the cache
+		return false if Q is zero or has a small order
+	*/
+	static inline bool makeTable(Fp *x, Fp *y, const Ec& Q, size_t tblN)
+	{
+		if (Q.isZero()) return false;
+		std::vector<Ec> T(tblN);
+		T[0] = Q;
+		Ec Q2;
+		Ec::dbl(Q2, Q);
+		for (size_t i = 1; i < tblN; i++) {
+			Ec::add(T[i], T[i - 1], Q2);
+			if (T[i].isZero()) return false;
+		}
+		Ec::getAffineVec(x, y, &T[0], tblN);
+		return true;
+	}
+	/*
+		x[i], y[i] = (2i + 1)Q in affine coordinates for i < getTableSize()
+		return false if Q is zero or has a small order
+	*/
+	bool getTable(Fp *x, Fp *y, const Ec& Q)
+	{
+		if (Q.isZero()) return false;
+		std::string key;
+		getKey(key, Q);
+		const size_t tblN = getTableSize();
+		{
+			cybozu::AutoLock al(m_);
+			typename Map::iterator i = map_.find(key);
+			if (i != map_.end()) {
+				hitN_++;
+				list_.splice(list_.begin(), list_, i->second);
+				const Entry& e = list_.front();
+				for (size_t j = 0; j < tblN; j++) {
+					x[j] = e.x[j];
+					y[j] = e.y[j];
+				}
+				return true;
+			}
+			missN_++;
+		}
+		if (!makeTable(x, y, Q, tblN)) return false;
+		cybozu::AutoLock al(m_);
+		if (getEntryByteSize() > maxByteSize_) return true;
+		typename Map::iterator i = map_.find(key);
+		if (i != map_.end()) {
+			// another thread has made it
+			list_.splice(list_.begin(), list_, i->second);
+			return true;
+		}
+		list_.push_front(Entry());
+		Entry& e = list_.front();
+		e.key = key;
+		e.x.assign(x, x + tblN);
+		e.y.assign(y, y + tblN);
+		map_[key] = list_.begin();
+		byteSize_ += getEntryByteSize();
+		evict();
+		return true;
+	}
+	/*
+		z = Q^k with the cached table of Q
+		use EcT::power if EcT::isConstTime() or Q has a small order
+	*/
+	template<class N>
+	void power(Ec& z, const Ec& Q, const N& k)
+	{
+		mpz_class y;
+		ec_local::toMpz(y, k);
+		powerMpz(z, Q, y);
+	}
+	void powerMpz(Ec& z, const Ec& Q, const mpz_class& k)
+	{
+		if (Ec::isConstTime()) {
+			Ec::power(z, Q, k);
+			return;
+		}
+		const typename Ec::Param& param = Ec::getParam();
+		const size_t tblN = getTableSize();
+		std::vector<Fp> x(tblN * 2), y(tblN * 2);
+		if (!getTable(&x[0], &y[0], Q)) {
+			Ec::power(z, Q, k);
+			return;
+		}
+		mpz_class kk[2];
+		size_t kN = 1;
+		bool isNeg[2] = {};
+		if (param.isGlv) {
+			mpz_class t;
+			mpz_mod(t.get_mpz_t(), k.get_mpz_t(), param.n.get_mpz_t());
+			Ec::splitGlv(kk[0], kk[1], t);
+			for (size_t i = 0; i < tblN; i++) {
+				Fp::mul(x[tblN + i], x[i], param.beta);
+				y[tblN + i] = y[i];
+			}
+			kN = 2;
+		} else {
+			kk[0] = k;
+		}
+		std::vector<signed char> naf[2];
+		size_t nafN = 0;
+		for (size_t j = 0; j < kN; j++) {
+			isNeg[j] = kk[j] < 0;
+			if (isNeg[j]) kk[j] = -kk[j];
+			ec_local::getNaf(naf[j], Gmp::getBlock(kk[j]), Gmp::getBlockSize(kk[j]), w_);
+			nafN = std::max(nafN, naf[j].size());
+		}
+		Fp t;
+		z.clear();
+		for (size_t pos = nafN; pos > 0;) {
+			pos--;
+			Ec::dbl(z, z);
+			for (size_t j = 0; j < kN; j++) {
+				if (pos >= naf[j].size()) continue;
+				const int d = naf[j][pos];
+				if (d == 0) continue;
+				const size_t idx = tblN * j + ((d > 0 ? d : -d) >> 1);
+				if ((d < 0) ^ isNeg[j]) {
+					Fp::neg(t, y[idx]);
+					Ec::addAffine(z, z, x[idx], t);
+				} else {
+					Ec::addAffine(z, z, x[idx], y[idx]);
+				}
+			}
+		}
+	}
+	void clear()
+	{
+		cybozu::AutoLock al(m_);
+		list_.clear();
+		map_.clear();
+		byteSize_ = 0;
+	}
+	int getWindowSize() const { return w_; }
+	size_t getTableSize() const { return size_t(1) << (w_ - 2); }
+	size_t getMaxByteSize() const { return maxByteSize_; }
+	size_t getByteSize() const
+	{
+		cybozu::AutoLock al(m_);
+		return byteSize_;
+	}
+	// number of cached tables
+	size_t size() const
+	{
+		cybozu::AutoLock al(m_);
+		return list_.size();
+	}
+	size_t getHitNum() const
+	{
+		cybozu::AutoLock al(m_);
+		return hitN_;
+	}
+	size_t getMissNum() const
+	{
+		cybozu::AutoLock al(m_);
+		return missN_;
+	}
+};
+
+} // mie
@@ -0,0 +1,279 @@
+#pragma once
+/**
+	@file
+	@brief Schnorr signature with batch verification
+	@author MITSUNARI Shigeo(@herumi)
+	@license modified new BSD license
+	http://opensource.org/licenses/BSD-3-Clause
+*/
+#include <string>
+#include <vector>
+#include <mie/ec.hpp>
+
+namespace mie {
+
+/*
+	Schnorr signature over EcT<_Fp> with the base point G of the prime order n
+	every point must have the order n(cofactor 1)
+	Zn must be set to modulo n
+	H : digest function with std::string operator()(const std::string& data) const
+	such as SHA-256
+
+	sign : R = kG, e = H(R || Q || m) mod n, s = k + e sec ; signature is (R, s)
+	the secret scalars k and sec are multiplied by EcT::powerCT regardless of EcT::isConstTime
+	verify : sG == R + eQ
+	R and Q in H are x || y of Fp::serialize
+
+	verifyBatch checks n signatures by a random linear combination
+	(sum_i a_i s_i)G - sum_i a_i R_i - sum_i (a_i e_i) Q_i == 0
+	with one EcT::mulVec of 2n + 1 points
+	where a_0 = 1 and a_i is a random batchBitLen bit integer for i > 0
+	a batch with a bad signature passes with probability about 2^-batchBitLen
+*/
+template<class _Fp, class _Zn, class H>
+class SchnorrT {
+public:
+	typedef _Fp Fp;
+	typedef _Zn Zn;
+	typedef EcT<Fp> Ec;
+	struct Signature {
+		Ec R;
+		Zn s;
+	};
+	static const size_t batchBitLen = 128;
+private:
+	Ec G_; // normalized
+	Ec phiG_; // phi(G) if GLV is enabled at init
+	bool hasPhi_;
+	mpz_class n_;
+	H hash_;
+	SchnorrT(const SchnorrT&);
+	void operator=(const SchnorrT&);
+	static inline void appendPoint(std::string& buf, const Ec& P)
+	{
+		Ec T = P;
+		T.normalize();
+		const size_t n = Fp::getByteSize();
+		const size_t pos = buf.size();
+		buf.resize(pos + n * 2);
+		T.x.serialize(&buf[pos], n);
+		T.y.serialize(&buf[pos + n], n);
+	}
+	// R = kG for a secret k by EcT::powerCT and R is normalized by EcT::normalizeCT
+	void mulSecret(Ec& R, const Zn& k) const
+	{
+		mpz_class t;
+		ec_local::toMpz(t, k);
+		Ec::powerCT(R, G_, Gmp::getBlock(t), Gmp::getBlockSize(t));
+		R.normalizeCT();
+	}
+	/*
+		e[i] = H(sig[i].R || Q[i] || msg[i]) mod n
+		return false if some sig[i] has zero R or zero s or Q[i] is zero
+	*/
+	bool getChallengeVec(Zn *e, const Signature *sig, const Ec *Q, const std::string *msg, size_t n) const
+	{
+		for (size_t i = 0; i < n; i++) {
+			if (sig[i].R.isZero() || sig[i].s.isZero() || Q[i].isZero()) return false;
+			getChallenge(e[i], sig[i].R, Q[i], msg[i]);
+		}
+		return true;
+	}
+	// verify sig[i] for i < n with e[i] made by getChallengeVec
+	template<class RG>
+	bool verifyBatchSub(const Signature *sig, const Ec *Q, const Zn *e, size_t n, RG& rg) const
+	{
+		if (n == 0) return true;
+		if (n == 1) return verifySub(sig[0], Q[0], e[0]);
+		std::vector<Ec> P(n * 2 + 1);
+		std::vector<mpz_class> k(n * 2 + 1);
+		mpz_class a = 1, s, ae, sum = 0;
+		const size_t aBitLen = std::min(batchBitLen, Gmp::getBitLen(n_) - 1);
+		for (size_t i = 0; i < n; i++) {
+			if (i > 0) Gmp::getRand(a, aBitLen, rg);
+			ec_local::toMpz(s, sig[i].s);
+			sum += a * s;
+			ec_local::toMpz(ae, e[i]);
+			ae *= a;
+			P[i * 2] = sig[i].R;
+			k[i * 2] = -a;
+			P[i * 2 + 1] = Q[i];
+			mpz_mod(k[i * 2 + 1].get_mpz_t(), ae.get_mpz_t(), n_.get_mpz_t());
+			k[i * 2 + 1] = -k[i * 2 + 1];
+		}
+		P[n * 2] = G_;
+		mpz_mod(k[n * 2].get_mpz_t(), sum.get_mpz_t(), n_.get_mpz_t());
+		Ec T;
+		Ec::mulVec(T, &P[0], &k[0], n * 2 + 1);
+		return T.isZero();
+	}
+	/*
+		sG - eQ == R
+		s and -e are split into halves with phi(G) and phi(Q) if GLV is enabled
+	*/
+	bool verifySub(const Signature& sig, const Ec& Q, const Zn& e) const
+	{
+		const typename Ec::Param& param = Ec::getParam();
+		Zn ne;
+		Zn::neg(ne, e);
+		Ec T;
+		if (hasPhi_ && param.isGlv) {
+			Ec Q2 = Q;
+			Q2.normalize();
+			const Ec P[] = {
+				G_, phiG_,
+				Q2, Ec(Q2.x * param.beta, Q2.y, false)
+			};
+			mpz_class k[4], t;
+			ec_local::toMpz(t, sig.s);
+			Ec::splitGlv(k[0], k[1], t);
+			ec_local::toMpz(t, ne);
+			Ec::splitGlv(k[2], k[3], t);
+			Ec::mulVec(T, P, k, 4);
+		} else {
+			const Ec P[] = { G_, Q };
+			const Zn k[] = { sig.s, ne };
+			Ec::mulVec(T, P, k, 2);
+		}
+		return T == sig.R;
+	}
+	// append the indices of bad signatures in [offset, offset + n) to bad
+	template<class RG>
+	void findBadSub(std::vector<size_t>& bad, const Signature *sig, const Ec *Q, const Zn *e, const char *isBad, size_t offset, size_t n, RG& rg) const
+	{
+		if (n == 0) return;
+		if (n == 1) {
+			if (isBad[offset] || !verifySub(sig[offset], Q[offset], e[offset])) bad.push_back(offset);
+			return;
+		}
+		bool hasBad = false;
+		for (size_t i = offset; i < offset + n; i++) {
+			if (isBad[i]) {
+				hasBad = true;
+				break;
+			}
+		}
+		if (!hasBad && verifyBatchSub(sig + offset, Q + offset, e + offset, n, rg)) return;
+		const size_t half = n / 2;
+		findBadSub(bad, sig, Q, e, isBad, offset, half, rg);
+		findBadSub(bad, sig, Q, e, isBad, offset + half, n - half, rg);
+	}
+public:
+	SchnorrT() : hasPhi_(false) {}
+	/*
+		G : base point
+		nStr : order of G
+		init must be called after setting Ec::setGlv to use GLV for verify
+	*/
+	SchnorrT(const Ec& G, const std::string& nStr, const H& hash = H())
+		: hasPhi_(false)
+	{
+		init(G, nStr, hash);
+	}
+	void init(const Ec& G, const std::string& nStr, const H& hash = H())
+	{
+		if (G.isZero()) throw cybozu::Exception("SchnorrT:init:G is zero");
+		Gmp::fromStr(n_, nStr);
+		G_ = G;
+		G_.normalize();
+		const typename Ec::Param& param = Ec::getParam();
+		hasPhi_ = param.isGlv;
+		if (hasPhi_) {
+			phiG_ = Ec(G_.x * param.beta, G_.y, false);
+		} else {
+			phiG_.clear();
+		}
+		hash_ = hash;
+	}
+	/*
+		e = H(R || Q || msg) mod n
+	*/
+	void getChallenge(Zn& e, const Ec& R, const Ec& Q, const std::string& msg) const
+	{
+		std::string buf;
+		appendPoint(buf, R);
+		appendPoint(buf, Q);
+		buf += msg;
+		const std::string md = hash_(buf);
+		mpz_class x;
+		if (!md.empty()) mpz_import(x.get_mpz_t(), md.size(), 1, 1, 1, 0, md.data());
+		ec_local::fromMpz(e, x, n_);
+	}
+	void getPublicKey(Ec& Q, const Zn& sec) const
+	{
+		mulSecret(Q, sec);
+	}
+	/*
+		sign msg by sec with the nonce k(0 < k < n)
+		Q : public key of sec made by getPublicKey
+		k must be secret and used only once
+	*/
+	void signWithNonce(Signature& sig, const Zn& sec, const Ec& Q, const std::string& msg, const Zn& k) const
+	{
+		if (k.isZero()) throw cybozu::Exception("SchnorrT:signWithNonce:k is zero");
+		mulSecret(sig.R, k);
+		Zn e;
+		getChallenge(e, sig.R, Q, msg);
+		sig.s = e * sec;
+		sig.s += k;
+	}
+	/*
+		sign msg by sec and the public key Q with a nonce made by rg
+	*/
+	template<class RG>
+	void sign(Signature& sig, const Zn& sec, const Ec& Q, const std::string& msg, RG& rg) const
+	{
+		Zn k;
+		do {
+			k.setRand(rg);
+		} while (k.isZero());
+		signWithNonce(sig, sec, Q, msg, k);
+	}
+	/*
+		verify sig of msg by the public key Q
+	*/
+	bool verify(const Signature& sig, const Ec& Q, const std::string& msg) const
+	{
+		Zn e;
+		if (!getChallengeVec(&e, &sig, &Q, &msg, 1)) return false;
+		return verifySub(sig, Q, e);
+	}
+	/*
+		return true if all sig[i] of msg[i] by Q[i] are valid for i < n
+		rg makes the coefficients of the linear combination
+		and must not be predictable by the signers
+	*/
+	template<class RG>
+	bool verifyBatch(const Signature *sig, const Ec *Q, const std::string *msg, size_t n, RG& rg) const
+	{
+		if (n == 0) return true;
+		std::vector<Zn> e(n);
+		if (!getChallengeVec(&e[0], sig, Q, msg, n)) return false;
+		return verifyBatchSub(sig, Q, &e[0], n, rg);
+	}
+	/*
+		bad = indices of invalid signatures in ascending order
+		return true if bad is empty
+		a batch which fails is split into halves and each half is verified again
+		so that k bad signatures cost about 2k log(n / k) batches
+	*/
+	template<class RG>
+	bool findBad(std::vector<size_t>& bad, const Signature *sig, const Ec *Q, const std::string *msg, size_t n, RG& rg) const
+	{
+		bad.clear();
+		if (n == 0) return true;
+		std::vector<Zn> e(n);
+		std::vector<char> isBad(n);
+		for (size_t i = 0; i < n; i++) {
+			isBad[i] = !getChallengeVec(&e[i], &sig[i], &Q[i], &msg[i], 1);
+		}
+		findBadSub(bad, sig, Q, &e[0], &isBad[0], 0, n, rg);
+		return bad.empty();
+	}
+	const Ec& getBase() const { return G_; }
+};
+
+template<class _Fp, class _Zn, class H>
+const size_t SchnorrT<_Fp, _Zn, H>::batchBitLen;
+
+} // mie
@@ -0,0 +1,107 @@
+#pragma once
+/**
+	@file
+	@brief minimal thread helper
+	@author MITSUNARI Shigeo(@herumi)
+	@license modified new BSD license
+	http://opensource.org/licenses/BSD-3-Clause
+*/
+#include <vector>
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#else
+	#include <pthread.h>
+	#include <unistd.h>
+#endif
+
+namespace mie { namespace thread {
+
+namespace local {
+
+template<class T>
+struct Arg {
+	T *task;
+	size_t id;
+};
+
+#ifdef _WIN32
+template<class T>
+DWORD WINAPI entry(void *p)
+{
+	const Arg<T>& arg = *static_cast<const Arg<T>*>(p);
+	(*arg.task)(arg.id);
+	return 0;
+}
+#else
+template<class T>
+void *entry(void *p)
+{
+	const Arg<T>& arg = *static_cast<const Arg<T>*>(p);
+	(*arg.task)(arg.id);
+	return 0;
+}
+#endif
+
+} // mie::thread::local
+
+/*
+	number of online processors(1 if unknown)
+*/
+inline size_t getProcessorNum()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? size_t(info.dwNumberOfProcessors) : 1;
+#else
+	const long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? size_t(n) : 1;
+#endif
+}
+
+/*
+	call task(id) for id = 0, ..., n - 1 on n threads and wait for all of them
+	id 0 runs on the current thread
+	task(id) for a thread which can't be created runs on the current thread
+	task must not throw
+*/
+template<class T>
+void run(T& task, size_t n)
+{
+	if (n == 0) return;
+	std::vector<local::Arg<T> > arg(n);
+#ifdef _WIN32
+	std::vector<HANDLE> th(n);
+#else
+	std::vector<pthread_t> th(n);
+#endif
+	std::vector<char> isRunning(n);
+	for (size_t i = 1; i < n; i++) {
+		arg[i].task = &task;
+		arg[i].id = i;
+#ifdef _WIN32
+		th[i] = CreateThread(NULL, 0, local::entry<T>, &arg[i], 0, NULL);
+		isRunning[i] = th[i] != NULL;
+#else
+		isRunning[i] = pthread_create(&th[i], NULL, local::entry<T>, &arg[i]) == 0;
+#endif
+	}
+	task(0);
+	for (size_t i = 1; i < n; i++) {
+		if (!isRunning[i]) {
+			task(i);
+			continue;
+		}
+#ifdef _WIN32
+		WaitForSingleObject(th[i], INFINITE);
+		CloseHandle(th[i]);
+#else
+		pthread_join(th[i], NULL);
+#endif
+	}
+}
+
+} } // mie::thread
@@ -36,6 +36,8 @@ int main()
 	Fp::setModulo(para.p);
 	Ec::setParam(para.a, para.b);
 	const Ec P(Fp(para.gx), Fp(para.gy));
+	// precomputed table to make multiples of P faster
+	const mie::FixedBaseT<Fp> fbP(P);
 
 	/*
 		Alice setups a private key a and public key aP
@@ -44,7 +46,7 @@ int main()
 	Ec aP;
 
 	a.setRand(rg);
-	Ec::power(aP, P, a); // aP = a * P;
+	fbP.mul(aP, a); // aP = a * P;
 
 	std::cout << "aP=" << aP << std::endl;
 
@@ -55,7 +57,7 @@ int main()
 	Ec bP;
 
 	b.setRand(rg);
-	Ec::power(bP, P, b); // bP = b * P;
+	fbP.mul(bP, b); // bP = b * P;
 
 	std::cout << "bP=" << bP << std::endl;
 
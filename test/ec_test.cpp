@@ -32,6 +32,9 @@ typedef mie::FpT<mie::Gmp> Fp_9;
 #endif
 #include <mie/ec.hpp>
 #include <mie/ecparam.hpp>
+#include <mie/fixed_base_file.hpp>
+#include <fstream>
+#include <stdio.h>
 #include <time.h>
 
 struct tagZn;
@@ -51,6 +54,8 @@ struct Test {
 		Fp::setModulo(para.p);
 		Zn::setModulo(para.n);
 		Ec::setParam(para.a, para.b);
+		const mie::EcGlvParam *glv = mie::getEcGlvParam(para.name);
+		if (glv) Ec::setGlv(glv->beta, glv->lambda, para.n, Ec(Fp(para.gx), Fp(para.gy)));
 //		CYBOZU_TEST_EQUAL(para.bitLen, Fp(-1).getBitLen());
 	}
 	void cstr() const
@@ -155,6 +160,491 @@ struct Test {
 			R -= P;
 		}
 	}
+	void wnaf() const
+	{
+		const Fp x(para.gx);
+		const Fp y(para.gy);
+		const Ec P(x, y);
+		mpz_class n;
+		mie::Gmp::fromStr(n, para.n);
+		const mpz_class tbl[] = {
+			65535, 65536, mpz_class(1) << 100, (mpz_class(1) << 100) - 1,
+			n / 3, n / 7, n - 1, n - 12345, n, n + 1,
+		};
+		for (int w = 0; w <= Ec::maxWnafWidth; w++) {
+			if (0 < w && w < 4) {
+				CYBOZU_TEST_EXCEPTION(Ec::setWnafWidth(w), cybozu::Exception);
+				continue;
+			}
+			Ec::setWnafWidth(w);
+			for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+				Ec Q, R;
+				Ec::power(Q, P, tbl[i]);
+				mie::power_impl::powerArray(R, P, mie::Gmp::getBlock(tbl[i]), mie::Gmp::getBlockSize(tbl[i]));
+				CYBOZU_TEST_EQUAL(Q, R);
+			}
+		}
+		Ec::setWnafWidth(0);
+		CYBOZU_TEST_EXCEPTION(Ec::setWnafWidth(7), cybozu::Exception);
+		// naf of 2^k - 1 = 2^k - 1 with digits 0 or odd
+		std::vector<signed char> naf;
+		const uint32_t v = 0x7fffffff;
+		mie::ec_local::getNaf(naf, &v, 1, 4);
+		int64_t sum = 0;
+		for (size_t i = naf.size(); i > 0; i--) {
+			const int d = naf[i - 1];
+			CYBOZU_TEST_ASSERT(d == 0 || (d & 1));
+			CYBOZU_TEST_ASSERT(-8 < d && d < 8);
+			sum = sum * 2 + d;
+		}
+		CYBOZU_TEST_EQUAL(sum, v);
+		CYBOZU_TEST_ASSERT(naf.back() > 0);
+	}
+	void fixedBase() const
+	{
+		const Fp x(para.gx);
+		const Fp y(para.gy);
+		const Ec P(x, y);
+		mpz_class n;
+		mie::Gmp::fromStr(n, para.n);
+		const mpz_class tbl[] = {
+			0, 1, 2, 3, 65535, mpz_class(1) << 100, n / 3, n / 7, n - 1, n - 12345, n, n + 1, -5, -(n / 3),
+			(mpz_class(1) << (para.bitLen + 8)) + 7, // larger than the table
+		};
+		const int wTbl[] = { 1, 2, 4, 6, 8 };
+		for (size_t k = 0; k < CYBOZU_NUM_OF_ARRAY(wTbl); k++) {
+			mie::FixedBaseT<Fp> fb(P, para.bitLen, wTbl[k]);
+			for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+				Ec Q, R;
+				fb.mul(Q, tbl[i]);
+				Ec::power(R, P, tbl[i]);
+				CYBOZU_TEST_EQUAL(Q, R);
+			}
+		}
+		mie::FixedBaseT<Fp> fb(P);
+		Ec Q, R;
+		for (int i = 0; i < 30; i++) {
+			fb.mul(Q, i);
+			CYBOZU_TEST_EQUAL(Q, R);
+			R += P;
+		}
+		CYBOZU_TEST_EXCEPTION(fb.init(P, 0, 0), cybozu::Exception);
+		CYBOZU_TEST_EXCEPTION(fb.init(P, 0, 9), cybozu::Exception);
+		// mixed addition
+		Ec P2, P3;
+		Ec::dbl(P2, P);
+		Ec::addAffine(Q, P2, x, y);
+		Ec::add(R, P2, P);
+		CYBOZU_TEST_EQUAL(Q, R);
+		Ec::addAffine(Q, P, x, y);
+		CYBOZU_TEST_EQUAL(Q, P2);
+		Ec::addAffine(Q, -P, x, y);
+		CYBOZU_TEST_ASSERT(Q.isZero());
+		Ec::addAffine(Q, Q, x, y);
+		CYBOZU_TEST_EQUAL(Q, P);
+	}
+	void mulVec() const
+	{
+		const Fp x(para.gx);
+		const Fp y(para.gy);
+		const Ec G(x, y);
+		mpz_class n;
+		mie::Gmp::fromStr(n, para.n);
+		const size_t nTbl[] = { 0, 1, 2, 5, Ec::mulVecStrausMaxN, Ec::mulVecStrausMaxN + 1, 300 };
+		const size_t maxN = 300;
+		std::vector<Ec> P(maxN);
+		std::vector<mpz_class> k(maxN);
+		for (size_t i = 0; i < maxN; i++) {
+			Ec::power(P[i], G, int(i * 7 + 3));
+			k[i] = n / int(i + 2) + int(i);
+			if (i & 1) k[i] = -k[i];
+		}
+		// zero, P and -P, equal terms and a small scalar
+		P[3].clear();
+		k[4] = 0;
+		P[6] = -P[5];
+		k[6] = k[5];
+		P[8] = P[7];
+		k[8] = k[7];
+		k[9] = 3;
+		for (size_t t = 0; t < CYBOZU_NUM_OF_ARRAY(nTbl); t++) {
+			const size_t m = nTbl[t];
+			Ec Q, R, T;
+			for (size_t i = 0; i < m; i++) {
+				Ec::power(T, P[i], k[i]);
+				R += T;
+			}
+			Ec::mulVec(Q, &P[0], &k[0], m);
+			CYBOZU_TEST_EQUAL(Q, R);
+		}
+		// int scalars
+		const int ki[] = { 1, -2, 3, 0, 5 };
+		Ec Q, R, T;
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(ki); i++) {
+			Ec::power(T, P[i], ki[i]);
+			R += T;
+		}
+		Ec::mulVec(Q, &P[0], ki, CYBOZU_NUM_OF_ARRAY(ki));
+		CYBOZU_TEST_EQUAL(Q, R);
+	}
+	void powerVec() const
+	{
+		const Fp x(para.gx);
+		const Fp y(para.gy);
+		const Ec G(x, y);
+		mpz_class n;
+		mie::Gmp::fromStr(n, para.n);
+		const size_t maxN = 100;
+		std::vector<Ec> P(maxN), Q(maxN);
+		std::vector<mpz_class> k(maxN);
+		for (size_t i = 0; i < maxN; i++) {
+			// G and 2G appear many times to use FixedBaseT
+			if (i % 3 == 0) {
+				P[i] = G;
+			} else if (i % 5 == 0) {
+				P[i] = G + G;
+			} else {
+				Ec::power(P[i], G, int(i * 7 + 3));
+			}
+			k[i] = n / int(i + 2) + int(i);
+			if (i & 1) k[i] = -k[i];
+		}
+		P[1].clear();
+		k[2] = 0;
+		k[4] = n * 3 + 5; // larger than the table of FixedBaseT
+		const size_t nTbl[] = { 0, 1, 5, maxN };
+		const size_t threadTbl[] = { 1, 3, 0 };
+		for (size_t t = 0; t < CYBOZU_NUM_OF_ARRAY(nTbl); t++) {
+			const size_t m = nTbl[t];
+			for (size_t u = 0; u < CYBOZU_NUM_OF_ARRAY(threadTbl); u++) {
+				Ec::powerVec(&Q[0], &P[0], &k[0], m, threadTbl[u]);
+				for (size_t i = 0; i < m; i++) {
+					Ec R;
+					Ec::power(R, P[i], k[i]);
+					CYBOZU_TEST_EQUAL(Q[i], R);
+					CYBOZU_TEST_ASSERT(Q[i].isZero() || Q[i].isAffine());
+				}
+			}
+		}
+		const int ki[] = { 1, -2, 3, 0, 5 };
+		Ec::powerVec(&Q[0], &P[0], ki, CYBOZU_NUM_OF_ARRAY(ki), 2);
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(ki); i++) {
+			Ec R;
+			Ec::power(R, P[i], ki[i]);
+			CYBOZU_TEST_EQUAL(Q[i], R);
+		}
+	}
+	void glv() const
+	{
+		const Fp x(para.gx);
+		const Fp y(para.gy);
+		const Ec P(x, y);
+		const mie::EcGlvParam *glv = mie::getEcGlvParam(para.name);
+		if (glv == 0) {
+			CYBOZU_TEST_ASSERT(!Ec::getParam().isGlv);
+			if (!Ec::getParam().a.isZero()) {
+				CYBOZU_TEST_EXCEPTION(Ec::setGlv("1", "1", para.n, P), cybozu::Exception);
+			}
+			return;
+		}
+		const typename Ec::Param& param = Ec::getParam();
+		CYBOZU_TEST_ASSERT(param.isGlv);
+		mpz_class n, lambda;
+		mie::Gmp::fromStr(n, para.n);
+		mie::Gmp::fromStr(lambda, glv->lambda);
+		// lambda P = phi(P)
+		Ec Q, R;
+		mie::power_impl::powerArray(Q, P, mie::Gmp::getBlock(lambda), mie::Gmp::getBlockSize(lambda));
+		CYBOZU_TEST_EQUAL(Q, Ec(x * param.beta, y));
+		const mpz_class tbl[] = {
+			65535, n / 3, n / 7, n - 1, n - 2, n, n + 1, n * 3 + 5, lambda, n - lambda, (n >> 1) + 1, -(n / 5),
+		};
+		const size_t halfBitLen = (mie::Gmp::getBitLen(n) + 1) / 2 + 2;
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+			mpz_class k = tbl[i] % n, k1, k2;
+			if (k < 0) k += n;
+			Ec::splitGlv(k1, k2, k);
+			CYBOZU_TEST_ASSERT((k1 + k2 * lambda - k) % n == 0);
+			CYBOZU_TEST_ASSERT(mie::Gmp::getBitLen(k1 < 0 ? -k1 : k1) <= halfBitLen);
+			CYBOZU_TEST_ASSERT(mie::Gmp::getBitLen(k2 < 0 ? -k2 : k2) <= halfBitLen);
+			Ec::power(Q, P, tbl[i]);
+			mie::power_impl::powerArray(R, P, mie::Gmp::getBlock(k), mie::Gmp::getBlockSize(k));
+			CYBOZU_TEST_EQUAL(Q, R);
+			Ec::dbl(R, P);
+			Ec::power(Q, R, tbl[i]);
+			Ec::power(R, P, mpz_class(tbl[i] * 2));
+			CYBOZU_TEST_EQUAL(Q, R);
+		}
+		CYBOZU_TEST_EXCEPTION(Ec::setGlv("1", glv->lambda, para.n, P), cybozu::Exception);
+		CYBOZU_TEST_EXCEPTION(Ec::setGlv(glv->beta, "2", para.n, P), cybozu::Exception);
+		CYBOZU_TEST_EXCEPTION(Ec::setGlv(glv->beta, glv->lambda, para.n, Ec()), cybozu::Exception);
+		{
+			// the other cube root of 1 pairs with lambda^2 but not with lambda
+			const Fp beta2 = param.beta * param.beta;
+			const mpz_class lambda2 = lambda * lambda % n;
+			CYBOZU_TEST_EXCEPTION(Ec::setGlv(beta2.toStr(), glv->lambda, para.n, P), cybozu::Exception);
+			Ec::setGlv(beta2.toStr(), lambda2.get_str(), para.n, P);
+			const mpz_class k = n / 3;
+			Ec::power(Q, P, k);
+			mie::power_impl::powerArray(R, P, mie::Gmp::getBlock(k), mie::Gmp::getBlockSize(k));
+			CYBOZU_TEST_EQUAL(Q, R);
+			Ec::setGlv(glv->beta, glv->lambda, para.n, P);
+		}
+		CYBOZU_TEST_ASSERT(Ec::getParam().isGlv);
+	}
+	void constTime() const
+	{
+		const Fp x(para.gx);
+		const Fp y(para.gy);
+		const Ec P(x, y);
+		mpz_class n;
+		mie::Gmp::fromStr(n, para.n);
+		const mpz_class tbl[] = {
+			0, 1, 2, 3, 4, 31, 32, 33, 65535, 65536, n / 3, n / 7, n - 1, n - 2, n, n + 1, (n >> 1) + 1,
+			(mpz_class(1) << (para.bitLen + 20)) + 3, // larger than the order
+		};
+		Ec P2;
+		Ec::dbl(P2, P);
+		mie::FixedBaseT<Fp> fb(P);
+		CYBOZU_TEST_ASSERT(!Ec::isConstTime());
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+			const mpz_class& k = tbl[i];
+			Ec Q, R;
+			mie::power_impl::powerArray(R, P, mie::Gmp::getBlock(k), mie::Gmp::getBlockSize(k));
+			Ec::powerCT(Q, P, mie::Gmp::getBlock(k), mie::Gmp::getBlockSize(k));
+			CYBOZU_TEST_EQUAL(Q, R);
+			Ec::dbl(R, R);
+			Ec::powerCT(Q, P2, mie::Gmp::getBlock(k), mie::Gmp::getBlockSize(k));
+			CYBOZU_TEST_EQUAL(Q, R);
+		}
+		Ec::setConstTime(true);
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+			Ec Q, R;
+			Ec::power(Q, P, tbl[i]);
+			fb.mul(R, tbl[i]);
+			CYBOZU_TEST_EQUAL(Q, R);
+			Ec::power(R, P, mpz_class(-tbl[i]));
+			CYBOZU_TEST_EQUAL(Q, -R);
+		}
+		Ec Q;
+		Ec::power(Q, Ec(), mpz_class(n - 1));
+		CYBOZU_TEST_ASSERT(Q.isZero());
+		Ec::setConstTime(false);
+		Ec R;
+		Ec::power(R, P, mpz_class(n - 1));
+		CYBOZU_TEST_EQUAL(R, -P);
+	}
+	void mixedAdd() const
+	{
+		const Fp x(para.gx);
+		const Fp y(para.gy);
+		const Ec P(x, y);
+		CYBOZU_TEST_ASSERT(P.isAffine());
+		Ec P2, P3, Q, R;
+		Ec::dbl(P2, P);
+		CYBOZU_TEST_ASSERT(!P2.isAffine());
+		Ec::add(P3, P2, P);
+		CYBOZU_TEST_ASSERT(!P3.isAffine());
+		const Ec tbl[] = { P, -P, P2, -P2, P3, Ec() };
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+			for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(tbl); j++) {
+				Ec S = tbl[j];
+				S.normalize();
+				CYBOZU_TEST_ASSERT(S.isZero() || S.isAffine());
+				Ec::add(Q, tbl[i], S);
+				Ec::add(R, S, tbl[i]);
+				CYBOZU_TEST_EQUAL(Q, R);
+				// (x, y, z) of S changed to another representation by writing z directly
+				Ec T = S;
+				if (!T.isZero()) {
+					const Fp c = 3;
+#if MIE_EC_COORD == MIE_EC_USE_JACOBI
+					T.x *= c * c;
+					T.y *= c * c * c;
+#else
+					T.x *= c;
+					T.y *= c;
+#endif
+					T.z *= c;
+					CYBOZU_TEST_ASSERT(!T.isAffine());
+				}
+				Ec::add(R, tbl[i], T);
+				CYBOZU_TEST_EQUAL(Q, R);
+				Ec::add(R, T, tbl[i]);
+				CYBOZU_TEST_EQUAL(Q, R);
+				// aliasing
+				R = tbl[i];
+				Ec::add(R, R, S);
+				CYBOZU_TEST_EQUAL(Q, R);
+				R = S;
+				Ec::add(R, tbl[i], R);
+				CYBOZU_TEST_EQUAL(Q, R);
+			}
+		}
+		cybozu::BitVector bv;
+		P3.appendToBitVec(bv);
+		Q.fromBitVec(bv);
+		CYBOZU_TEST_ASSERT(Q.isAffine());
+		CYBOZU_TEST_EQUAL(Q, P3);
+		Q.clear();
+		CYBOZU_TEST_ASSERT(!Q.isAffine());
+	}
+	void isEqual() const
+	{
+		const Fp x(para.gx);
+		const Fp y(para.gy);
+		const Ec P(x, y);
+		Ec P2, P3, Q, R;
+		Ec::dbl(P2, P);
+		Ec::add(P3, P2, P);
+		Ec::dbl(Q, P3);
+		Ec::add(R, P3, P3);
+		Ec::add(R, R, P2);
+		Ec::sub(R, R, P2); // R = 6P in another representation
+		CYBOZU_TEST_ASSERT(!Q.isAffine() && !R.isAffine());
+		CYBOZU_TEST_ASSERT(Q == R);
+		CYBOZU_TEST_ASSERT(!(Q != R));
+		// not normalized by ==
+		CYBOZU_TEST_ASSERT(!Q.isAffine() && !R.isAffine());
+		CYBOZU_TEST_ASSERT(Q != P3);
+		CYBOZU_TEST_ASSERT(Q != -R);
+		CYBOZU_TEST_ASSERT(Q != Ec());
+		CYBOZU_TEST_ASSERT(Ec() != Q);
+		CYBOZU_TEST_ASSERT(Ec() == Ec());
+		Ec S = R;
+		S.normalize();
+		CYBOZU_TEST_ASSERT(S == Q);
+		CYBOZU_TEST_ASSERT(Q == S);
+		CYBOZU_TEST_ASSERT(S != P);
+		CYBOZU_TEST_ASSERT(P != Q);
+		CYBOZU_TEST_ASSERT(Q < P || P < Q);
+		CYBOZU_TEST_ASSERT(Q <= S && Q >= S);
+		// hash does not depend on the representation
+		const size_t h = std::hash<Ec>()(Q);
+		CYBOZU_TEST_ASSERT(Q.isAffine());
+		CYBOZU_TEST_EQUAL(std::hash<Ec>()(Q), h);
+		CYBOZU_TEST_EQUAL(std::hash<Ec>()(R), h);
+		CYBOZU_TEST_EQUAL(std::hash<Ec>()(Ec()), 0u);
+	}
+	void normalizeVec() const
+	{
+		const Fp x(para.gx);
+		const Fp y(para.gy);
+		const Ec G(x, y);
+		const size_t n = 10;
+		Ec P[n], Q[n];
+		for (size_t i = 0; i < n; i++) {
+			Ec::power(P[i], G, int(i * 5 + 2));
+		}
+		P[3].clear();
+		P[4].normalize();
+		for (size_t i = 0; i < n; i++) {
+			Q[i] = P[i];
+			Q[i].normalize();
+		}
+		Ec::normalizeVec(P, n);
+		for (size_t i = 0; i < n; i++) {
+			CYBOZU_TEST_EQUAL(P[i].isZero(), Q[i].isZero());
+			if (P[i].isZero()) continue;
+			CYBOZU_TEST_EQUAL(P[i].x, Q[i].x);
+			CYBOZU_TEST_EQUAL(P[i].y, Q[i].y);
+			CYBOZU_TEST_EQUAL(P[i].z, 1);
+		}
+		// by the constant time inversion
+		{
+			Ec R[n], S[n];
+			for (size_t i = 0; i < n; i++) {
+				Ec::power(R[i], G, int(i * 5 + 2));
+				S[i] = R[i];
+				S[i].normalizeCT();
+			}
+			R[3].clear();
+			S[3].clear();
+			Ec::setConstTime(true);
+			Ec::normalizeVec(R, n);
+			Ec::setConstTime(false);
+			for (size_t i = 0; i < n; i++) {
+				CYBOZU_TEST_EQUAL(R[i].isZero(), Q[i].isZero());
+				if (R[i].isZero()) continue;
+				CYBOZU_TEST_EQUAL(R[i].x, Q[i].x);
+				CYBOZU_TEST_EQUAL(R[i].y, Q[i].y);
+				CYBOZU_TEST_EQUAL(S[i].x, Q[i].x);
+				CYBOZU_TEST_EQUAL(S[i].y, Q[i].y);
+				CYBOZU_TEST_ASSERT(S[i].isAffine());
+			}
+		}
+		for (int c = 0; c < 2; c++) {
+			Ec::setCompressedExpression(c == 1);
+			for (size_t i = 0; i < n; i++) {
+				Ec::dbl(P[i], Q[i]);
+				Q[i] = P[i];
+			}
+			cybozu::BitVector bv;
+			Ec::appendVecToBitVec(bv, P, n);
+			CYBOZU_TEST_EQUAL(bv.size(), Ec::getBitVecSize() * n);
+			Ec R[n];
+			Ec::fromBitVecVec(R, n, bv);
+			for (size_t i = 0; i < n; i++) {
+				CYBOZU_TEST_EQUAL(R[i], Q[i]);
+			}
+			bv.resize(bv.size() + 1);
+			CYBOZU_TEST_EXCEPTION(Ec::fromBitVecVec(R, n, bv), cybozu::Exception);
+		}
+		Ec::setCompressedExpression(false);
+	}
+	void serialize() const
+	{
+		const size_t byteSize = Fp::getByteSize();
+		const Ec P(Fp(para.gx), Fp(para.gy));
+		const size_t n = 4;
+		Ec Pv[n], Qv[n];
+		Pv[0] = P;
+		Ec::dbl(Pv[1], P);
+		Pv[2].clear();
+		Ec::add(Pv[3], Pv[1], P);
+		std::vector<uint8_t> buf((1 + byteSize * 2) * n);
+		for (int i = 0; i < 2; i++) {
+			const bool compressed = i == 1;
+			Ec::setCompressedExpression(compressed);
+			const size_t size = Ec::getSerializedSize();
+			CYBOZU_TEST_EQUAL(size, compressed ? 1 + byteSize : 1 + byteSize * 2);
+			CYBOZU_TEST_EQUAL(P.serialize(&buf[0], buf.size()), size);
+			if (compressed) {
+				CYBOZU_TEST_EQUAL(buf[0], Fp::isYodd(P.y) ? 3 : 2);
+			} else {
+				CYBOZU_TEST_EQUAL(buf[0], 4);
+			}
+			Fp x;
+			x.deserialize(&buf[1], byteSize);
+			CYBOZU_TEST_EQUAL(x, P.x);
+			Ec Q;
+			CYBOZU_TEST_EQUAL(Q.deserialize(&buf[0], size), size);
+			CYBOZU_TEST_EQUAL(Q, P);
+			CYBOZU_TEST_EXCEPTION(Q.deserialize(&buf[0], size - 1), cybozu::Exception);
+			buf[0] = 5;
+			CYBOZU_TEST_EXCEPTION(Q.deserialize(&buf[0], size), cybozu::Exception);
+
+			CYBOZU_TEST_EQUAL(Ec::serializeVec(&buf[0], buf.size(), Pv, n), size * n);
+			CYBOZU_TEST_EQUAL(Ec::deserializeVec(Qv, n, &buf[0], size * n), size * n);
+			for (size_t j = 0; j < n; j++) {
+				CYBOZU_TEST_EQUAL(Qv[j], Pv[j]);
+			}
+			CYBOZU_TEST_ASSERT(Qv[2].isZero());
+			CYBOZU_TEST_EXCEPTION(Ec::serializeVec(&buf[0], size * n - 1, Pv, n), cybozu::Exception);
+			CYBOZU_TEST_EXCEPTION(Ec::deserializeVec(Qv, n, &buf[0], size * n - 1), cybozu::Exception);
+			// zero must be followed by zeros
+			buf[size * 2 + 1] = 1;
+			CYBOZU_TEST_EXCEPTION(Ec::deserializeVec(Qv, n, &buf[0], size * n), cybozu::Exception);
+		}
+		Ec::setCompressedExpression(false);
+		// a point not on the curve is accepted only without verification
+		P.serialize(&buf[0], buf.size());
+		buf[buf.size() / n - 1] ^= 1;
+		Ec Q;
+		CYBOZU_TEST_EXCEPTION(Q.deserialize(&buf[0], buf.size()), cybozu::Exception);
+		CYBOZU_TEST_NO_EXCEPTION(Q.deserialize(&buf[0], buf.size(), false));
+		CYBOZU_TEST_EQUAL(Q.x, P.x);
+	}
 	void squareRoot() const
 	{
 		Fp x(para.gx);
@@ -168,6 +658,37 @@ struct Test {
 		yy.clear();
 		Ec::getYfromX(yy, x, odd);
 		CYBOZU_TEST_EQUAL(yy, y);
+		// x which is not on the curve
+		x = 0;
+		do {
+			x += 1;
+		} while (Ec::getYfromX(y, x, false));
+		Fp::square(yy, x);
+		yy += Fp(para.a);
+		yy *= x;
+		yy += Fp(para.b);
+		CYBOZU_TEST_ASSERT(!Fp::squareRoot(y, yy));
+
+		const size_t n = 5;
+		Ec P[n], Q[n];
+		Fp xs[n];
+		bool odds[n];
+		P[0].set(Fp(para.gx), Fp(para.gy));
+		for (size_t i = 1; i < n; i++) {
+			Ec::dbl(P[i], P[i - 1]);
+		}
+		Ec::normalizeVec(P, n);
+		for (size_t i = 0; i < n; i++) {
+			xs[i] = P[i].x;
+			odds[i] = Fp::isYodd(P[i].y);
+		}
+		Ec::decompressVec(Q, xs, odds, n);
+		for (size_t i = 0; i < n; i++) {
+			CYBOZU_TEST_EQUAL(Q[i], P[i]);
+			CYBOZU_TEST_ASSERT(Ec::isValid(Q[i].x, Q[i].y));
+		}
+		xs[3] = x;
+		CYBOZU_TEST_EXCEPTION(Ec::decompressVec(Q, xs, odds, n), cybozu::Exception);
 	}
 	void power_fp() const
 	{
@@ -331,6 +852,8 @@ struct Test {
 		CYBOZU_BENCH("dbl", Ec::dbl, P, P);
 		Zn z("-3");
 		CYBOZU_BENCH("pow", Ec::power, P, P, z);
+		mie::FixedBaseT<Fp> fb(P);
+		CYBOZU_BENCH("fixedBase", fb.mul, Q, z);
 	}
 /*
 Affine : sandy-bridge
@@ -351,7 +874,17 @@ pow 499.00usec
 		power();
 		neg_power();
 		power_fp();
+		wnaf();
+		glv();
+		constTime();
+		fixedBase();
+		mulVec();
+		powerVec();
+		mixedAdd();
+		isEqual();
+		normalizeVec();
 		binaryExpression();
+		serialize();
 		squareRoot();
 		str();
 #ifdef NDEBUG
@@ -418,6 +951,161 @@ CYBOZU_TEST_AUTO(all)
 	}
 }
 
+CYBOZU_TEST_AUTO(curveCtx)
+{
+	typedef mie::EcT<Fp_4> Ec;
+	typedef mie::CurveCtxT<Fp_4> CurveCtx;
+	const mie::EcParam& para = mie::ecparam::secp256k1;
+	Fp_4::setModulo(para.p);
+	Ec::setParam(para.a, para.b);
+	const Fp_4 x(para.gx), y(para.gy);
+	// another curve y^2 = x^3 + x + b through (x, y)
+	const Fp_4 b = y * y - (x * x + 1) * x;
+	CurveCtx ctx;
+	ctx.setParam("1", b.toStr());
+	const Ec P(x, y);
+	Ec Q, R;
+	{
+		CurveCtx::Scope scope(ctx);
+		CYBOZU_TEST_ASSERT(Ec::isValid(x, y));
+		Ec::dbl(Q, P);
+		Q.normalize();
+		CYBOZU_TEST_ASSERT(Ec::isValid(Q.x, Q.y));
+		// threads of powerVec use ctx
+		const Ec Pv[] = { P, P, P, P, Q };
+		const int k[] = { 2, 3, 4, 5, 6 };
+		Ec out[5];
+		Ec::powerVec(out, Pv, k, 5, 3);
+		for (size_t i = 0; i < 5; i++) {
+			Ec::power(R, Pv[i], k[i]);
+			CYBOZU_TEST_EQUAL(out[i], R);
+		}
+	}
+	Ec::dbl(R, P);
+	R.normalize();
+	CYBOZU_TEST_ASSERT(Ec::isValid(R.x, R.y));
+	CYBOZU_TEST_ASSERT(!Ec::isValid(Q.x, Q.y));
+	CYBOZU_TEST_ASSERT(Q != R);
+}
+
+CYBOZU_TEST_AUTO(fixedBaseFile)
+{
+	typedef mie::EcT<Fp_4> Ec;
+	typedef mie::FixedBaseT<Fp_4> FixedBase;
+	typedef mie::FixedBaseFileT<Fp_4> FixedBaseFile;
+	const mie::EcParam& para = mie::ecparam::secp256k1;
+	Fp_4::setModulo(para.p);
+	Zn::setModulo(para.n);
+	Ec::setParam(para.a, para.b);
+	const Ec G(Fp_4(para.gx), Fp_4(para.gy));
+	const char *path = "fixed_base_file_test.tbl";
+	const size_t n = 3;
+	FixedBase fb[n];
+	const FixedBase *pfb[n];
+	for (size_t i = 0; i < n; i++) {
+		Ec P;
+		Ec::power(P, G, int(i + 1));
+		fb[i].init(P, 0, 5);
+		pfb[i] = &fb[i];
+	}
+	FixedBaseFile::save(path, pfb, n);
+	{
+		FixedBaseFile file(path);
+		CYBOZU_TEST_EQUAL(file.size(), n);
+		const size_t tblSize = fb[0].getSerializedSize();
+		std::vector<uint8_t> b1(tblSize), b2(tblSize);
+		for (size_t i = 0; i < n; i++) {
+			const FixedBase& t = file.get(i);
+			CYBOZU_TEST_EQUAL(t.getBase(), fb[i].getBase());
+			CYBOZU_TEST_EQUAL(t.getWindowSize(), 5);
+			fb[i].serialize(&b1[0], tblSize);
+			t.serialize(&b2[0], tblSize);
+			CYBOZU_TEST_ASSERT(b1 == b2);
+			const char *kTbl[] = { "0", "1", "-7", "123456789", "0x1234567890abcdef1234567890abcdef" };
+			for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(kTbl); j++) {
+				const Zn k(kTbl[j]);
+				Ec Q, R;
+				t.mul(Q, k);
+				Ec::power(R, fb[i].getBase(), k);
+				CYBOZU_TEST_EQUAL(Q, R);
+			}
+		}
+	}
+	std::string data;
+	{
+		std::ifstream ifs(path, std::ios::binary);
+		data.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+	}
+	const std::string badPath = "fixed_base_file_test_bad.tbl";
+	// corrupt an entry, truncate the file or break the header
+	const size_t posTbl[] = { data.size() - 1, 0, 8, 24 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(posTbl) + 1; i++) {
+		std::string bad = data;
+		if (i < CYBOZU_NUM_OF_ARRAY(posTbl)) {
+			bad[posTbl[i]] ^= 1;
+		} else {
+			bad.resize(bad.size() - 64);
+		}
+		{
+			std::ofstream ofs(badPath.c_str(), std::ios::binary);
+			ofs.write(bad.data(), bad.size());
+		}
+		CYBOZU_TEST_EXCEPTION(FixedBaseFile f(badPath), cybozu::Exception);
+	}
+	// a broken entry with the right checksum
+	{
+		std::string bad = data;
+		const size_t tblSize = fb[0].getSerializedSize();
+		bad[data.size() - n * tblSize + FixedBase::getSerializedStride() + 5] ^= 1;
+		const size_t headerSize = FixedBaseFile::headerSize;
+		const uint64_t sum = mie::fixed_base_file_local::fnv1a((const uint8_t*)&bad[headerSize], bad.size() - headerSize);
+		mie::fixed_base_file_local::set64((uint8_t*)&bad[56], sum);
+		{
+			std::ofstream ofs(badPath.c_str(), std::ios::binary);
+			ofs.write(bad.data(), bad.size());
+		}
+		CYBOZU_TEST_EXCEPTION(FixedBaseFile f(badPath), cybozu::Exception);
+		// verifyChecksum = false trusts the file
+		FixedBaseFile f(badPath, false);
+		CYBOZU_TEST_EQUAL(f.size(), n);
+	}
+#ifdef NEW_FP_T
+	// the entries are in the Montgomery form(secp256k1 does not use it)
+	{
+		// y^2 = x^3 + 2 for a BN prime and G = (-1, 1)
+		const char *p2 = "0x2523648240000001ba344d80000000086121000000000013a700000000000013";
+		Fp_4::setModulo(p2);
+		Ec::setParam("0", "2");
+		if (Fp_4::getOp().useMont) {
+			FixedBase fb2(Ec(Fp_4(-1), Fp_4(1)), 0, 4);
+			const FixedBase *pfb2 = &fb2;
+			FixedBaseFile::save(badPath, &pfb2, 1);
+			{
+				FixedBaseFile f(badPath);
+				Ec Q, R;
+				f.get(0).mul(Q, 12345);
+				Ec::power(R, fb2.getBase(), 12345);
+				CYBOZU_TEST_EQUAL(Q, R);
+			}
+			Fp_4::setModulo(p2, false);
+			Ec::setParam("0", "2");
+			CYBOZU_TEST_EXCEPTION(FixedBaseFile f(badPath), cybozu::Exception);
+		}
+		Fp_4::setModulo(para.p);
+		Ec::setParam(para.a, para.b);
+	}
+#endif
+	// another curve
+	Ec::setParam("1", "2");
+	CYBOZU_TEST_EXCEPTION(FixedBaseFile f(path), cybozu::Exception);
+	Ec::setParam(para.a, para.b);
+	// tables of different w
+	fb[1].init(G, 0, 4);
+	CYBOZU_TEST_EXCEPTION(FixedBaseFile::save(path, pfb, n), cybozu::Exception);
+	remove(path);
+	remove(badPath.c_str());
+}
+
 int main(int argc, char *argv[])
 {
 	if (argc == 1) {
@@ -430,3 +1118,30 @@ int main(int argc, char *argv[])
 	}
 	return cybozu::test::autoRun.run(argc, argv);
 }
+
+#ifdef NEW_FP_T
+CYBOZU_TEST_AUTO(powerVecZnCtx)
+{
+	typedef mie::EcT<Fp_4> Ec;
+	typedef mie::FieldCtxT<tagZn> ZnCtx;
+	const mie::EcParam& para = mie::ecparam::secp256k1;
+	Fp_4::setModulo(para.p);
+	Ec::setParam(para.a, para.b);
+	// threads of powerVec do not see ctx, which differs from the default context of Zn
+	Zn::setModulo(para.p);
+	ZnCtx ctx(para.n);
+	const Ec P(Fp_4(para.gx), Fp_4(para.gy));
+	const Ec Pv[] = { P, P, P, P, P + P };
+	ZnCtx::Scope scope(ctx);
+	Zn k[5];
+	for (size_t i = 0; i < 5; i++) {
+		k[i] = Zn("0x123456789abcdef0123456789abcdef") * int(i + 1);
+	}
+	Ec out[5], R;
+	Ec::powerVec(out, Pv, k, 5, 3);
+	for (size_t i = 0; i < 5; i++) {
+		Ec::power(R, Pv[i], k[i]);
+		CYBOZU_TEST_EQUAL(out[i], R);
+	}
+}
+#endif
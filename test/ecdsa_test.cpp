@@ -0,0 +1,184 @@
+#include <cybozu/test.hpp>
+#include <cybozu/benchmark.hpp>
+#include <cybozu/random_generator.hpp>
+#include <mie/fp.hpp>
+#include <mie/gmp_util.hpp>
+#include <mie/ecdsa.hpp>
+#include <mie/ecparam.hpp>
+
+typedef mie::FpT<mie::Gmp> Fp;
+struct tagZn;
+typedef mie::FpT<mie::Gmp, tagZn> Zn;
+typedef mie::EcT<Fp> Ec;
+typedef mie::EcdsaT<Fp, Zn> Ecdsa;
+
+cybozu::RandomGenerator rg;
+
+void initCurve(const mie::EcParam& para, bool useGlv)
+{
+	Fp::setModulo(para.p);
+	Zn::setModulo(para.n);
+	Ec::setParam(para.a, para.b);
+	const mie::EcGlvParam *glv = mie::getEcGlvParam(para.name);
+	if (useGlv && glv) Ec::setGlv(glv->beta, glv->lambda, para.n, Ec(Fp(para.gx), Fp(para.gy)));
+}
+
+void testSignVerify(const Ecdsa& ecdsa)
+{
+	for (int i = 0; i < 20; i++) {
+		Zn sec, h;
+		Ec Q;
+		sec.setRand(rg);
+		h.setRand(rg);
+		ecdsa.getPublicKey(Q, sec);
+		Ecdsa::Signature sig;
+		ecdsa.sign(sig, sec, h, rg);
+		CYBOZU_TEST_ASSERT(ecdsa.verify(sig, Q, h));
+		CYBOZU_TEST_ASSERT(!ecdsa.verify(sig, Q, h + 1));
+		CYBOZU_TEST_ASSERT(!ecdsa.verify(sig, Q + ecdsa.getBase(), h));
+		Ecdsa::Signature bad = sig;
+		bad.r += 1;
+		CYBOZU_TEST_ASSERT(!ecdsa.verify(bad, Q, h));
+		bad = sig;
+		bad.s += 1;
+		CYBOZU_TEST_ASSERT(!ecdsa.verify(bad, Q, h));
+		bad.s = 0;
+		CYBOZU_TEST_ASSERT(!ecdsa.verify(bad, Q, h));
+		// (r, -s) is also valid
+		bad = sig;
+		Zn::neg(bad.s, bad.s);
+		CYBOZU_TEST_ASSERT(ecdsa.verify(bad, Q, h));
+		CYBOZU_TEST_ASSERT(!ecdsa.verify(sig, Ec(), h));
+	}
+}
+
+void testMulAdd(const Ecdsa& ecdsa)
+{
+	const Ec& G = ecdsa.getBase();
+	Ec Q, R, S, T;
+	for (int i = 0; i < 20; i++) {
+		Zn a, b, c;
+		a.setRand(rg);
+		b.setRand(rg);
+		c.setRand(rg);
+		Ec::power(Q, G, c);
+		ecdsa.mulAdd(R, a, Q, b);
+		Ec::power(S, G, a);
+		Ec::power(T, Q, b);
+		S += T;
+		CYBOZU_TEST_EQUAL(R, S);
+	}
+	const Zn tbl[] = { 0, 1, 2, -1, -2 };
+	Ec::power(Q, G, Zn(12345));
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		for (size_t j = 0; j < CYBOZU_NUM_OF_ARRAY(tbl); j++) {
+			ecdsa.mulAdd(R, tbl[i], Q, tbl[j]);
+			Ec::power(S, G, tbl[i]);
+			Ec::power(T, Q, tbl[j]);
+			S += T;
+			CYBOZU_TEST_EQUAL(R, S);
+		}
+	}
+	// Q = -G makes zero
+	Ec::neg(Q, G);
+	ecdsa.mulAdd(R, 5, Q, 5);
+	CYBOZU_TEST_ASSERT(R.isZero());
+	ecdsa.mulAdd(R, 3, Ec(), 5);
+	Ec::power(S, G, 3);
+	CYBOZU_TEST_EQUAL(R, S);
+}
+
+void bench(const Ecdsa& ecdsa)
+{
+	Zn sec, h, k;
+	Ec Q;
+	sec.setRand(rg);
+	h.setRand(rg);
+	k.setRand(rg);
+	ecdsa.getPublicKey(Q, sec);
+	Ecdsa::Signature sig;
+	ecdsa.sign(sig, sec, h, rg);
+	Ec R;
+	CYBOZU_BENCH("pow   ", Ec::power, R, Q, k);
+	CYBOZU_BENCH("sign  ", ecdsa.signWithNonce, sig, sec, h, k);
+	CYBOZU_BENCH("verify", ecdsa.verify, sig, Q, h);
+}
+
+CYBOZU_TEST_AUTO(ecdsa)
+{
+	const mie::EcParam *tbl[] = {
+		&mie::ecparam::secp160k1,
+		&mie::ecparam::secp192k1,
+		&mie::ecparam::secp256k1,
+		&mie::ecparam::NIST_P192,
+		&mie::ecparam::NIST_P256,
+		&mie::ecparam::NIST_P384,
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		const mie::EcParam& para = *tbl[i];
+		for (int useGlv = 0; useGlv < 2; useGlv++) {
+			if (useGlv && mie::getEcGlvParam(para.name) == 0) continue;
+			printf("%s glv=%d\n", para.name, useGlv);
+			initCurve(para, useGlv != 0);
+			const Ec G(Fp(para.gx), Fp(para.gy));
+			Ecdsa ecdsa(G, para.n);
+			testSignVerify(ecdsa);
+			testMulAdd(ecdsa);
+			for (int w = 2; w <= Ecdsa::maxW; w += 3) {
+				ecdsa.init(G, para.n, w);
+				testSignVerify(ecdsa);
+			}
+#ifdef NDEBUG
+			ecdsa.init(G, para.n);
+			bench(ecdsa);
+#endif
+		}
+	}
+}
+
+CYBOZU_TEST_AUTO(badParam)
+{
+	const mie::EcParam& para = mie::ecparam::NIST_P256;
+	initCurve(para, false);
+	const Ec G(Fp(para.gx), Fp(para.gy));
+	Ecdsa ecdsa;
+	CYBOZU_TEST_EXCEPTION(ecdsa.init(G, para.n, 1), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(ecdsa.init(G, para.n, Ecdsa::maxW + 1), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(ecdsa.init(Ec(), para.n), cybozu::Exception);
+}
+
+/*
+	RFC 6979 A.2.5 ECDSA P-256 with SHA-256 and the message "sample"
+*/
+CYBOZU_TEST_AUTO(rfc6979)
+{
+	const mie::EcParam& para = mie::ecparam::NIST_P256;
+	initCurve(para, false);
+	const Ec G(Fp(para.gx), Fp(para.gy));
+	Ecdsa ecdsa(G, para.n);
+	const Zn sec("0xC9AFA9D845BA75166B5C215767B1D6934E50C3DB36E89B127B8A622B120F6721");
+	const Ec Q(Fp("0x60FED4BA255A9D31C961EB74C6356D68C049B8923B61FA6CE669622E60F29FB6"), Fp("0x7903FE1008B8BC99A41AE9E95628BC64F2F1B20C2D7E9F5177A3C294D4462299"));
+	Ec P;
+	ecdsa.getPublicKey(P, sec);
+	CYBOZU_TEST_EQUAL(P, Q);
+	// SHA-256("sample")
+	const uint8_t md[] = {
+		0xaf, 0x2b, 0xdb, 0xe1, 0xaa, 0x9b, 0x6e, 0xc1, 0xe2, 0xad, 0xe1, 0xd6, 0x94, 0xf4, 0x1f, 0xc7,
+		0x1a, 0x83, 0x1d, 0x02, 0x68, 0xe9, 0x89, 0x15, 0x62, 0x11, 0x3d, 0x8a, 0x62, 0xad, 0xd1, 0xbf,
+	};
+	Zn h;
+	ecdsa.hashToZn(h, md, sizeof(md));
+	CYBOZU_TEST_EQUAL(h, Zn("0xAF2BDBE1AA9B6EC1E2ADE1D694F41FC71A831D0268E9891562113D8A62ADD1BF"));
+	const Zn k("0xA6E3C57DD01ABE90086538398355DD4C3B17AA873382B0F24D6129493D8AAD60");
+	Ecdsa::Signature sig;
+	CYBOZU_TEST_ASSERT(ecdsa.signWithNonce(sig, sec, h, k));
+	CYBOZU_TEST_EQUAL(sig.r, Zn("0xEFD48B2AACB6A8FD1140DD9CD45E81D69D2C877B56AAF991C34D0EA84EAF3716"));
+	CYBOZU_TEST_EQUAL(sig.s, Zn("0xF7CB1C942D657C41D436C7A1B6E29F65F3E900DBB9AFF4064DC4AB2F843ACDA8"));
+	CYBOZU_TEST_ASSERT(ecdsa.verify(sig, Q, h));
+	// a longer digest uses the leftmost bits
+	uint8_t md2[sizeof(md) + 2] = {};
+	memcpy(md2, md, sizeof(md));
+	Zn h2;
+	ecdsa.hashToZn(h2, md2, sizeof(md2));
+	CYBOZU_TEST_EQUAL(h, h2);
+}
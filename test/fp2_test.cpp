@@ -282,6 +282,359 @@ CYBOZU_TEST_AUTO(another)
 	CYBOZU_TEST_EQUAL(a, 1);
 }
 
+struct TagLarge;
+
+CYBOZU_TEST_AUTO(large)
+{
+	typedef mie::FpT<TagLarge, 4096> F;
+	const int bitTbl[] = { 1000, 1024, 2047, 3000, 4096 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(bitTbl); i++) {
+		const int bitLen = bitTbl[i];
+		// p = 2^bitLen - c ; odd
+		const mpz_class mp = (mpz_class(1) << bitLen) - 1 - (mpz_class(12345) << (bitLen / 2)) * 2;
+		for (int useMont = 0; useMont < 2; useMont++) {
+			F::setModulo(mp.get_str(), useMont != 0);
+			CYBOZU_TEST_EQUAL(F::getModBitLen(), (size_t)bitLen);
+			const mpz_class mx = mp - 1 - (mpz_class(1) << (bitLen - 3));
+			mpz_class my = (mpz_class(1) << (bitLen - 2)) + 987654321;
+			for (;;) {
+				mpz_class g;
+				mpz_gcd(g.get_mpz_t(), my.get_mpz_t(), mp.get_mpz_t());
+				if (g == 1) break;
+				my++; // p is not prime, so select y invertible
+			}
+			F x, y, z;
+			x.fromGmp(mx);
+			y.fromGmp(my);
+			mpz_class mz;
+			z = x + y;
+			z.toGmp(mz);
+			CYBOZU_TEST_EQUAL(mz, (mx + my) % mp);
+			z = x - y;
+			z.toGmp(mz);
+			CYBOZU_TEST_EQUAL(mz, (mx - my) % mp);
+			z = -x;
+			z.toGmp(mz);
+			CYBOZU_TEST_EQUAL(mz, mp - mx);
+			z = x * y;
+			z.toGmp(mz);
+			CYBOZU_TEST_EQUAL(mz, (mx * my) % mp);
+			F::square(z, x);
+			z.toGmp(mz);
+			CYBOZU_TEST_EQUAL(mz, (mx * mx) % mp);
+			F::inv(z, y);
+			CYBOZU_TEST_EQUAL(z * y, 1);
+			F::power(z, x, mpz_class(65537));
+			z.toGmp(mz);
+			mpz_class e;
+			mie::Gmp::powMod(e, mx, 65537, mp);
+			CYBOZU_TEST_EQUAL(mz, e);
+		}
+	}
+}
+
+struct TagMul8;
+
+CYBOZU_TEST_AUTO(mul8)
+{
+	typedef mie::FpT<TagMul8> F;
+	const char *pTbl[] = {
+		"65537",
+		"0x2523648240000001ba344d80000000086121000000000013a700000000000013",
+		"0x1ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff",
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(pTbl); i++) {
+		for (int useMont = 0; useMont < 2; useMont++) {
+			F::setModulo(pTbl[i], useMont != 0);
+			F x[8], y[8], z[8];
+			for (int k = 0; k < 8; k++) {
+				x[k] = F(-1) - F(k * 12345);
+				y[k] = x[k] * F(k + 3) + F(99);
+			}
+			x[1] = 0;
+			std::vector<uint64_t> ix(F::getIfma8Size()), iy(F::getIfma8Size());
+			F::toIfma8(&ix[0], x);
+			F::toIfma8(&iy[0], y);
+			F::fromIfma8(z, &ix[0]);
+			for (int k = 0; k < 8; k++) {
+				CYBOZU_TEST_EQUAL(z[k], x[k]);
+			}
+			F::mul8(&ix[0], &ix[0], &iy[0]);
+			F::fromIfma8(z, &ix[0]);
+			for (int k = 0; k < 8; k++) {
+				CYBOZU_TEST_EQUAL(z[k], x[k] * y[k]);
+			}
+		}
+	}
+}
+
+struct TagInvVec;
+
+CYBOZU_TEST_AUTO(invVec)
+{
+	typedef mie::FpT<TagInvVec> F;
+	const char *pTbl[] = {
+		"65537",
+		"0x2523648240000001ba344d80000000086121000000000013a700000000000013",
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(pTbl); i++) {
+		for (int useMont = 0; useMont < 2; useMont++) {
+			F::setModulo(pTbl[i], useMont != 0);
+			CYBOZU_TEST_ASSERT(F(1).isOne());
+			CYBOZU_TEST_ASSERT(!F(0).isOne());
+			CYBOZU_TEST_ASSERT(!F(-1).isOne());
+			const size_t n = 9;
+			F x[n], y[n];
+			for (size_t k = 0; k < n; k++) {
+				x[k] = F(-1) - F(int(k) * 12345);
+			}
+			x[0] = 0;
+			x[4] = 0;
+			F::invVec(y, x, n);
+			for (size_t k = 0; k < n; k++) {
+				if (x[k].isZero()) {
+					CYBOZU_TEST_ASSERT(y[k].isZero());
+				} else {
+					CYBOZU_TEST_EQUAL(x[k] * y[k], 1);
+					CYBOZU_TEST_ASSERT((x[k] * y[k]).isOne());
+				}
+			}
+			F::invVec(x, x, n);
+			for (size_t k = 0; k < n; k++) {
+				CYBOZU_TEST_EQUAL(x[k], y[k]);
+			}
+			for (size_t k = 0; k < n; k++) {
+				x[k] = 0;
+			}
+			F::invVec(y, x, n);
+			for (size_t k = 0; k < n; k++) {
+				CYBOZU_TEST_ASSERT(y[k].isZero());
+			}
+		}
+	}
+}
+
+struct TagSafegcd;
+
+CYBOZU_TEST_AUTO(safegcd)
+{
+	typedef mie::FpT<TagSafegcd> F;
+	const char *pTbl[] = {
+		"65537",
+		"0x2523648240000001ba344d80000000086121000000000013a700000000000013",
+		"0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f",
+		"0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffeffffffff0000000000000000ffffffff",
+		"0x1ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff",
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(pTbl); i++) {
+		for (int useMont = 0; useMont < 2; useMont++) {
+			const size_t n = 30;
+			F x[n], y[n];
+			F::setModulo(pTbl[i], useMont != 0, 0, false);
+			x[0] = 1;
+			x[1] = -1;
+			x[2] = 2;
+			for (size_t k = 3; k < n; k++) {
+				x[k] = x[k - 1] * x[k - 1] + F(int(k));
+			}
+			for (size_t k = 0; k < n; k++) {
+				F::inv(y[k], x[k]);
+				// invCT is available without useSafegcd
+				F z;
+				F::invCT(z, x[k]);
+				CYBOZU_TEST_EQUAL(z, y[k]);
+			}
+			F::setModulo(pTbl[i], useMont != 0, 0, true);
+			for (size_t k = 0; k < n; k++) {
+				F z;
+				F::inv(z, x[k]);
+				CYBOZU_TEST_EQUAL(z, y[k]);
+				CYBOZU_TEST_EQUAL(z * x[k], 1);
+			}
+			F z;
+			F::inv(z, 0);
+			CYBOZU_TEST_ASSERT(z.isZero());
+		}
+	}
+}
+
+struct TagPM;
+
+CYBOZU_TEST_AUTO(specialPrime)
+{
+	typedef mie::FpT<TagPM> F;
+	const struct {
+		const char *p;
+		mie::fp::PrimeType type;
+	} tbl[] = {
+		{ "0x10000000000000000000000000000000000000007", mie::fp::PrimePseudoMersenne }, // p160_1
+		{ "0xfffffffffffffffffffffffffffffffeffffac73", mie::fp::PrimePseudoMersenne }, // secp160k1
+		{ "0xfffffffffffffffffffffffffffffffffffffffffffffffeffffe56d", mie::fp::PrimePseudoMersenne }, // secp224k1
+		{ "0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f", mie::fp::PrimePseudoMersenne }, // secp256k1
+		{ "0xffffffffffffffffffffffffffffffff000000000000000000000001", mie::fp::PrimeSolinas }, // P-224
+		{ "0xffffffff00000001000000000000000000000000ffffffffffffffffffffffff", mie::fp::PrimeSolinas }, // P-256
+		{ "0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffeffffffff0000000000000000ffffffff", mie::fp::PrimeSolinas }, // P-384
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		const char *pStr = tbl[i].p;
+		const mpz_class mp(pStr);
+		F::setModulo(pStr);
+		CYBOZU_TEST_EQUAL(F::getOp().primeForm.type, tbl[i].type);
+		CYBOZU_TEST_ASSERT(!F::getOp().useMont);
+		mpz_class a = 3, b = mp - 2;
+		F x = 3, y = -2;
+		for (int k = 0; k < 100; k++) {
+			F z;
+			mpz_class t;
+			F::mul(z, x, y);
+			z.toGmp(t);
+			CYBOZU_TEST_EQUAL(t, (a * b) % mp);
+			F::square(z, x);
+			z.toGmp(t);
+			CYBOZU_TEST_EQUAL(t, (a * a) % mp);
+			F::inv(z, x);
+			CYBOZU_TEST_EQUAL(z * x, 1);
+			a = (a * a + b) % mp;
+			b = (a * b + 1) % mp;
+			x = x * x + y;
+			y = x * y + 1;
+		}
+		F::setModulo(pStr, false);
+		CYBOZU_TEST_EQUAL(F::getOp().primeForm.type, mie::fp::PrimeGeneric);
+	}
+}
+
+struct TagShare1;
+struct TagShare2;
+
+CYBOZU_TEST_AUTO(sharedJit)
+{
+	typedef mie::FpT<TagShare1> F1;
+	typedef mie::FpT<TagShare2> F2;
+	const char *pStr = "0x2523648240000001ba344d80000000086121000000000013a700000000000013";
+	F1::setModulo(pStr);
+	const size_t n = mie::FpGeneratorCache::size();
+	F2::setModulo(pStr);
+	F1::setModulo(pStr);
+	CYBOZU_TEST_EQUAL(mie::FpGeneratorCache::size(), n);
+	CYBOZU_TEST_ASSERT(F1::getOp().mul == F2::getOp().mul);
+	CYBOZU_TEST_EQUAL(F1(3) * F1(5), F1(15));
+	CYBOZU_TEST_EQUAL(F2(3) * F2(5), F2(15));
+}
+
+struct TagCtx;
+
+CYBOZU_TEST_AUTO(fieldCtx)
+{
+	typedef mie::FpT<TagCtx> F;
+	typedef mie::FieldCtxT<TagCtx> FieldCtx;
+	const struct {
+		const char *p;
+		bool useMont;
+	} tbl[] = {
+		{ "0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f", true }, // secp256k1
+		{ "0xffffffff00000001000000000000000000000000ffffffffffffffffffffffff", true }, // P-256
+		{ "0x2523648240000001ba344d80000000086121000000000013a700000000000013", true },
+		{ "0x2523648240000001ba344d80000000086121000000000013a700000000000013", false },
+		{ "0xfffffffffffffffffffffffffffffffeffffffffffffffff", true }, // P-192
+	};
+	const size_t n = CYBOZU_NUM_OF_ARRAY(tbl);
+	F::setModulo("65537");
+	FieldCtx ctx[n];
+	for (size_t i = 0; i < n; i++) {
+		ctx[i].setModulo(tbl[i].p, tbl[i].useMont);
+	}
+	// setModulo of ctx does not change the default
+	CYBOZU_TEST_EQUAL(F::getOp().mp, 65537);
+	CYBOZU_TEST_EQUAL(F(300) * F(300), F(90000 % 65537));
+	for (size_t i = 0; i < n; i++) {
+		FieldCtx::Scope scope(ctx[i]);
+		const mpz_class mp(tbl[i].p + 2, 16);
+		CYBOZU_TEST_EQUAL(F::getOp().mp, mp);
+		const mpz_class mx = mp - 12345, my = mp / 3;
+		F x, y, z;
+		x.fromGmp(mx);
+		y.fromGmp(my);
+		mpz_class mz;
+		F::mul(z, x, y);
+		z.toGmp(mz);
+		CYBOZU_TEST_EQUAL(mz, (mx * my) % mp);
+		F::inv(z, x);
+		z *= x;
+		CYBOZU_TEST_EQUAL(z, 1);
+		F::square(z, y);
+		CYBOZU_TEST_ASSERT(F::squareRoot(z, z));
+		CYBOZU_TEST_ASSERT(z == y || z == -y);
+		{
+			const size_t j = (i + 1) % n;
+			FieldCtx::Scope scope2(ctx[j]);
+			CYBOZU_TEST_EQUAL(F::getOp().mp, mpz_class(tbl[j].p + 2, 16));
+			CYBOZU_TEST_EQUAL(F(3) * F(5), F(15));
+		}
+		CYBOZU_TEST_EQUAL(F::getOp().mp, mp);
+		F::mul(z, x, y);
+		z.toGmp(mz);
+		CYBOZU_TEST_EQUAL(mz, (mx * my) % mp);
+	}
+	CYBOZU_TEST_EQUAL(F::getOp().mp, 65537);
+	CYBOZU_TEST_EQUAL(F(300) * F(300), F(90000 % 65537));
+	FieldCtx noInit;
+	CYBOZU_TEST_EXCEPTION(FieldCtx::Scope scope(noInit), cybozu::Exception);
+}
+
+struct TagDbl;
+
+CYBOZU_TEST_AUTO(FpDbl)
+{
+	typedef mie::FpT<TagDbl> F;
+	typedef mie::FpDblT<TagDbl> FD;
+	const char *pTbl[] = {
+		"65537",
+		"0x2523648240000001ba344d80000000086121000000000013a700000000000013",
+		"0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f",
+		"0xffffffff00000001000000000000000000000000ffffffffffffffffffffffff",
+		"0x1ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff",
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(pTbl); i++) {
+		for (int useMont = 0; useMont < 2; useMont++) {
+			F::setModulo(pTbl[i], useMont != 0);
+			F x[3];
+			x[0] = -1;
+			x[1] = -2;
+			x[2] = 12345;
+			for (int k = 0; k < 10; k++) {
+				FD s, t;
+				F z;
+				FD::mulPre(s, x[0], x[1]);
+				FD::mod(z, s);
+				CYBOZU_TEST_EQUAL(z, x[0] * x[1]);
+				FD::sqrPre(t, x[2]);
+				FD::mod(z, t);
+				CYBOZU_TEST_EQUAL(z, x[2] * x[2]);
+				FD::add(s, s, t);
+				FD::mod(z, s);
+				CYBOZU_TEST_EQUAL(z, x[0] * x[1] + x[2] * x[2]);
+				FD::sub(s, t, s);
+				FD::mod(z, s);
+				CYBOZU_TEST_EQUAL(z, -(x[0] * x[1]));
+				FD::mulPre(s, x[0], F(0));
+				t.clear();
+				CYBOZU_TEST_ASSERT(s == t);
+				if (F::getSpareBitN() > 0) {
+					FD::mulPre(s, x[0], x[0]);
+					FD::mulPre(t, x[1], x[1]);
+					FD::addPre(s, s, t);
+					FD::mod(z, s);
+					CYBOZU_TEST_EQUAL(z, x[0] * x[0] + x[1] * x[1]);
+				}
+				for (int j = 0; j < 3; j++) {
+					x[j] = x[j] * x[j] + F(j + 1);
+				}
+			}
+		}
+	}
+}
+
 
 CYBOZU_TEST_AUTO(setRaw)
 {
@@ -409,6 +762,36 @@ CYBOZU_TEST_AUTO(binaryRepl)
 		CYBOZU_TEST_EQUAL(x, y);
 	}
 }
+
+CYBOZU_TEST_AUTO(serialize)
+{
+	Fp::setModulo("0xfffffffffffffffffffffffe26f2fc170f69466a74defd8d");
+	CYBOZU_TEST_EQUAL(Fp::getByteSize(), 24u);
+	const char *tbl[] = {
+		"0", "1", "0x1234", "0xaabbccdd12345678", "0xfffffffffffffffffffffffe26f2fc170f69466a74defd8c",
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		const Fp x(tbl[i]);
+		uint8_t buf[32];
+		CYBOZU_TEST_EQUAL(x.serialize(buf, sizeof(buf)), 24u);
+		std::string str;
+		for (size_t j = 0; j < 24; j++) {
+			char s[3];
+			snprintf(s, sizeof(s), "%02x", buf[j]);
+			str += s;
+		}
+		CYBOZU_TEST_EQUAL(Fp("0x" + str), x);
+		Fp y;
+		CYBOZU_TEST_EQUAL(y.deserialize(buf, 24), 24u);
+		CYBOZU_TEST_EQUAL(x, y);
+		CYBOZU_TEST_EXCEPTION(x.serialize(buf, 23), cybozu::Exception);
+		CYBOZU_TEST_EXCEPTION(y.deserialize(buf, 23), cybozu::Exception);
+	}
+	uint8_t buf[24];
+	memset(buf, 0xff, sizeof(buf));
+	Fp y;
+	CYBOZU_TEST_EXCEPTION(y.deserialize(buf, sizeof(buf)), cybozu::Exception);
+}
 #endif
 
 #ifdef NDEBUG
@@ -5,8 +5,10 @@
 #include <mie/gmp_util.hpp>
 #include <stdint.h>
 #include <string>
+#include <vector>
 #include <cybozu/itoa.hpp>
 #include <mie/fp_generator.hpp>
+#include <mie/fp_base.hpp>
 #include <mie/fp.hpp>
 #include <iostream>
 #include <cybozu/xorshift.hpp>
@@ -14,13 +16,15 @@
 
 typedef mie::FpT<mie::Gmp> Fp;
 
-const int MAX_N = 4;
+const int MAX_N = 9;
 
 const char *primeTable[] = {
 	"7fffffffffffffffffffffffffffffff", // 127bit(not full)
 	"ffffffffffffffffffffffffffffff61", // 128bit(full)
 	"fffffffffffffffffffffffffffffffffffffffeffffee37", // 192bit(full)
 	"2523648240000001ba344d80000000086121000000000013a700000000000013", // 254bit(not full)
+	"fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffeffffffff0000000000000000ffffffff", // 384bit(full)
+	"1ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff", // 521bit(not full)
 };
 
 /*
@@ -195,6 +199,302 @@ void testShr1(const mie::FpGenerator& fg, int pn)
 	}
 }
 
+void testSqr(const mie::FpGenerator& fg, int pn)
+{
+	if (fg.sqr_ == 0) {
+		puts("skip sqr");
+		return;
+	}
+	cybozu::XorShift rg;
+	uint64_t x[MAX_N], y[MAX_N], z[MAX_N];
+	for (int i = 0; i < 100; i++) {
+		if (i == 0) {
+			// x = p - 1
+			std::copy(fg.p_, fg.p_ + pn, x);
+			x[0]--;
+		} else {
+			rg.read(x, pn);
+			x[pn - 1] &= fg.p_[pn - 1] >> 1; // x < p
+		}
+		fg.mul_(y, x, x);
+		fg.sqr_(z, x);
+		CYBOZU_TEST_EQUAL_ARRAY(z, y, pn);
+		fg.sqr_(x, x);
+		CYBOZU_TEST_EQUAL_ARRAY(x, y, pn);
+	}
+	CYBOZU_BENCH_C("sqr", 1000000, fg.sqr_, z, z);
+}
+
+uint64_t getDigit52(const mpz_class& x, int j)
+{
+	const mpz_class mask = (mpz_class(1) << 52) - 1;
+	mpz_class t = (x >> (j * 52)) & mask;
+	return t == 0 ? 0 : mie::Gmp::getBlock(t)[0];
+}
+
+/*
+	z[k] = x[k] * y[k] / 2^(52 * n52) mod p
+*/
+void testMul8(const mie::FpGenerator& fg, const char *pStr)
+{
+	if (fg.mul8_ == 0) {
+		puts("skip mul8");
+		return;
+	}
+	const mpz_class mp(pStr, 16);
+	const int n52 = fg.n52_;
+	mpz_class invR = mpz_class(1) << (n52 * 52);
+	mpz_invert(invR.get_mpz_t(), invR.get_mpz_t(), mp.get_mpz_t());
+	cybozu::XorShift rg;
+	std::vector<uint64_t> x(n52 * 8), y(n52 * 8), z(n52 * 8);
+	for (int i = 0; i < 30; i++) {
+		mpz_class mx[8], my[8];
+		for (int k = 0; k < 8; k++) {
+			uint64_t buf[MAX_N * 2];
+			rg.read(buf, MAX_N * 2);
+			mie::Gmp::setRaw(mx[k], buf, MAX_N);
+			mie::Gmp::setRaw(my[k], buf + MAX_N, MAX_N);
+			mx[k] %= mp;
+			my[k] %= mp;
+		}
+		mx[0] = 0;
+		my[1] = mp - 1;
+		mx[2] = mp - 1;
+		my[2] = mp - 1;
+		for (int j = 0; j < n52; j++) {
+			for (int k = 0; k < 8; k++) {
+				x[j * 8 + k] = getDigit52(mx[k], j);
+				y[j * 8 + k] = getDigit52(my[k], j);
+			}
+		}
+		fg.mul8_(&z[0], &x[0], &y[0]);
+		for (int k = 0; k < 8; k++) {
+			mpz_class mz = 0;
+			for (int j = n52 - 1; j >= 0; j--) {
+				CYBOZU_TEST_ASSERT(z[j * 8 + k] < (uint64_t(1) << 52));
+				mpz_class t;
+				mie::Gmp::set(t, z[j * 8 + k]);
+				mz = (mz << 52) + t;
+			}
+			CYBOZU_TEST_EQUAL(mz, (mx[k] * my[k] * invR) % mp);
+		}
+	}
+	CYBOZU_BENCH_C("mul8", 1000000, fg.mul8_, &z[0], &x[0], &y[0]);
+}
+
+/*
+	reference of divsteps62 with branches
+*/
+int64_t divstepsRef(int64_t delta, uint64_t f, uint64_t g, int64_t *t)
+{
+	int64_t u = 1, v = 0, q = 0, r = 1;
+	for (int i = 0; i < 62; i++) {
+		if (delta > 0 && (g & 1)) {
+			delta = 1 - delta;
+			const uint64_t tf = f;
+			const int64_t tu = u, tv = v;
+			f = g;
+			g = (g - tf) >> 1;
+			u = q * 2;
+			v = r * 2;
+			q -= tu;
+			r -= tv;
+		} else if (g & 1) {
+			delta++;
+			g = (g + f) >> 1;
+			q += u;
+			r += v;
+			u *= 2;
+			v *= 2;
+		} else {
+			delta++;
+			g >>= 1;
+			u *= 2;
+			v *= 2;
+		}
+	}
+	t[0] = u;
+	t[1] = v;
+	t[2] = q;
+	t[3] = r;
+	return delta;
+}
+
+void testDivsteps(const mie::FpGenerator& fg)
+{
+	cybozu::XorShift rg;
+	for (int i = 0; i < 1000; i++) {
+		uint64_t f = rg.get64() | 1;
+		uint64_t g = rg.get64();
+		int64_t delta = int64_t(rg.get32() % 200) - 100;
+		if (i == 0) g = 0;
+		if (i == 1) delta = 1;
+		int64_t t[4], s[4];
+		const int64_t d1 = fg.divsteps_(delta, f, g, t);
+		const int64_t d2 = divstepsRef(delta, f, g, s);
+		CYBOZU_TEST_EQUAL(d1, d2);
+		CYBOZU_TEST_EQUAL_ARRAY(t, s, 4);
+		// u f + v g = 0, q f + r g = 0 mod 2^62
+		const uint64_t mask = (uint64_t(1) << 62) - 1;
+		CYBOZU_TEST_EQUAL((uint64_t(t[0]) * f + uint64_t(t[1]) * g) & mask, 0u);
+		CYBOZU_TEST_EQUAL((uint64_t(t[2]) * f + uint64_t(t[3]) * g) & mask, 0u);
+	}
+}
+
+mpz_class getMpz(const uint64_t *x, int n)
+{
+	mpz_class z;
+	mie::Gmp::setRaw(z, x, n);
+	return z;
+}
+
+void testMulPre(const mie::FpGenerator& fg, int pn)
+{
+	const mpz_class mp = getMpz(fg.p_, pn);
+	const mpz_class R = mpz_class(1) << (pn * 64);
+	mpz_class invR;
+	mpz_invert(invR.get_mpz_t(), R.get_mpz_t(), mp.get_mpz_t());
+	cybozu::XorShift rg;
+	uint64_t x[MAX_N], y[MAX_N], xy[MAX_N * 2], z[MAX_N];
+	for (int i = 0; i < 100; i++) {
+		rg.read(x, pn);
+		rg.read(y, pn);
+		if (i == 0) {
+			std::fill(x, x + pn, uint64_t(-1));
+			std::fill(y, y + pn, uint64_t(-1));
+		}
+		const mpz_class mx = getMpz(x, pn);
+		const mpz_class my = getMpz(y, pn);
+		fg.mulPre_(xy, x, y);
+		CYBOZU_TEST_EQUAL(getMpz(xy, pn * 2), mx * my);
+		fg.sqrPre_(xy, x);
+		CYBOZU_TEST_EQUAL(getMpz(xy, pn * 2), mx * mx);
+		// xy < pR
+		mpz_class t = (mx * my) % (mp * R);
+		if (i == 1) t = mp * R - 1;
+		mie::Gmp::getRaw(xy, pn * 2, t);
+		fg.montRed_(z, xy);
+		CYBOZU_TEST_EQUAL(getMpz(z, pn), (t * invR) % mp);
+	}
+	CYBOZU_BENCH_C("mulPre", 1000000, fg.mulPre_, xy, x, y);
+	CYBOZU_BENCH_C("sqrPre", 1000000, fg.sqrPre_, xy, x);
+	CYBOZU_BENCH_C("montRed", 1000000, fg.montRed_, z, xy);
+}
+
+/*
+	p = 2^k - c
+*/
+void testSpecialPrime(const char *pStr, mie::fp::PrimeType type)
+{
+	const mpz_class mp(pStr, 16);
+	uint64_t p[MAX_N];
+	const int pn = convertToArray(p, mp);
+	const mie::fp::PrimeForm form = mie::fp::local::getPrimeForm(mp);
+	CYBOZU_TEST_EQUAL(form.type, type);
+	if (type == mie::fp::PrimePseudoMersenne) {
+		CYBOZU_TEST_EQUAL((mpz_class(1) << form.k) - mp, mpz_class(cybozu::itoa(form.c)));
+	}
+	mie::FpGenerator fg;
+	fg.init(p, pn, form);
+	CYBOZU_TEST_EQUAL(fg.form_.type, type);
+	CYBOZU_TEST_ASSERT(fg.red_ != 0);
+	CYBOZU_TEST_ASSERT(fg.montRed_ == 0);
+	cybozu::XorShift rg;
+	uint64_t x[MAX_N], y[MAX_N], xy[MAX_N * 2], z[MAX_N];
+	for (int i = 0; i < 1000; i++) {
+		mpz_class mx, my;
+		mie::Gmp::getRand(mx, pn * 64, rg);
+		mie::Gmp::getRand(my, pn * 64, rg);
+		mx %= mp;
+		my %= mp;
+		if (i == 0) mx = my = mp - 1;
+		if (i == 1) { mx = mp - 1; my = 1; }
+		mie::Gmp::getRaw(x, pn, mx);
+		mie::Gmp::getRaw(y, pn, my);
+		fg.mul_(z, x, y);
+		CYBOZU_TEST_EQUAL(getMpz(z, pn), (mx * my) % mp);
+		fg.sqr_(z, x);
+		CYBOZU_TEST_EQUAL(getMpz(z, pn), (mx * mx) % mp);
+		// any 2pn-limb value
+		rg.read(xy, pn * 2);
+		if (i == 0) std::fill(xy, xy + pn * 2, uint64_t(-1));
+		if (i == 1) mie::Gmp::getRaw(xy, pn * 2, mp);
+		fg.red_(z, xy);
+		CYBOZU_TEST_EQUAL(getMpz(z, pn), getMpz(xy, pn * 2) % mp);
+	}
+	CYBOZU_BENCH_C("mul", 1000000, fg.mul_, z, x, y);
+	CYBOZU_BENCH_C("sqr", 1000000, fg.sqr_, z, x);
+	CYBOZU_BENCH_C("red", 1000000, fg.red_, z, xy);
+}
+
+CYBOZU_TEST_AUTO(pseudoMersenne)
+{
+	const char *tbl[] = {
+		"7fffffffffffffffffffffffffffffff", // 2^127 - 1
+		"10000000000000000000000000000000000000007", // p160_1 = 2^160 + 7
+		"fffffffffffffffffffffffffffffffeffffac73", // secp160k1
+		"fffffffffffffffffffffffffffffffffffffffeffffee37", // secp192k1
+		"fffffffffffffffffffffffffffffffffffffffffffffffeffffe56d", // secp224k1
+		"fffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f", // secp256k1
+		"1ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff", // 2^521 - 1
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		printf("testPM %s\n", tbl[i]);
+		testSpecialPrime(tbl[i], mie::fp::PrimePseudoMersenne);
+	}
+	// not special
+	CYBOZU_TEST_EQUAL(mie::fp::local::getPrimeForm(mpz_class("2523648240000001ba344d80000000086121000000000013a700000000000013", 16)).type, mie::fp::PrimeGeneric);
+}
+
+CYBOZU_TEST_AUTO(solinas)
+{
+	const char *tbl[] = {
+		"fffffffffffffffffffffffffffffffeffffffffffffffff", // P-192
+		"ffffffffffffffffffffffffffffffff000000000000000000000001", // P-224
+		"ffffffff00000001000000000000000000000000ffffffffffffffffffffffff", // P-256
+		"fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffeffffffff0000000000000000ffffffff", // P-384
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		printf("testSolinas %s\n", tbl[i]);
+		testSpecialPrime(tbl[i], mie::fp::PrimeSolinas);
+	}
+	// 2^k - p is not sparse
+	CYBOZU_TEST_EQUAL(mie::fp::local::getPrimeForm(mpz_class("ffffffffffffffffffffffffffffff61", 16)).type, mie::fp::PrimePseudoMersenne);
+	CYBOZU_TEST_EQUAL(mie::fp::local::getPrimeForm(mpz_class("fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffeffffffff0000000000000000ffffffff", 16)).type, mie::fp::PrimeGeneric);
+}
+
+CYBOZU_TEST_AUTO(cache)
+{
+	mie::fp_gen_local::CodePool pool;
+	uint8_t *a = pool.alloc(100);
+	CYBOZU_TEST_ASSERT(a != 0);
+	pool.shrink(a, 10);
+	uint8_t *b = pool.alloc(64);
+	CYBOZU_TEST_EQUAL((void*)b, (void*)(a + 64));
+	pool.shrink(a, 1); // not the last one
+	CYBOZU_TEST_EQUAL((void*)pool.alloc(1), (void*)(b + 64));
+
+	const char *pStr = "fffffffffffffffffffffffffffffffffffffffffffffffffffffffefffffc2f";
+	const mpz_class mp(pStr, 16);
+	uint64_t p[MAX_N];
+	const int pn = convertToArray(p, mp);
+	const size_t n = mie::FpGeneratorCache::size();
+	const mie::FpGenerator *fg = mie::FpGeneratorCache::get(p, pn);
+	CYBOZU_TEST_EQUAL(mie::FpGeneratorCache::size(), n + 1);
+	CYBOZU_TEST_EQUAL(mie::FpGeneratorCache::get(p, pn), fg);
+	const mie::fp::PrimeForm form = mie::fp::local::getPrimeForm(mp);
+	const mie::FpGenerator *fgPM = mie::FpGeneratorCache::get(p, pn, form);
+	CYBOZU_TEST_ASSERT(fgPM != fg);
+	CYBOZU_TEST_EQUAL(fgPM->form_.type, mie::fp::PrimePseudoMersenne);
+	CYBOZU_TEST_EQUAL(mie::FpGeneratorCache::size(), n + 2);
+	// the generator has its own copy of p
+	std::fill(p, p + pn, 0);
+	uint64_t x[MAX_N] = { 5 }, y[MAX_N] = { 7 }, z[MAX_N];
+	fgPM->mul_(z, x, y);
+	CYBOZU_TEST_EQUAL(getMpz(z, pn), 35);
+	CYBOZU_TEST_EQUAL(getMpz(fg->p_, pn), mp);
+}
+
 void test(const char *pStr)
 {
 	Fp::setModulo(pStr, 16);
@@ -207,6 +507,10 @@ void test(const char *pStr)
 	testNeg(fg, pn);
 	testMulI(fg, pn);
 	testShr1(fg, pn);
+	testSqr(fg, pn);
+	testMul8(fg, pStr);
+	testDivsteps(fg);
+	testMulPre(fg, pn);
 }
 
 CYBOZU_TEST_AUTO(all)
@@ -216,4 +520,73 @@ CYBOZU_TEST_AUTO(all)
 		test(primeTable[i]);
 	}
 }
+
+/*
+	looped kernels for pn > 9
+	compare them with mpz_class
+*/
+void testLarge(int pn, bool isFullBit)
+{
+	printf("testLarge pn=%d isFullBit=%d\n", pn, isFullBit);
+	cybozu::XorShift rg;
+	std::vector<uint64_t> p(pn);
+	rg.read(&p[0], pn);
+	p[0] |= 1;
+	if (isFullBit) {
+		p[pn - 1] |= uint64_t(1) << 63;
+	} else {
+		p[pn - 1] >>= 1;
+	}
+	mpz_class mp;
+	mie::Gmp::setRaw(mp, &p[0], pn);
+	mie::FpGenerator fg;
+	fg.init(&p[0], pn);
+	CYBOZU_TEST_ASSERT(fg.preInv_ == 0);
+	CYBOZU_TEST_ASSERT(fg.divsteps_ != 0);
+	CYBOZU_TEST_ASSERT(fg.mulPre_ == 0 && fg.montRed_ == 0);
+	mpz_class invR = mpz_class(1) << (pn * 64);
+	mpz_invert(invR.get_mpz_t(), invR.get_mpz_t(), mp.get_mpz_t());
+	std::vector<uint64_t> x(pn), y(pn), z(pn);
+	for (int i = 0; i < 10; i++) {
+		mpz_class mx, my, mz;
+		rg.read(&x[0], pn);
+		rg.read(&y[0], pn);
+		mie::Gmp::setRaw(mx, &x[0], pn);
+		mie::Gmp::setRaw(my, &y[0], pn);
+		mx %= mp;
+		my %= mp;
+		if (i == 0) mx = 0;
+		if (i == 1) mx = mp - 1;
+		if (i == 2) my = mp - 1;
+		mie::Gmp::getRaw(&x[0], pn, mx);
+		mie::Gmp::getRaw(&y[0], pn, my);
+
+		fg.add_(&z[0], &x[0], &y[0]);
+		mie::Gmp::setRaw(mz, &z[0], pn);
+		CYBOZU_TEST_EQUAL(mz, (mx + my) % mp);
+		fg.sub_(&z[0], &x[0], &y[0]);
+		mie::Gmp::setRaw(mz, &z[0], pn);
+		CYBOZU_TEST_EQUAL(mz, ((mx - my) % mp + mp) % mp);
+		fg.neg_(&z[0], &x[0]);
+		mie::Gmp::setRaw(mz, &z[0], pn);
+		CYBOZU_TEST_EQUAL(mz, (mp - mx) % mp);
+		fg.mul_(&z[0], &x[0], &y[0]);
+		mie::Gmp::setRaw(mz, &z[0], pn);
+		CYBOZU_TEST_EQUAL(mz, (mx * my * invR) % mp);
+		fg.sqr_(&z[0], &x[0]);
+		mie::Gmp::setRaw(mz, &z[0], pn);
+		CYBOZU_TEST_EQUAL(mz, (mx * mx * invR) % mp);
+	}
+	CYBOZU_BENCH_C("mulLarge", 10000, fg.mul_, &z[0], &z[0], &y[0]);
+	CYBOZU_BENCH_C("sqrLarge", 10000, fg.sqr_, &z[0], &z[0]);
+}
+
+CYBOZU_TEST_AUTO(large)
+{
+	const int tbl[] = { 10, 16, 32, 64 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		testLarge(tbl[i], false);
+		testLarge(tbl[i], true);
+	}
+}
 #endif
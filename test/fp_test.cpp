@@ -221,6 +221,9 @@ CYBOZU_TEST_AUTO(compare)
 		CYBOZU_TEST_ASSERT(x < 10);
 		CYBOZU_TEST_ASSERT(x == 5);
 		CYBOZU_TEST_ASSERT(x > 2);
+		CYBOZU_TEST_ASSERT(!x.isOne());
+		CYBOZU_TEST_ASSERT(Fp(1).isOne());
+		CYBOZU_TEST_ASSERT(!Fp(-1).isOne());
 	}
 }
 
@@ -481,6 +484,36 @@ CYBOZU_TEST_AUTO(binaryRepl)
 		CYBOZU_TEST_EQUAL(x, y);
 	}
 }
+
+CYBOZU_TEST_AUTO(serialize)
+{
+	Fp::setModulo("0xfffffffffffffffffffffffe26f2fc170f69466a74defd8d");
+	CYBOZU_TEST_EQUAL(Fp::getByteSize(), 24u);
+	const char *tbl[] = {
+		"0", "1", "0x1234", "0xaabbccdd12345678", "0xfffffffffffffffffffffffe26f2fc170f69466a74defd8c",
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		const Fp x(tbl[i]);
+		uint8_t buf[32];
+		CYBOZU_TEST_EQUAL(x.serialize(buf, sizeof(buf)), 24u);
+		std::string str;
+		for (size_t j = 0; j < 24; j++) {
+			char s[3];
+			snprintf(s, sizeof(s), "%02x", buf[j]);
+			str += s;
+		}
+		CYBOZU_TEST_EQUAL(Fp("0x" + str), x);
+		Fp y;
+		CYBOZU_TEST_EQUAL(y.deserialize(buf, 24), 24u);
+		CYBOZU_TEST_EQUAL(x, y);
+		CYBOZU_TEST_EXCEPTION(x.serialize(buf, 23), cybozu::Exception);
+		CYBOZU_TEST_EXCEPTION(y.deserialize(buf, 23), cybozu::Exception);
+	}
+	uint8_t buf[24];
+	memset(buf, 0xff, sizeof(buf));
+	Fp y;
+	CYBOZU_TEST_EXCEPTION(y.deserialize(buf, sizeof(buf)), cybozu::Exception);
+}
 #endif
 
 #ifdef NDEBUG
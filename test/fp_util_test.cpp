@@ -189,3 +189,24 @@ CYBOZU_TEST_AUTO(splitBitVec)
 		}
 	}
 }
+
+CYBOZU_TEST_AUTO(bigEndian)
+{
+	const uint32_t x[] = { 0x12345678, 0xaabbccdd, 0x0102 };
+	const uint8_t expect[] = { 0x00, 0x00, 0x01, 0x02, 0xaa, 0xbb, 0xcc, 0xdd, 0x12, 0x34, 0x56, 0x78 };
+	uint8_t buf[sizeof(expect)];
+	mie::fp::toBigEndian(buf, sizeof(buf), x, CYBOZU_NUM_OF_ARRAY(x));
+	CYBOZU_TEST_EQUAL_ARRAY(buf, expect, sizeof(expect));
+	uint32_t y[4];
+	mie::fp::fromBigEndian(y, 4, buf, sizeof(buf));
+	CYBOZU_TEST_EQUAL_ARRAY(y, x, CYBOZU_NUM_OF_ARRAY(x));
+	CYBOZU_TEST_EQUAL(y[3], 0u);
+	// 10 bytes
+	mie::fp::toBigEndian(buf, 10, x, CYBOZU_NUM_OF_ARRAY(x));
+	CYBOZU_TEST_EQUAL_ARRAY(buf, expect + 2, 10);
+	uint64_t z[2];
+	mie::fp::fromBigEndian(z, 2, buf, 10);
+	CYBOZU_TEST_EQUAL(z[0], 0xaabbccdd12345678ull);
+	CYBOZU_TEST_EQUAL(z[1], 0x0102u);
+	CYBOZU_TEST_EXCEPTION(mie::fp::fromBigEndian(y, 2, buf, 10), cybozu::Exception);
+}
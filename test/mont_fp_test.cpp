@@ -145,6 +145,7 @@ struct Test {
 		compare();
 		modulo();
 		ope();
+		invVec();
 		cvtInt();
 		power();
 		neg_power();
@@ -153,6 +154,8 @@ struct Test {
 		set64bit();
 		getRaw();
 		binaryExp();
+		squareRoot();
+		serialize();
 		bench();
 	}
 	void cstr()
@@ -451,6 +454,38 @@ struct Test {
 			CYBOZU_TEST_EQUAL(z, castTo<Fp>(tbl[i].x));
 		}
 	}
+	void invVec()
+	{
+		const int tbl[] = { 3, 0, -5, 1, 0, 12345, -99999 };
+		const size_t n = CYBOZU_NUM_OF_ARRAY(tbl);
+		Fp x[n], y[n];
+		for (size_t i = 0; i < n; i++) {
+			x[i] = tbl[i];
+		}
+		Fp::invVec(y, x, n);
+		for (size_t i = 0; i < n; i++) {
+			if (x[i].isZero()) {
+				CYBOZU_TEST_ASSERT(y[i].isZero());
+			} else {
+				Fp r;
+				Fp::inv(r, x[i]);
+				CYBOZU_TEST_EQUAL(y[i], r);
+				CYBOZU_TEST_ASSERT((x[i] * y[i]).isOne());
+				CYBOZU_TEST_EQUAL(x[i].isOne(), tbl[i] == 1);
+			}
+		}
+		Fp::invVec(x, x, n);
+		for (size_t i = 0; i < n; i++) {
+			CYBOZU_TEST_EQUAL(x[i], y[i]);
+		}
+		for (size_t i = 0; i < n; i++) {
+			x[i] = 0;
+		}
+		Fp::invVec(y, x, n);
+		for (size_t i = 0; i < n; i++) {
+			CYBOZU_TEST_ASSERT(y[i].isZero());
+		}
+	}
 	void cvtInt()
 	{
 #ifndef NEW_FP_T
@@ -516,6 +551,49 @@ struct Test {
 		CYBOZU_TEST_EQUAL(x, Fp("0x3400000012"));
 #endif
 	}
+	void serialize()
+	{
+		const size_t n = Fp::getByteSize();
+		CYBOZU_TEST_EQUAL(n, (Fp::getModBitLen() + 7) / 8);
+		uint8_t buf[N * 8];
+		for (int i = 0; i < 20; i++) {
+			Fp x = i;
+			if (i > 2) Fp::inv(x, x);
+			CYBOZU_TEST_EQUAL(x.serialize(buf, sizeof(buf)), n);
+			mpz_class t;
+			mpz_import(t.get_mpz_t(), n, 1, 1, 1, 0, buf);
+			CYBOZU_TEST_EQUAL(t, toGmp(x));
+			Fp y;
+			CYBOZU_TEST_EQUAL(y.deserialize(buf, n), n);
+			CYBOZU_TEST_EQUAL(x, y);
+			CYBOZU_TEST_EXCEPTION(y.deserialize(buf, n - 1), cybozu::Exception);
+		}
+		mie::fp::toBigEndian(buf, n, mie::Gmp::getBlock(m), mie::Gmp::getBlockSize(m));
+		Fp y;
+		CYBOZU_TEST_EXCEPTION(y.deserialize(buf, n), cybozu::Exception);
+	}
+	void squareRoot()
+	{
+		if (!mie::Gmp::isPrime(m)) return;
+		Fp x, y, z;
+		x = 0;
+		CYBOZU_TEST_ASSERT(Fp::squareRoot(y, x));
+		CYBOZU_TEST_ASSERT(y.isZero());
+		for (int i = 1; i < 200; i++) {
+			const int a = i * 12345 + 7;
+			x = a;
+			const bool b = Fp::squareRoot(y, x);
+			CYBOZU_TEST_EQUAL(b, mie::Gmp::legendre(a, m) > 0);
+			if (b) {
+				Fp::square(z, y);
+				CYBOZU_TEST_EQUAL(z, x);
+			}
+			Fp::square(x, x);
+			CYBOZU_TEST_ASSERT(Fp::squareRoot(y, x));
+			Fp::square(z, y);
+			CYBOZU_TEST_EQUAL(z, x);
+		}
+	}
 	void binaryExp()
 	{
 		puts("binaryExp");
@@ -622,7 +700,7 @@ put(z);
 	uint64_t y[9] = { 0xff7fffffffffffff, 0xffffffffffffffff, 0xffffffffffffffff, 0xffffffffffffffff, 0xffffffffffffffff, 0xffffffffffffffff, 0xffffffffffffffff, 0xffffffffffffffff, 0x1ff };
 	uint64_t z1[9], z2[9];
 	MontFp9::setModulo(pStr);
-	MontFp9::fg_.mul_(z2, x, y);
+	MontFp9::fg_->mul_(z2, x, y);
 	put(z2);
 	{
 		puts("C");
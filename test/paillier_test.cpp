@@ -1,5 +1,6 @@
 #include <iostream>
 #include <mie/paillier.hpp>
+#include <mie/thread.hpp>
 #include <cybozu/test.hpp>
 #include <sstream>
 
@@ -102,3 +103,144 @@ CYBOZU_TEST_AUTO(save_load)
 	prv.dec(dec, enc);
 	CYBOZU_TEST_EQUAL(msg, dec);
 }
+
+CYBOZU_TEST_AUTO(powMul)
+{
+	mie::paillier::PrivateKey prv1, prv2;
+	prv1.init(512);
+	prv2.init(1024);
+	const mie::paillier::PublicKey *tbl[] = { &prv1.getPublicKey(), &prv2.getPublicKey() };
+	for (int i = 0; i < 4; i++) {
+		const mie::paillier::PublicKey& pub = *tbl[i % 2];
+		const mpz_class& n = pub.getN();
+		const mpz_class nn = n * n;
+		const mpz_class x = nn - 12345 * (i + 1);
+		const mpz_class y = n + 987654321;
+		mpz_class z, w;
+		pub.mul(z, x, y);
+		CYBOZU_TEST_EQUAL(z, (x * y) % nn);
+		pub.pow(z, x, y);
+		mie::Gmp::powMod(w, x, y, nn);
+		CYBOZU_TEST_EQUAL(z, w);
+		pub.pow(z, x, 0);
+		CYBOZU_TEST_EQUAL(z, 1);
+	}
+}
+
+struct PowTask {
+	const mie::paillier::PublicKey *pub[2];
+	std::vector<char> ok;
+	explicit PowTask(size_t threadN) : ok(threadN) {}
+	void operator()(size_t id)
+	{
+		bool b = true;
+		for (int i = 0; i < 20; i++) {
+			// keys are used alternately by all threads
+			const mie::paillier::PublicKey& p = *pub[(i + id) % 2];
+			const mpz_class& n = p.getN();
+			const mpz_class nn = n * n;
+			const mpz_class x = nn - 12345 * (i + 1) - id;
+			const mpz_class y = n + 987654321 + i;
+			mpz_class z, w;
+			p.pow(z, x, y);
+			mie::Gmp::powMod(w, x, y, nn);
+			if (z != w) b = false;
+			p.mul(z, x, y);
+			if (z != (x * y) % nn) b = false;
+		}
+		ok[id] = b;
+	}
+};
+
+CYBOZU_TEST_AUTO(thread)
+{
+	mie::paillier::PrivateKey prv1, prv2;
+	prv1.init(512);
+	prv2.init(1024);
+	// a copy shares the context
+	const mie::paillier::PublicKey pub2 = prv2.getPublicKey();
+	CYBOZU_TEST_EQUAL(pub2, prv2.getPublicKey());
+	const size_t threadN = 4;
+	PowTask task(threadN);
+	task.pub[0] = &prv1.getPublicKey();
+	task.pub[1] = &pub2;
+	mie::thread::run(task, threadN);
+	for (size_t i = 0; i < threadN; i++) {
+		CYBOZU_TEST_ASSERT(task.ok[i]);
+	}
+	mpz_class msg("123456789"), enc, dec;
+	pub2.enc(enc, msg);
+	prv2.dec(dec, enc);
+	CYBOZU_TEST_EQUAL(dec, msg);
+}
+
+CYBOZU_TEST_AUTO(sharedCtx)
+{
+	typedef mie::paillier::local::SharedCtxNN SharedCtxNN;
+	const size_t n0 = SharedCtxNN::size();
+	{
+		mie::paillier::PrivateKey prv;
+		prv.init(512);
+		CYBOZU_TEST_EQUAL(SharedCtxNN::size(), n0 + 1);
+		mie::paillier::PublicKey pub = prv.getPublicKey();
+		CYBOZU_TEST_EQUAL(SharedCtxNN::size(), n0 + 1);
+		// a loaded key with the same n shares the context
+		std::ostringstream os;
+		os << pub;
+		std::istringstream is(os.str());
+		mie::paillier::PublicKey pub2;
+		is >> pub2;
+		CYBOZU_TEST_EQUAL(SharedCtxNN::size(), n0 + 1);
+		mie::paillier::PrivateKey prv2;
+		prv2.init(512);
+		CYBOZU_TEST_EQUAL(SharedCtxNN::size(), n0 + 2);
+		pub2 = prv2.getPublicKey();
+		CYBOZU_TEST_EQUAL(SharedCtxNN::size(), n0 + 2);
+		mpz_class msg("123456789"), enc, dec;
+		pub.enc(enc, msg);
+		prv.dec(dec, enc);
+		CYBOZU_TEST_EQUAL(dec, msg);
+		pub2.enc(enc, msg);
+		prv2.dec(dec, enc);
+		CYBOZU_TEST_EQUAL(dec, msg);
+	}
+	CYBOZU_TEST_EQUAL(SharedCtxNN::size(), n0);
+}
+
+CYBOZU_TEST_AUTO(cipherText)
+{
+	mie::paillier::PrivateKey prv;
+	prv.init(1024);
+	const mie::paillier::PublicKey& pub = prv.getPublicKey();
+	const mpz_class m1("123456789012345678901122334455");
+	const mpz_class m2("234567890123456789011223344554");
+	mie::paillier::CipherText c1, c2, c;
+	pub.enc(c1, m1);
+	pub.enc(c2, m2);
+	mpz_class e1, e2, e, d;
+	pub.toGmp(e1, c1);
+	pub.toGmp(e2, c2);
+	prv.dec(d, e1);
+	CYBOZU_TEST_EQUAL(d, m1);
+	prv.dec(d, c1);
+	CYBOZU_TEST_EQUAL(d, m1);
+	// add and mul keep the internal form
+	pub.add(c, c1, c2);
+	pub.mul(e, e1, e2);
+	mpz_class t;
+	pub.toGmp(t, c);
+	CYBOZU_TEST_EQUAL(t, e);
+	prv.dec(d, c);
+	CYBOZU_TEST_EQUAL(d, m1 + m2);
+	pub.add(c, c, c1);
+	prv.dec(d, c);
+	CYBOZU_TEST_EQUAL(d, m1 * 2 + m2);
+	pub.mul(c, c1, 12345);
+	prv.dec(d, c);
+	CYBOZU_TEST_EQUAL(d, m1 * 12345);
+	pub.fromGmp(c, e1);
+	CYBOZU_TEST_ASSERT(c == c1);
+	const mpz_class& n = pub.getN();
+	pub.fromGmp(c, e1 + n * n);
+	CYBOZU_TEST_ASSERT(c == c1);
+}
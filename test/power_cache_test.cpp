@@ -0,0 +1,232 @@
+#include <cybozu/test.hpp>
+#include <cybozu/random_generator.hpp>
+#include <mie/fp.hpp>
+#include <mie/gmp_util.hpp>
+#include <mie/power_cache.hpp>
+#include <mie/ecdsa.hpp>
+#include <mie/ecparam.hpp>
+#include <time.h>
+
+typedef mie::FpT<mie::Gmp> Fp;
+struct tagZn;
+typedef mie::FpT<mie::Gmp, tagZn> Zn;
+typedef mie::EcT<Fp> Ec;
+typedef mie::PowerCacheT<Fp> PowerCache;
+typedef mie::EcdsaT<Fp, Zn> Ecdsa;
+
+cybozu::RandomGenerator rg;
+
+void initCurve(const mie::EcParam& para, bool useGlv)
+{
+	Fp::setModulo(para.p);
+	Zn::setModulo(para.n);
+	Ec::setParam(para.a, para.b);
+	const mie::EcGlvParam *glv = mie::getEcGlvParam(para.name);
+	if (useGlv && glv) Ec::setGlv(glv->beta, glv->lambda, para.n, Ec(Fp(para.gx), Fp(para.gy)));
+}
+
+void testPower(const Ec& G)
+{
+	for (int w = 2; w <= PowerCache::maxW; w += 2) {
+		PowerCache cache(PowerCache::defaultMaxByteSize, w);
+		Ec Q[3];
+		const size_t qN = CYBOZU_NUM_OF_ARRAY(Q);
+		for (size_t i = 0; i < qN; i++) {
+			Zn t;
+			t.setRand(rg);
+			Ec::power(Q[i], G, t);
+		}
+		for (int i = 0; i < 10; i++) {
+			const Ec& P = Q[i % qN];
+			Zn k;
+			k.setRand(rg);
+			Ec R, S;
+			cache.power(R, P, k);
+			Ec::power(S, P, k);
+			CYBOZU_TEST_EQUAL(R, S);
+		}
+		CYBOZU_TEST_EQUAL(cache.getMissNum(), qN);
+		CYBOZU_TEST_EQUAL(cache.getHitNum(), 10 - qN);
+		CYBOZU_TEST_EQUAL(cache.size(), qN);
+		const int kTbl[] = { 0, 1, -1, 2, -5, 123456 };
+		for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(kTbl); i++) {
+			Ec R, S;
+			cache.power(R, Q[0], kTbl[i]);
+			Ec::power(S, Q[0], kTbl[i]);
+			CYBOZU_TEST_EQUAL(R, S);
+		}
+		// zero is not cached
+		Ec R;
+		cache.power(R, Ec(), 5);
+		CYBOZU_TEST_ASSERT(R.isZero());
+		CYBOZU_TEST_EQUAL(cache.size(), qN);
+	}
+}
+
+CYBOZU_TEST_AUTO(power)
+{
+	const mie::EcParam *tbl[] = {
+		&mie::ecparam::secp192k1,
+		&mie::ecparam::secp256k1,
+		&mie::ecparam::NIST_P256,
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		const mie::EcParam& para = *tbl[i];
+		for (int useGlv = 0; useGlv < 2; useGlv++) {
+			if (useGlv && mie::getEcGlvParam(para.name) == 0) continue;
+			initCurve(para, useGlv != 0);
+			const Ec G(Fp(para.gx), Fp(para.gy));
+			testPower(G);
+		}
+	}
+}
+
+CYBOZU_TEST_AUTO(lru)
+{
+	const mie::EcParam& para = mie::ecparam::secp256k1;
+	initCurve(para, false);
+	const Ec G(Fp(para.gx), Fp(para.gy));
+	CYBOZU_TEST_EXCEPTION(PowerCache(100, 1), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(PowerCache(100, PowerCache::maxW + 1), cybozu::Exception);
+	const size_t entrySize = (PowerCache(0, 4).getTableSize() * 2 + 2) * Fp::getByteSize();
+	// room for two tables
+	PowerCache cache(entrySize * 2 + entrySize / 2, 4);
+	Ec P[3], R;
+	for (int i = 0; i < 3; i++) {
+		Ec::power(P[i], G, i + 1);
+	}
+	cache.power(R, P[0], 7);
+	cache.power(R, P[1], 7);
+	CYBOZU_TEST_EQUAL(cache.size(), 2u);
+	CYBOZU_TEST_EQUAL(cache.getByteSize(), entrySize * 2);
+	// P[0] is used recently so P[1] is evicted
+	cache.power(R, P[0], 7);
+	cache.power(R, P[2], 7);
+	CYBOZU_TEST_EQUAL(cache.size(), 2u);
+	CYBOZU_TEST_EQUAL(cache.getHitNum(), 1u);
+	CYBOZU_TEST_EQUAL(cache.getMissNum(), 3u);
+	cache.power(R, P[0], 7);
+	cache.power(R, P[2], 7);
+	CYBOZU_TEST_EQUAL(cache.getHitNum(), 3u);
+	cache.power(R, P[1], 7);
+	CYBOZU_TEST_EQUAL(cache.getMissNum(), 4u);
+	// a point of another representation has the same key
+	Ec Q = P[2] + G - G;
+	cache.power(R, Q, 7);
+	CYBOZU_TEST_EQUAL(cache.getHitNum(), 4u);
+	cache.clear();
+	CYBOZU_TEST_EQUAL(cache.size(), 0u);
+	CYBOZU_TEST_EQUAL(cache.getByteSize(), 0u);
+	// no room
+	PowerCache small(entrySize - 1, 4);
+	small.power(R, P[0], 7);
+	Ec S;
+	Ec::power(S, P[0], 7);
+	CYBOZU_TEST_EQUAL(R, S);
+	CYBOZU_TEST_EQUAL(small.size(), 0u);
+}
+
+struct PowerTask {
+	PowerCache *cache;
+	const Ec *P;
+	size_t pN;
+	std::vector<char> ok;
+	PowerTask(PowerCache *cache, const Ec *P, size_t pN, size_t threadN)
+		: cache(cache), P(P), pN(pN), ok(threadN)
+	{
+	}
+	void operator()(size_t id)
+	{
+		bool b = true;
+		for (size_t i = 0; i < 40; i++) {
+			const Ec& Q = P[(i + id) % pN];
+			const int k = int(i * 1000 + id);
+			Ec R, S;
+			cache->power(R, Q, k);
+			Ec::power(S, Q, k);
+			if (R != S) b = false;
+		}
+		ok[id] = b;
+	}
+};
+
+CYBOZU_TEST_AUTO(thread)
+{
+	const mie::EcParam& para = mie::ecparam::secp256k1;
+	initCurve(para, true);
+	const Ec G(Fp(para.gx), Fp(para.gy));
+	Ec P[5];
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(P); i++) {
+		Ec::power(P[i], G, int(i + 1));
+	}
+	PowerCache cache;
+	const size_t threadN = 4;
+	PowerTask task(&cache, P, CYBOZU_NUM_OF_ARRAY(P), threadN);
+	mie::thread::run(task, threadN);
+	for (size_t i = 0; i < threadN; i++) {
+		CYBOZU_TEST_ASSERT(task.ok[i]);
+	}
+	const size_t pN = CYBOZU_NUM_OF_ARRAY(P);
+	CYBOZU_TEST_EQUAL(cache.size(), pN);
+	CYBOZU_TEST_EQUAL(cache.getHitNum() + cache.getMissNum(), threadN * 40);
+	CYBOZU_TEST_ASSERT(cache.getMissNum() >= pN);
+}
+
+CYBOZU_TEST_AUTO(ecdsa)
+{
+	const mie::EcParam& para = mie::ecparam::secp256k1;
+	for (int useGlv = 0; useGlv < 2; useGlv++) {
+		initCurve(para, useGlv != 0);
+		const Ec G(Fp(para.gx), Fp(para.gy));
+		Ecdsa ecdsa(G, para.n);
+		PowerCache cache;
+		ecdsa.setCache(&cache);
+		Zn sec[3];
+		Ec Q[3];
+		const size_t secN = CYBOZU_NUM_OF_ARRAY(sec);
+		for (size_t i = 0; i < secN; i++) {
+			sec[i].setRand(rg);
+			ecdsa.getPublicKey(Q[i], sec[i]);
+		}
+		for (int i = 0; i < 12; i++) {
+			const size_t j = i % secN;
+			Zn h;
+			h.setRand(rg);
+			Ecdsa::Signature sig;
+			ecdsa.sign(sig, sec[j], h, rg);
+			CYBOZU_TEST_ASSERT(ecdsa.verify(sig, Q[j], h));
+			CYBOZU_TEST_ASSERT(!ecdsa.verify(sig, Q[j], h + 1));
+			CYBOZU_TEST_ASSERT(!ecdsa.verify(sig, Q[(j + 1) % secN], h));
+		}
+		CYBOZU_TEST_EQUAL(cache.getMissNum(), secN);
+		CYBOZU_TEST_EQUAL(cache.getHitNum(), 12 * 3 - secN);
+#ifdef NDEBUG
+		Zn h;
+		h.setRand(rg);
+		Ecdsa::Signature sig;
+		ecdsa.sign(sig, sec[0], h, rg);
+		const int N = 300;
+		for (int withCache = 0; withCache < 2; withCache++) {
+			ecdsa.setCache(withCache ? &cache : 0);
+			clock_t begin = clock();
+			for (int i = 0; i < N; i++) {
+				ecdsa.verify(sig, Q[0], h);
+			}
+			printf("glv=%d verify cache=%d %.2f usec\n", useGlv, withCache, (clock() - begin) * 1e6 / CLOCKS_PER_SEC / N);
+		}
+		const Zn k = h;
+		Ec R;
+		for (int withCache = 0; withCache < 2; withCache++) {
+			clock_t begin = clock();
+			for (int i = 0; i < N; i++) {
+				if (withCache) {
+					cache.power(R, Q[0], k);
+				} else {
+					Ec::power(R, Q[0], k);
+				}
+			}
+			printf("glv=%d power cache=%d %.2f usec\n", useGlv, withCache, (clock() - begin) * 1e6 / CLOCKS_PER_SEC / N);
+		}
+#endif
+	}
+}
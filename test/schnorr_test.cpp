@@ -0,0 +1,195 @@
+#include <cybozu/test.hpp>
+#include <cybozu/benchmark.hpp>
+#include <cybozu/random_generator.hpp>
+#include <mie/fp.hpp>
+#include <mie/gmp_util.hpp>
+#include <mie/schnorr.hpp>
+#include <mie/ecparam.hpp>
+#include <time.h>
+
+typedef mie::FpT<mie::Gmp> Fp;
+struct tagZn;
+typedef mie::FpT<mie::Gmp, tagZn> Zn;
+typedef mie::EcT<Fp> Ec;
+
+/*
+	256-bit digest by four lanes of FNV-1a
+	not a cryptographic hash ; only for this test
+*/
+struct Hash {
+	std::string operator()(const std::string& data) const
+	{
+		std::string md;
+		for (uint64_t lane = 0; lane < 4; lane++) {
+			uint64_t v = 14695981039346656037ULL ^ lane;
+			for (size_t i = 0; i < data.size(); i++) {
+				v ^= uint8_t(data[i]);
+				v *= 1099511628211ULL;
+			}
+			for (int j = 0; j < 8; j++) {
+				md += char(v >> (56 - j * 8));
+			}
+		}
+		return md;
+	}
+};
+
+typedef mie::SchnorrT<Fp, Zn, Hash> Schnorr;
+
+cybozu::RandomGenerator rg;
+
+void initCurve(const mie::EcParam& para, bool useGlv)
+{
+	Fp::setModulo(para.p);
+	Zn::setModulo(para.n);
+	Ec::setParam(para.a, para.b);
+	const mie::EcGlvParam *glv = mie::getEcGlvParam(para.name);
+	if (useGlv && glv) Ec::setGlv(glv->beta, glv->lambda, para.n, Ec(Fp(para.gx), Fp(para.gy)));
+}
+
+struct Batch {
+	std::vector<Schnorr::Signature> sig;
+	std::vector<Ec> Q;
+	std::vector<std::string> msg;
+	void init(const Schnorr& schnorr, size_t n)
+	{
+		sig.resize(n);
+		Q.resize(n);
+		msg.resize(n);
+		for (size_t i = 0; i < n; i++) {
+			Zn sec;
+			sec.setRand(rg);
+			schnorr.getPublicKey(Q[i], sec);
+			msg[i] = "msg" + Zn(int(i)).toStr();
+			schnorr.sign(sig[i], sec, Q[i], msg[i], rg);
+		}
+	}
+};
+
+void testSignVerify(const Schnorr& schnorr)
+{
+	for (int i = 0; i < 10; i++) {
+		Zn sec;
+		Ec Q;
+		sec.setRand(rg);
+		schnorr.getPublicKey(Q, sec);
+		Schnorr::Signature sig;
+		const std::string msg = "hello";
+		schnorr.sign(sig, sec, Q, msg, rg);
+		CYBOZU_TEST_ASSERT(schnorr.verify(sig, Q, msg));
+		CYBOZU_TEST_ASSERT(!schnorr.verify(sig, Q, "hellp"));
+		CYBOZU_TEST_ASSERT(!schnorr.verify(sig, Q + schnorr.getBase(), msg));
+		Schnorr::Signature bad = sig;
+		bad.s += 1;
+		CYBOZU_TEST_ASSERT(!schnorr.verify(bad, Q, msg));
+		bad = sig;
+		bad.R += schnorr.getBase();
+		CYBOZU_TEST_ASSERT(!schnorr.verify(bad, Q, msg));
+		bad.R.clear();
+		CYBOZU_TEST_ASSERT(!schnorr.verify(bad, Q, msg));
+		CYBOZU_TEST_ASSERT(!schnorr.verify(sig, Ec(), msg));
+	}
+}
+
+void testBatch(const Schnorr& schnorr)
+{
+	const size_t nTbl[] = { 0, 1, 2, 7, 80 };
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(nTbl); i++) {
+		const size_t n = nTbl[i];
+		Batch b;
+		b.init(schnorr, n);
+		std::vector<size_t> bad;
+		CYBOZU_TEST_ASSERT(schnorr.verifyBatch(b.sig.data(), b.Q.data(), b.msg.data(), n, rg));
+		CYBOZU_TEST_ASSERT(schnorr.findBad(bad, b.sig.data(), b.Q.data(), b.msg.data(), n, rg));
+		CYBOZU_TEST_ASSERT(bad.empty());
+		if (n == 0) continue;
+		// break some signatures in several ways
+		std::vector<size_t> expect;
+		for (size_t j = 0; j < n; j += 3) {
+			switch (j % 4) {
+			case 0: b.sig[j].s += 1; break;
+			case 1: b.msg[j] += "x"; break;
+			case 2: b.Q[j] = b.Q[(j + 1) % n] + schnorr.getBase(); break;
+			default: b.sig[j].R.clear(); break;
+			}
+			expect.push_back(j);
+		}
+		CYBOZU_TEST_ASSERT(!schnorr.verifyBatch(b.sig.data(), b.Q.data(), b.msg.data(), n, rg));
+		CYBOZU_TEST_ASSERT(!schnorr.findBad(bad, b.sig.data(), b.Q.data(), b.msg.data(), n, rg));
+		CYBOZU_TEST_ASSERT(bad == expect);
+	}
+	/*
+		two bad signatures whose errors cancel in the plain sum
+		s[0] + d and s[1] - d pass only if a_1 = 1
+	*/
+	Batch b;
+	b.init(schnorr, 2);
+	b.sig[0].s += 5;
+	b.sig[1].s -= 5;
+	CYBOZU_TEST_ASSERT(!schnorr.verifyBatch(b.sig.data(), b.Q.data(), b.msg.data(), 2, rg));
+}
+
+void bench(const Schnorr& schnorr)
+{
+	const size_t n = 256;
+	Batch b;
+	b.init(schnorr, n);
+	Ec R;
+	Zn k;
+	k.setRand(rg);
+	CYBOZU_BENCH("pow         ", Ec::power, R, b.Q[0], k);
+	CYBOZU_BENCH("verify      ", schnorr.verify, b.sig[0], b.Q[0], b.msg[0]);
+	const int N = 10;
+	clock_t begin = clock();
+	for (int i = 0; i < N; i++) {
+		schnorr.verifyBatch(b.sig.data(), b.Q.data(), b.msg.data(), n, rg);
+	}
+	clock_t end = clock();
+	printf("verifyBatch  %.2fusec per signature(n=%d)\n", (end - begin) / double(CLOCKS_PER_SEC) / N / n * 1e6, int(n));
+}
+
+CYBOZU_TEST_AUTO(schnorr)
+{
+	const mie::EcParam *tbl[] = {
+		&mie::ecparam::secp192k1,
+		&mie::ecparam::secp256k1,
+		&mie::ecparam::NIST_P256,
+	};
+	for (size_t i = 0; i < CYBOZU_NUM_OF_ARRAY(tbl); i++) {
+		const mie::EcParam& para = *tbl[i];
+		for (int useGlv = 0; useGlv < 2; useGlv++) {
+			if (useGlv && mie::getEcGlvParam(para.name) == 0) continue;
+			printf("%s glv=%d\n", para.name, useGlv);
+			initCurve(para, useGlv != 0);
+			const Ec G(Fp(para.gx), Fp(para.gy));
+			Schnorr schnorr(G, para.n);
+			testSignVerify(schnorr);
+			testBatch(schnorr);
+#ifdef NDEBUG
+			bench(schnorr);
+#endif
+		}
+	}
+}
+
+CYBOZU_TEST_AUTO(signWithNonce)
+{
+	const mie::EcParam& para = mie::ecparam::secp256k1;
+	initCurve(para, false);
+	const Ec G(Fp(para.gx), Fp(para.gy));
+	Schnorr schnorr(G, para.n);
+	const Zn sec("123456789"), k("987654321");
+	Ec Q;
+	schnorr.getPublicKey(Q, sec);
+	Schnorr::Signature sig;
+	schnorr.signWithNonce(sig, sec, Q, "abc", k);
+	Zn e;
+	schnorr.getChallenge(e, sig.R, Q, "abc");
+	CYBOZU_TEST_EQUAL(sig.s, k + e * sec);
+	Ec R;
+	Ec::power(R, G, k);
+	CYBOZU_TEST_EQUAL(sig.R, R);
+	CYBOZU_TEST_ASSERT(schnorr.verify(sig, Q, "abc"));
+	CYBOZU_TEST_EXCEPTION(schnorr.signWithNonce(sig, sec, Q, "abc", 0), cybozu::Exception);
+	CYBOZU_TEST_EXCEPTION(schnorr.init(Ec(), para.n), cybozu::Exception);
+}